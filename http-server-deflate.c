@@ -0,0 +1,393 @@
+/*
+ * A simple HTTP/SERVER library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Streaming deflate encoder (RFC 1951) with gzip (RFC 1952) and zlib
+ * (RFC 1950) wrappers. It is designed for small RAM: the body is collected
+ * into a window of HTTPSERVER_COMPRESSION_WINDOW bytes, then each window is
+ * compressed, with a greedy LZ77 search on a single-entry hash table, into a
+ * block of fixed Huffman codes. No dynamic table is built, so no further
+ * memory is needed.
+ */
+
+#include "http-server.h"
+#include "http-server-internal.h"
+
+// The checksum of gzip is shared with the upload
+#if (HTTPSERVER_COMPRESSION == 1) || (HTTPSERVER_UPLOAD == 1)
+static const uint32_t HttpServer_crc32Table[16] =
+{
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t HttpServer_crc32 (uint32_t crc, const uint8_t* data, uint16_t length)
+{
+    crc = ~crc;
+    while (length--)
+    {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ HttpServer_crc32Table[crc & 0x0F];
+        crc = (crc >> 4) ^ HttpServer_crc32Table[crc & 0x0F];
+    }
+    return ~crc;
+}
+#endif
+
+#if (HTTPSERVER_COMPRESSION == 1)
+
+#if (HTTPSERVER_COMPRESSION_WINDOW > 32768)
+#error "HTTPSERVER_COMPRESSION_WINDOW must not be greater than 32768"
+#endif
+#if (HTTPSERVER_COMPRESSION_MIN_LENGTH > HTTPSERVER_COMPRESSION_WINDOW)
+#error "HTTPSERVER_COMPRESSION_MIN_LENGTH must not be greater than HTTPSERVER_COMPRESSION_WINDOW"
+#endif
+
+#define HTTPSERVER_DEFLATE_MIN_MATCH      3
+#define HTTPSERVER_DEFLATE_MAX_MATCH      258
+#define HTTPSERVER_DEFLATE_END_OF_BLOCK   256
+
+static const uint16_t HttpServer_deflateLengthBase[29] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t HttpServer_deflateLengthExtra[29] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t HttpServer_deflateDistanceBase[30] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289,
+    16385, 24577
+};
+
+static const uint8_t HttpServer_deflateDistanceExtra[30] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/**
+ * @ingroup httpServer_functions
+ * This function updates the Adler32 checksum used by the zlib format.
+ */
+static uint32_t HttpServer_adler32 (uint32_t adler, const uint8_t* data, uint16_t length)
+{
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+
+    while (length--)
+    {
+        a = (a + *data++) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function passes the collected compressed bytes to the trasmission
+ * path.
+ */
+static void HttpServer_deflateFlushOut (HttpServer_DeviceHandle dev)
+{
+    HttpServer_Deflate* deflate = &dev->deflate;
+
+    if (deflate->outLength > 0)
+    {
+        HttpServer_txBody(dev,deflate->client,deflate->out,deflate->outLength);
+        deflate->outLength = 0;
+    }
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function appends a raw byte to the compressed stream.
+ */
+static void HttpServer_deflateByte (HttpServer_DeviceHandle dev, uint8_t value)
+{
+    HttpServer_Deflate* deflate = &dev->deflate;
+
+    deflate->out[deflate->outLength++] = value;
+    if (deflate->outLength == sizeof(deflate->out))
+        HttpServer_deflateFlushOut(dev);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function appends bits to the compressed stream, from the less
+ * significant one.
+ */
+static void HttpServer_deflateBits (HttpServer_DeviceHandle dev,
+                                    uint32_t value,
+                                    uint8_t count)
+{
+    HttpServer_Deflate* deflate = &dev->deflate;
+
+    deflate->bits |= value << deflate->bitCount;
+    deflate->bitCount += count;
+    while (deflate->bitCount >= 8)
+    {
+        HttpServer_deflateByte(dev,deflate->bits & 0xFF);
+        deflate->bits >>= 8;
+        deflate->bitCount -= 8;
+    }
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function appends a Huffman code: they are stored from the most
+ * significant bit.
+ */
+static void HttpServer_deflateCode (HttpServer_DeviceHandle dev,
+                                    uint16_t code,
+                                    uint8_t count)
+{
+    uint16_t reversed = 0;
+
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        reversed = (reversed << 1) | (code & 0x01);
+        code >>= 1;
+    }
+    HttpServer_deflateBits(dev,reversed,count);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function appends a literal/length symbol with the fixed Huffman code.
+ */
+static void HttpServer_deflateSymbol (HttpServer_DeviceHandle dev,
+                                      uint16_t symbol)
+{
+    if (symbol < 144)
+        HttpServer_deflateCode(dev,0x30 + symbol,8);
+    else if (symbol < 256)
+        HttpServer_deflateCode(dev,0x190 + (symbol - 144),9);
+    else if (symbol < 280)
+        HttpServer_deflateCode(dev,symbol - 256,7);
+    else
+        HttpServer_deflateCode(dev,0xC0 + (symbol - 280),8);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function appends a match.
+ */
+static void HttpServer_deflateMatch (HttpServer_DeviceHandle dev,
+                                     uint16_t length,
+                                     uint16_t distance)
+{
+    uint8_t code = 28;
+
+    while (HttpServer_deflateLengthBase[code] > length)
+        code--;
+    HttpServer_deflateSymbol(dev,257 + code);
+    HttpServer_deflateBits(dev,
+                           length - HttpServer_deflateLengthBase[code],
+                           HttpServer_deflateLengthExtra[code]);
+
+    code = 29;
+    while (HttpServer_deflateDistanceBase[code] > distance)
+        code--;
+    HttpServer_deflateCode(dev,code,5);
+    HttpServer_deflateBits(dev,
+                           distance - HttpServer_deflateDistanceBase[code],
+                           HttpServer_deflateDistanceExtra[code]);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function returns the hash table index of the 3 bytes sequence.
+ */
+static inline uint16_t HttpServer_deflateHash (const uint8_t* data)
+{
+    uint32_t value = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+    return (uint32_t)(value * 2654435761u) >> (32 - HTTPSERVER_COMPRESSION_HASH_BITS);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function compresses the window into a fixed Huffman block.
+ */
+static void HttpServer_deflateBlock (HttpServer_DeviceHandle dev, bool last)
+{
+    HttpServer_Deflate* deflate = &dev->deflate;
+    const uint8_t* window = deflate->window;
+    uint16_t length = deflate->length;
+    uint16_t i = 0;
+
+    if (deflate->format == HTTPSERVER_ENCODING_GZIP)
+        deflate->check = HttpServer_crc32(deflate->check,window,length);
+    else
+        deflate->check = HttpServer_adler32(deflate->check,window,length);
+    deflate->total += length;
+
+    // Block header: BFINAL and BTYPE=01
+    HttpServer_deflateBits(dev,last ? 0x03 : 0x02,3);
+
+    memset(deflate->head,0,sizeof(deflate->head));
+
+    while (i < length)
+    {
+        uint16_t best = 0;
+        uint16_t candidate = 0;
+
+        if ((length - i) >= HTTPSERVER_DEFLATE_MIN_MATCH)
+        {
+            uint16_t hash = HttpServer_deflateHash(&window[i]);
+
+            candidate = deflate->head[hash];
+            deflate->head[hash] = i + 1;
+            if (candidate != 0)
+            {
+                uint16_t max = length - i;
+                candidate--;
+
+                if (max > HTTPSERVER_DEFLATE_MAX_MATCH)
+                    max = HTTPSERVER_DEFLATE_MAX_MATCH;
+                while ((best < max) && (window[candidate + best] == window[i + best]))
+                    best++;
+            }
+        }
+
+        if (best >= HTTPSERVER_DEFLATE_MIN_MATCH)
+        {
+            HttpServer_deflateMatch(dev,best,i - candidate);
+            // Hash the skipped sequences too
+            for (uint16_t j = i + 1; (j < (i + best)) && ((length - j) >= HTTPSERVER_DEFLATE_MIN_MATCH); ++j)
+                deflate->head[HttpServer_deflateHash(&window[j])] = j + 1;
+            i += best;
+        }
+        else
+        {
+            HttpServer_deflateSymbol(dev,window[i]);
+            i++;
+        }
+    }
+
+    HttpServer_deflateSymbol(dev,HTTPSERVER_DEFLATE_END_OF_BLOCK);
+    deflate->length = 0;
+}
+
+bool HttpServer_deflateAcquire (HttpServer_DeviceHandle dev,
+                                uint8_t client,
+                                uint8_t format)
+{
+    if (dev->deflate.client != HTTPSERVER_DEFLATE_FREE)
+        return false;
+
+    dev->deflate.client = client;
+    dev->deflate.format = format;
+    dev->deflate.length = 0;
+    dev->deflate.outLength = 0;
+    dev->deflate.bits = 0;
+    dev->deflate.bitCount = 0;
+    dev->deflate.total = 0;
+    dev->deflate.check = (format == HTTPSERVER_ENCODING_GZIP) ? 0 : 1;
+    return true;
+}
+
+void HttpServer_deflateRelease (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    if (dev->deflate.client == client)
+        dev->deflate.client = HTTPSERVER_DEFLATE_FREE;
+}
+
+void HttpServer_deflateStart (HttpServer_DeviceHandle dev)
+{
+    static const uint8_t gzipHeader[10] =
+    {
+        0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF
+    };
+    static const uint8_t zlibHeader[2] = { 0x78, 0x01 };
+
+    if (dev->deflate.format == HTTPSERVER_ENCODING_GZIP)
+        HttpServer_txBody(dev,dev->deflate.client,gzipHeader,sizeof(gzipHeader));
+    else
+        HttpServer_txBody(dev,dev->deflate.client,zlibHeader,sizeof(zlibHeader));
+}
+
+void HttpServer_deflateWrite (HttpServer_DeviceHandle dev,
+                              const uint8_t* data,
+                              uint16_t length)
+{
+    HttpServer_Deflate* deflate = &dev->deflate;
+    uint16_t size;
+
+    while (length > 0)
+    {
+        if (deflate->length == HTTPSERVER_COMPRESSION_WINDOW)
+            HttpServer_deflateBlock(dev,false);
+
+        size = HTTPSERVER_COMPRESSION_WINDOW - deflate->length;
+        if (size > length)
+            size = length;
+
+        memcpy(&deflate->window[deflate->length],data,size);
+        deflate->length += size;
+        data += size;
+        length -= size;
+    }
+}
+
+void HttpServer_deflateFinish (HttpServer_DeviceHandle dev)
+{
+    HttpServer_Deflate* deflate = &dev->deflate;
+    uint32_t check;
+
+    HttpServer_deflateBlock(dev,true);
+    // Align to byte
+    if (deflate->bitCount > 0)
+        HttpServer_deflateBits(dev,0,8 - deflate->bitCount);
+
+    check = deflate->check;
+    if (deflate->format == HTTPSERVER_ENCODING_GZIP)
+    {
+        // CRC32 and length, little endian
+        for (uint8_t i = 0; i < 4; ++i)
+            HttpServer_deflateByte(dev,(check >> (8 * i)) & 0xFF);
+        for (uint8_t i = 0; i < 4; ++i)
+            HttpServer_deflateByte(dev,(deflate->total >> (8 * i)) & 0xFF);
+    }
+    else
+    {
+        // Adler32, big endian
+        for (uint8_t i = 0; i < 4; ++i)
+            HttpServer_deflateByte(dev,(check >> (24 - 8 * i)) & 0xFF);
+    }
+    HttpServer_deflateFlushOut(dev);
+}
+
+#endif // HTTPSERVER_COMPRESSION
@@ -0,0 +1,335 @@
+/*
+ * A simple HTTP/SERVER library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Response header builder: the headers are appended as (name, value) pairs
+ * with precomputed wire strings, the framing headers are added by the
+ * server from the lengths it already knows.
+ */
+
+#include "http-server.h"
+#include "http-server-internal.h"
+
+#define HTTPSERVER_HEADER_WIRE(name)      { name ": ", sizeof(name ": ") - 1 }
+
+/**
+ * @ingroup httpServer_functions
+ * Wire names of @ref HttpServer_Header , with the separator.
+ */
+static const struct
+{
+    const char* name;
+    uint8_t length;
+} HttpServer_headerNames[HTTPSERVER_HEADER_NUMBER] =
+{
+    HTTPSERVER_HEADER_WIRE("Content-Type"),
+    HTTPSERVER_HEADER_WIRE("Content-Encoding"),
+    HTTPSERVER_HEADER_WIRE("Content-Disposition"),
+    HTTPSERVER_HEADER_WIRE("Cache-Control"),
+    HTTPSERVER_HEADER_WIRE("ETag"),
+    HTTPSERVER_HEADER_WIRE("Last-Modified"),
+    HTTPSERVER_HEADER_WIRE("Location"),
+    HTTPSERVER_HEADER_WIRE("Retry-After"),
+    HTTPSERVER_HEADER_WIRE("Set-Cookie"),
+    HTTPSERVER_HEADER_WIRE("WWW-Authenticate"),
+    HTTPSERVER_HEADER_WIRE("Access-Control-Allow-Origin"),
+};
+
+static const char HttpServer_serverHeader[] = "Server: " HTTPSERVER_SERVER_NAME "\r\n";
+static const char HttpServer_keepAliveHeader[] = "Connection: keep-alive\r\n\r\n";
+static const char HttpServer_closeHeader[] = "Connection: close\r\n\r\n";
+
+static const char HttpServer_weekDays[7][4] =
+{
+    "Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed",
+};
+
+static const char HttpServer_months[12][4] =
+{
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+
+/**
+ * @ingroup httpServer_functions
+ * This function writes two decimal digits.
+ */
+static inline void HttpServer_formatTwoDigits (char* buffer, uint8_t value)
+{
+    buffer[0] = '0' + (value / 10);
+    buffer[1] = '0' + (value % 10);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function formats a time into the IMF-fixdate format of the Date
+ * header, like "Sun, 06 Nov 1994 08:49:37 GMT".
+ *@param[out] buffer At least 30 characters
+ *@param time Seconds since 1970-01-01 UTC
+ */
+static void HttpServer_formatDate (char* buffer, uint32_t time)
+{
+    uint32_t days = time / 86400;
+    uint32_t seconds = time % 86400;
+    uint32_t era, dayOfEra, yearOfEra, dayOfYear, monthIndex;
+    uint32_t year, month, day;
+
+    // Civil date from the day number, with the years beginning in March
+    // so that the leap day is the last one
+    days += 719468;
+    era = days / 146097;
+    dayOfEra = days - (era * 146097);
+    yearOfEra = (dayOfEra - (dayOfEra / 1460) + (dayOfEra / 36524) - (dayOfEra / 146096)) / 365;
+    dayOfYear = dayOfEra - ((365 * yearOfEra) + (yearOfEra / 4) - (yearOfEra / 100));
+    monthIndex = ((5 * dayOfYear) + 2) / 153;
+    day = dayOfYear - (((153 * monthIndex) + 2) / 5) + 1;
+    month = (monthIndex < 10) ? (monthIndex + 3) : (monthIndex - 9);
+    year = yearOfEra + (era * 400) + ((month <= 2) ? 1 : 0);
+
+    memcpy(&buffer[0],HttpServer_weekDays[(time / 86400) % 7],3);
+    buffer[3] = ',';
+    buffer[4] = ' ';
+    HttpServer_formatTwoDigits(&buffer[5],day);
+    buffer[7] = ' ';
+    memcpy(&buffer[8],HttpServer_months[month - 1],3);
+    buffer[11] = ' ';
+    HttpServer_formatTwoDigits(&buffer[12],year / 100);
+    HttpServer_formatTwoDigits(&buffer[14],year % 100);
+    buffer[16] = ' ';
+    HttpServer_formatTwoDigits(&buffer[17],seconds / 3600);
+    buffer[19] = ':';
+    HttpServer_formatTwoDigits(&buffer[20],(seconds / 60) % 60);
+    buffer[22] = ':';
+    HttpServer_formatTwoDigits(&buffer[23],seconds % 60);
+    memcpy(&buffer[25]," GMT",5);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function checks if the connection can wait for another request
+ * after the response.
+ */
+static bool HttpServer_keepAlive (HttpServer_DeviceHandle dev, uint8_t client)
+{
+#if (HTTPSERVER_KEEPALIVE == 1)
+    HttpServer_ClientHandle c = &dev->clients[client];
+
+    if (c->message.version == HTTPSERVER_VERSION_1_1)
+    {
+        if (c->message.flags & HTTPSERVER_MESSAGEFLAGS_CLOSE)
+            return false;
+    }
+    else if ((c->message.flags & HTTPSERVER_MESSAGEFLAGS_KEEPALIVE) == 0)
+    {
+        return false;
+    }
+
+    // The unread body would be parsed as the next request, and an idle
+    // connection must not take the slot of a new one under load. A body
+    // with a Transfer-Encoding has no Content-Length but it is there.
+    return (c->message.contentLength == 0) &&
+           ((c->message.flags & HTTPSERVER_MESSAGEFLAGS_TRANSFER_ENCODING) == 0) &&
+           (c->requests < HTTPSERVER_KEEPALIVE_MAX_REQUESTS) &&
+           (dev->activeClients < HTTPSERVER_OVERLOAD_CLIENTS);
+#else
+    (void)dev;
+    (void)client;
+    return false;
+#endif
+}
+
+void HttpServer_beginResponse (HttpServer_DeviceHandle dev,
+                               HttpServer_ResponseCode code,
+                               uint8_t client)
+{
+    HttpServer_txStatus(dev,code,client);
+}
+
+void HttpServer_addHeader (HttpServer_DeviceHandle dev,
+                           HttpServer_Header header,
+                           const char* value,
+                           uint8_t client)
+{
+    if (header >= HTTPSERVER_HEADER_NUMBER)
+        return;
+
+    HttpServer_txAppend(dev,
+                        client,
+                        HttpServer_headerNames[header].name,
+                        HttpServer_headerNames[header].length);
+    HttpServer_txAppend(dev,client,value,strlen(value));
+    HttpServer_txAppend(dev,client,"\r\n",2);
+}
+
+void HttpServer_addHeaderName (HttpServer_DeviceHandle dev,
+                               const char* name,
+                               const char* value,
+                               uint8_t client)
+{
+    HttpServer_txAppend(dev,client,name,strlen(name));
+    HttpServer_txAppend(dev,client,": ",2);
+    HttpServer_txAppend(dev,client,value,strlen(value));
+    HttpServer_txAppend(dev,client,"\r\n",2);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function appends the framing headers and the end of the header
+ * section.
+ *@return true when the connection is kept alive after the response
+ */
+static bool HttpServer_addFraming (HttpServer_DeviceHandle dev,
+                                   uint32_t length,
+                                   uint8_t client)
+{
+    char number[HTTPSERVER_INTEGER_MAX_LENGTH];
+    bool alive = HttpServer_keepAlive(dev,client);
+    uint32_t now;
+
+    HttpServer_txAppend(dev,client,"Content-Length: ",16);
+    HttpServer_txAppend(dev,client,number,HttpServer_formatInteger(number,length));
+    HttpServer_txAppend(dev,client,"\r\n",2);
+
+    if (dev->clockCallback != 0)
+    {
+        // The date changes at most once per second
+        now = dev->clockCallback(dev->appDevice);
+        if ((now != dev->dateTime) || (dev->date[0] == '\0'))
+        {
+            HttpServer_formatDate(dev->date,now);
+            dev->dateTime = now;
+        }
+        HttpServer_txAppend(dev,client,"Date: ",6);
+        HttpServer_txAppend(dev,client,dev->date,29);
+        HttpServer_txAppend(dev,client,"\r\n",2);
+    }
+
+    HttpServer_txAppend(dev,client,HttpServer_serverHeader,sizeof(HttpServer_serverHeader) - 1);
+    if (alive)
+        HttpServer_txAppend(dev,client,HttpServer_keepAliveHeader,sizeof(HttpServer_keepAliveHeader) - 1);
+    else
+        HttpServer_txAppend(dev,client,HttpServer_closeHeader,sizeof(HttpServer_closeHeader) - 1);
+
+    return alive;
+}
+
+void HttpServer_sendBuiltResponse (HttpServer_DeviceHandle dev,
+                                   const uint8_t* body,
+                                   uint16_t length,
+                                   uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    bool alive = HttpServer_addFraming(dev,length,client);
+
+    if (length > 0)
+        HttpServer_txAppend(dev,client,(const char*)body,length);
+
+    c->txFlags = HTTPSERVER_TXFLAGS_END | (alive ? HTTPSERVER_TXFLAGS_KEEPALIVE : 0);
+}
+
+#if (HTTPSERVER_BORROWED == 1)
+void HttpServer_sendBorrowed (HttpServer_DeviceHandle dev,
+                              const uint8_t* body,
+                              uint32_t length,
+                              void (*done)(void* context, bool sent),
+                              void* context,
+                              uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    bool alive = HttpServer_addFraming(dev,length,client);
+
+    c->txFlags = alive ? HTTPSERVER_TXFLAGS_KEEPALIVE : 0;
+    c->borrowedDone = done;
+    c->borrowedContext = context;
+    if (length > 0)
+    {
+        // The body is sent by the poll after the staged headers
+        c->borrowed = body;
+        c->borrowedRemaining = length;
+    }
+    else
+    {
+        c->borrowed = NULL;
+        c->txFlags |= HTTPSERVER_TXFLAGS_END;
+        if (done != 0)
+            done(context,true);
+    }
+}
+
+uint16_t HttpServer_borrowedDrain (HttpServer_DeviceHandle dev,
+                                   uint8_t client,
+                                   uint16_t limit)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    uint16_t wrote = 0;
+    uint16_t size = limit;
+
+#if (HTTPSERVER_HTTP2 == 1)
+    // The body is sent into DATA frames
+    if (dev->http2.client == client)
+        return HttpServer_http2Drain(dev,client,limit);
+#endif
+
+    // The headers go first
+    if ((c->borrowed == NULL) || (c->txLength > 0))
+        return 0;
+
+    if (size > c->borrowedRemaining)
+        size = c->borrowedRemaining;
+
+    EthernetServerSocket_writeBytes(dev->socketNumber,
+                                    client,
+                                    c->borrowed,
+                                    size,
+                                    &wrote);
+    c->borrowed += wrote;
+    c->borrowedRemaining -= wrote;
+    HTTPSERVER_METRICS_ADD(dev,bytesOut,wrote);
+
+    if (c->borrowedRemaining == 0)
+    {
+        c->txFlags |= HTTPSERVER_TXFLAGS_END;
+        HttpServer_borrowedRelease(dev,client,true);
+    }
+    return wrote;
+}
+
+void HttpServer_borrowedRelease (HttpServer_DeviceHandle dev,
+                                 uint8_t client,
+                                 bool sent)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+
+    if (c->borrowed == NULL)
+        return;
+
+    // Cleared first, the application can start another send from done
+    c->borrowed = NULL;
+    if (c->borrowedDone != 0)
+        c->borrowedDone(c->borrowedContext,sent);
+}
+#endif
@@ -0,0 +1,2377 @@
+/*
+ * A simple HTTP/SERVER library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * HTTP/2 over cleartext (RFC 9113). A client reaches it with prior
+ * knowledge, sending the "PRI * HTTP/2.0" connection preface in place of a
+ * request line, or asking the upgrade of an HTTP/1.1 request to h2c.
+ *
+ * The streams wait into a small buffer, with their headers decoded into the
+ * HTTP/1.1 form, and they are performed one at a time by the handlers of
+ * HTTP/1.1: the response they stage is translated into HEADERS and DATA
+ * frames while it is sent, so every way to build a response works
+ * unchanged. The response headers are HPACK encoded without Huffman coding,
+ * the body goes straight from the trasmission buffer, or from the borrowed
+ * buffer, to the socket after the frame header. The request bodies are
+ * dropped: the requests which need them, or which need the whole
+ * connection, are reset with HTTP_1_1_REQUIRED so that the client can retry
+ * them with HTTP/1.1.
+ */
+
+#include "http-server.h"
+#include "http-server-internal.h"
+
+#if (HTTPSERVER_HTTP2 == 1)
+
+#if (HTTPSERVER_HTTP2_TABLE_DIMENSION < 64) || (HTTPSERVER_HTTP2_TABLE_DIMENSION > 4096)
+#error "HTTPSERVER_HTTP2_TABLE_DIMENSION must be between 64 and 4096"
+#endif
+#if (HTTPSERVER_HTTP2_PENDING_DIMENSION > 65535)
+#error "HTTPSERVER_HTTP2_PENDING_DIMENSION must not be greater than 65535"
+#endif
+#if (HTTPSERVER_HTTP2_OUT_DIMENSION < 160) || (HTTPSERVER_HTTP2_OUT_DIMENSION > 65535)
+#error "HTTPSERVER_HTTP2_OUT_DIMENSION must be between 160 and 65535"
+#endif
+#if (HTTPSERVER_HTTP2_STREAMS == 0) || (HTTPSERVER_HTTP2_STREAMS > 255)
+#error "HTTPSERVER_HTTP2_STREAMS must be between 1 and 255"
+#endif
+#if ((HTTPSERVER_HTTP2_PENDING_DIMENSION / HTTPSERVER_HTTP2_STREAMS) < 128)
+#error "HTTPSERVER_HTTP2_PENDING_DIMENSION must give at least 128 bytes to each one of HTTPSERVER_HTTP2_STREAMS"
+#endif
+#if (HTTPSERVER_HTTP2_WINDOW == 0) || (HTTPSERVER_HTTP2_WINDOW > 65535)
+#error "HTTPSERVER_HTTP2_WINDOW must be between 1 and 65535"
+#endif
+
+/**
+ * @ingroup httpServer_macros
+ * Frame types.
+ */
+#define HTTPSERVER_HTTP2_DATA                 0x00
+#define HTTPSERVER_HTTP2_HEADERS              0x01
+#define HTTPSERVER_HTTP2_PRIORITY             0x02
+#define HTTPSERVER_HTTP2_RST_STREAM           0x03
+#define HTTPSERVER_HTTP2_SETTINGS             0x04
+#define HTTPSERVER_HTTP2_PUSH_PROMISE         0x05
+#define HTTPSERVER_HTTP2_PING                 0x06
+#define HTTPSERVER_HTTP2_GOAWAY               0x07
+#define HTTPSERVER_HTTP2_WINDOW_UPDATE        0x08
+#define HTTPSERVER_HTTP2_CONTINUATION         0x09
+
+/**
+ * @ingroup httpServer_macros
+ * Frame flags.
+ */
+#define HTTPSERVER_HTTP2_END_STREAM           0x01
+#define HTTPSERVER_HTTP2_ACK                  0x01
+#define HTTPSERVER_HTTP2_END_HEADERS          0x04
+#define HTTPSERVER_HTTP2_PADDED               0x08
+#define HTTPSERVER_HTTP2_PRIORITY_FLAG        0x20
+
+/**
+ * @ingroup httpServer_macros
+ * Error codes of RST_STREAM and GOAWAY.
+ */
+#define HTTPSERVER_HTTP2_NO_ERROR             0x00
+#define HTTPSERVER_HTTP2_PROTOCOL_ERROR       0x01
+#define HTTPSERVER_HTTP2_INTERNAL_ERROR       0x02
+#define HTTPSERVER_HTTP2_FLOW_CONTROL_ERROR   0x03
+#define HTTPSERVER_HTTP2_FRAME_SIZE_ERROR     0x06
+#define HTTPSERVER_HTTP2_REFUSED_STREAM       0x07
+#define HTTPSERVER_HTTP2_COMPRESSION_ERROR    0x09
+#define HTTPSERVER_HTTP2_ENHANCE_YOUR_CALM    0x0B
+#define HTTPSERVER_HTTP2_HTTP_1_1_REQUIRED    0x0D
+
+/**
+ * @ingroup httpServer_macros
+ * Settings identifiers.
+ */
+#define HTTPSERVER_HTTP2_HEADER_TABLE_SIZE    0x01
+#define HTTPSERVER_HTTP2_MAX_CONCURRENT       0x03
+#define HTTPSERVER_HTTP2_INITIAL_WINDOW_SIZE  0x04
+#define HTTPSERVER_HTTP2_MAX_FRAME_SIZE       0x05
+#define HTTPSERVER_HTTP2_MAX_HEADER_LIST_SIZE 0x06
+
+/**
+ * @ingroup httpServer_macros
+ * Flags of @ref HttpServer_Http2 flags.
+ */
+///GOAWAY is queued, the connection is closed when the frames are sent
+#define HTTPSERVER_HTTP2_FLAGS_CLOSING        0x0001
+///GOAWAY received: no new streams are performed
+#define HTTPSERVER_HTTP2_FLAGS_PEER_GOAWAY    0x0002
+///The received header block goes on with CONTINUATION frames
+#define HTTPSERVER_HTTP2_FLAGS_BLOCK          0x0004
+///The sent header block goes on with CONTINUATION frames: no other frame
+///can be queued
+#define HTTPSERVER_HTTP2_FLAGS_CONTINUATION   0x0008
+///The current stream has been reset
+#define HTTPSERVER_HTTP2_FLAGS_RESET          0x0010
+///END_STREAM has been sent on the current stream
+#define HTTPSERVER_HTTP2_FLAGS_ENDED          0x0020
+///The response of the current stream has no body
+#define HTTPSERVER_HTTP2_FLAGS_EMPTY          0x0040
+///The size of the response headers table changed, the next block tells it
+#define HTTPSERVER_HTTP2_FLAGS_TABLE_SIZE     0x0080
+///The response of the current stream has the chunked coding
+#define HTTPSERVER_HTTP2_FLAGS_CHUNKED        0x0100
+
+/**
+ * @ingroup httpServer_macros
+ * Translation phases of the staged response.
+ */
+#define HTTPSERVER_HTTP2_PHASE_STATUS         0
+#define HTTPSERVER_HTTP2_PHASE_INTERIM        1
+#define HTTPSERVER_HTTP2_PHASE_HEADERS        2
+#define HTTPSERVER_HTTP2_PHASE_BODY           3
+#define HTTPSERVER_HTTP2_PHASE_CHUNK_SIZE     4
+#define HTTPSERVER_HTTP2_PHASE_CHUNK_DATA     5
+#define HTTPSERVER_HTTP2_PHASE_CHUNK_END      6
+#define HTTPSERVER_HTTP2_PHASE_TRAILER        7
+#define HTTPSERVER_HTTP2_PHASE_DONE           8
+
+///Length of the frame header
+#define HTTPSERVER_HTTP2_FRAME_HEADER         9
+///Max frame payload, SETTINGS_MAX_FRAME_SIZE is never changed
+#define HTTPSERVER_HTTP2_FRAME_MAX            16384
+///Room of the frames buffer kept for the answers to a received frame
+#define HTTPSERVER_HTTP2_CONTROL_ROOM         32
+///Initial size of a HPACK table and initial window
+#define HTTPSERVER_HTTP2_HPACK_DEFAULT        4096
+#define HTTPSERVER_HTTP2_WINDOW_DEFAULT       65535
+///Number of entries of the HPACK static table
+#define HTTPSERVER_HTTP2_STATIC_NUMBER        61
+///Offset of a stream which is not waiting
+#define HTTPSERVER_HTTP2_NOT_FOUND            0xFFFF
+///Name length of a table entry whose strings are lost, the value length
+///is its HPACK size
+#define HTTPSERVER_HTTP2_ENTRY_LOST           0xFFFF
+
+/**
+ * @ingroup httpServer_functions
+ * The record of a waiting stream, followed into the pending buffer by its
+ * header lines terminated with '\0'. It is copied in and out, the buffer is
+ * not aligned.
+ */
+typedef struct _HttpServer_Http2Stream
+{
+    uint32_t id;
+    int32_t window;
+    uint16_t length;
+} HttpServer_Http2Stream;
+
+/**
+ * @ingroup httpServer_functions
+ * The max header list size advertised to the client: the share of each
+ * stream of the pending buffer, so that all the streams which can be
+ * opened fit together. The kept lines are never longer than the header
+ * list size of RFC 9113, which counts 32 bytes more for each field.
+ */
+#define HTTPSERVER_HTTP2_HEADER_LIST \
+    ((HTTPSERVER_HTTP2_PENDING_DIMENSION / HTTPSERVER_HTTP2_STREAMS) - sizeof(HttpServer_Http2Stream))
+
+/**
+ * @ingroup httpServer_functions
+ * The client connection preface.
+ */
+static const char HttpServer_http2Preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+/**
+ * @ingroup httpServer_functions
+ * The answer to a client which can't use HTTP/2 because the connection is
+ * taken: empty SETTINGS and GOAWAY with HTTP_1_1_REQUIRED.
+ */
+static const uint8_t HttpServer_http2Busy[] =
+{
+    0x00, 0x00, 0x00, HTTPSERVER_HTTP2_SETTINGS, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x08, HTTPSERVER_HTTP2_GOAWAY, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, HTTPSERVER_HTTP2_HTTP_1_1_REQUIRED,
+};
+
+/**
+ * @ingroup httpServer_functions
+ * The HPACK static table (RFC 7541, appendix A).
+ */
+static const struct
+{
+    const char* name;
+    const char* value;
+} HttpServer_hpackStatic[HTTPSERVER_HTTP2_STATIC_NUMBER] =
+{
+    {":authority",""},
+    {":method","GET"},
+    {":method","POST"},
+    {":path","/"},
+    {":path","/index.html"},
+    {":scheme","http"},
+    {":scheme","https"},
+    {":status","200"},
+    {":status","204"},
+    {":status","206"},
+    {":status","304"},
+    {":status","400"},
+    {":status","404"},
+    {":status","500"},
+    {"accept-charset",""},
+    {"accept-encoding","gzip, deflate"},
+    {"accept-language",""},
+    {"accept-ranges",""},
+    {"accept",""},
+    {"access-control-allow-origin",""},
+    {"age",""},
+    {"allow",""},
+    {"authorization",""},
+    {"cache-control",""},
+    {"content-disposition",""},
+    {"content-encoding",""},
+    {"content-language",""},
+    {"content-length",""},
+    {"content-location",""},
+    {"content-range",""},
+    {"content-type",""},
+    {"cookie",""},
+    {"date",""},
+    {"etag",""},
+    {"expect",""},
+    {"expires",""},
+    {"from",""},
+    {"host",""},
+    {"if-match",""},
+    {"if-modified-since",""},
+    {"if-none-match",""},
+    {"if-range",""},
+    {"if-unmodified-since",""},
+    {"last-modified",""},
+    {"link",""},
+    {"location",""},
+    {"max-forwards",""},
+    {"proxy-authenticate",""},
+    {"proxy-authorization",""},
+    {"range",""},
+    {"referer",""},
+    {"refresh",""},
+    {"retry-after",""},
+    {"server",""},
+    {"set-cookie",""},
+    {"strict-transport-security",""},
+    {"transfer-encoding",""},
+    {"user-agent",""},
+    {"vary",""},
+    {"via",""},
+    {"www-authenticate",""},
+};
+
+/**
+ * @ingroup httpServer_functions
+ * The HPACK Huffman code (RFC 7541, appendix B) is canonical: it is
+ * defined by the number of codes of each length, from 1 to 30 bits, and by
+ * the symbols sorted by code. EOS is the last code and it isn't listed.
+ */
+static const uint8_t HttpServer_hpackHuffmanCount[30] =
+{
+    0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+    0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4,
+};
+
+static const uint8_t HttpServer_hpackHuffmanSymbol[256] =
+{
+     48,  49,  50,  97,  99, 101, 105, 111, 115, 116,  32,  37,  45,  46,  47,  51,
+     52,  53,  54,  55,  56,  57,  61,  65,  95,  98, 100, 102, 103, 104, 108, 109,
+    110, 112, 114, 117,  58,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,
+     77,  78,  79,  80,  81,  82,  83,  84,  85,  86,  87,  89, 106, 107, 113, 118,
+    119, 120, 121, 122,  38,  42,  44,  59,  88,  90,  33,  34,  40,  41,  63,  39,
+     43, 124,  35,  62,   0,  36,  64,  91,  93, 126,  94, 125,  60,  96, 123,  92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+    179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+    163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233,   1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+    158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239,   9, 142,
+    144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+    212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+      2,   3,   4,   5,   6,   7,   8,  11,  12,  14,  15,  16,  17,  18,  19,  20,
+     21,  23,  24,  25,  26,  27,  28,  29,  30,  31, 127, 220, 249,  10,  13,  22,
+};
+
+/**
+ * @ingroup httpServer_functions
+ * The response headers which change with every response: they are not
+ * added to the dynamic table.
+ */
+static const char* const HttpServer_hpackVolatile[] =
+{
+    "age",
+    "content-length",
+    "content-range",
+    "date",
+    "etag",
+    "expires",
+    "last-modified",
+    "location",
+    "retry-after",
+    "set-cookie",
+};
+
+/**
+ * @ingroup httpServer_functions
+ * The headers of HTTP/1.1 which are not allowed in HTTP/2.
+ */
+static const char* const HttpServer_http2Connection[] =
+{
+    "connection",
+    "http2-settings",
+    "keep-alive",
+    "proxy-connection",
+    "transfer-encoding",
+    "upgrade",
+};
+
+static inline void HttpServer_http2Put32 (uint8_t* buffer, uint32_t value)
+{
+    buffer[0] = (value >> 24) & 0xFF;
+    buffer[1] = (value >> 16) & 0xFF;
+    buffer[2] = (value >> 8) & 0xFF;
+    buffer[3] = value & 0xFF;
+}
+
+static inline uint32_t HttpServer_http2Get32 (const uint8_t* buffer)
+{
+    return ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) |
+           ((uint32_t)buffer[2] << 8) | buffer[3];
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function tells whether a string of the given length is in a list.
+ */
+static bool HttpServer_http2Listed (const char* const* list,
+                                    uint8_t number,
+                                    const char* name,
+                                    uint16_t length)
+{
+    for (uint8_t i = 0; i < number; ++i)
+    {
+        if ((strlen(list[i]) == length) && (memcmp(list[i],name,length) == 0))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function tells whether a field name or value can be written into a
+ * header line: CR, LF and NUL are not allowed (RFC 9113 8.2.1).
+ */
+static bool HttpServer_http2Valid (const char* text, uint16_t length)
+{
+    for (uint16_t i = 0; i < length; ++i)
+    {
+        if ((text[i] == '\r') || (text[i] == '\n') || (text[i] == '\0'))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function writes a frame header.
+ */
+static void HttpServer_http2FrameHeader (uint8_t* header,
+                                         uint32_t length,
+                                         uint8_t type,
+                                         uint8_t flags,
+                                         uint32_t stream)
+{
+    header[0] = (length >> 16) & 0xFF;
+    header[1] = (length >> 8) & 0xFF;
+    header[2] = length & 0xFF;
+    header[3] = type;
+    header[4] = flags;
+    HttpServer_http2Put32(&header[5],stream & 0x7FFFFFFF);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function queues a frame into the frames buffer.
+ *@return false when there isn't room for it
+ */
+static bool HttpServer_http2Queue (HttpServer_Http2* h2,
+                                   uint8_t type,
+                                   uint8_t flags,
+                                   uint32_t stream,
+                                   const uint8_t* payload,
+                                   uint16_t length)
+{
+    if ((h2->outLength + HTTPSERVER_HTTP2_FRAME_HEADER + length) > HTTPSERVER_HTTP2_OUT_DIMENSION)
+        return false;
+
+    HttpServer_http2FrameHeader(&h2->out[h2->outLength],length,type,flags,stream);
+    h2->outLength += HTTPSERVER_HTTP2_FRAME_HEADER;
+    if (length > 0)
+    {
+        memcpy(&h2->out[h2->outLength],payload,length);
+        h2->outLength += length;
+    }
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function queues RST_STREAM.
+ */
+static void HttpServer_http2Reset (HttpServer_DeviceHandle dev,
+                                   uint8_t client,
+                                   uint32_t stream,
+                                   uint32_t code)
+{
+    uint8_t payload[4];
+
+    HttpServer_http2Put32(payload,code);
+    HttpServer_http2Queue(&dev->http2,HTTPSERVER_HTTP2_RST_STREAM,0,stream,payload,4);
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_HTTP2_RESET,client,stream & 0xFFFF,code);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function queues GOAWAY: nothing else is received and the connection
+ * is closed when the queued frames are sent.
+ */
+static void HttpServer_http2GoAway (HttpServer_DeviceHandle dev,
+                                    uint8_t client,
+                                    uint32_t code)
+{
+    HttpServer_Http2* h2 = &dev->http2;
+    HttpServer_Http2Stream stream;
+    uint32_t last = h2->lastStream;
+    uint8_t payload[8];
+
+    if (h2->flags & HTTPSERVER_HTTP2_FLAGS_CLOSING)
+        return;
+
+    // The waiting streams are not performed, the client can retry them
+    if (h2->pendingCount > 0)
+    {
+        memcpy(&stream,h2->pending,sizeof(stream));
+        last = (stream.id > 2) ? stream.id - 2 : 0;
+    }
+    h2->pendingLength = 0;
+    h2->pendingCount = 0;
+
+    HttpServer_http2Put32(&payload[0],last);
+    HttpServer_http2Put32(&payload[4],code);
+    HttpServer_http2Queue(h2,HTTPSERVER_HTTP2_GOAWAY,0,0,payload,8);
+    h2->flags |= HTTPSERVER_HTTP2_FLAGS_CLOSING;
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_HTTP2_GOAWAY,client,code,last & 0xFFFF);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function queues WINDOW_UPDATE.
+ */
+static void HttpServer_http2WindowUpdate (HttpServer_Http2* h2,
+                                          uint32_t stream,
+                                          uint32_t increment)
+{
+    uint8_t payload[4];
+
+    HttpServer_http2Put32(payload,increment);
+    HttpServer_http2Queue(h2,HTTPSERVER_HTTP2_WINDOW_UPDATE,0,stream,payload,4);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function queues the settings of the server.
+ */
+static void HttpServer_http2Settings (HttpServer_Http2* h2)
+{
+    static const uint8_t settings[] =
+    {
+        0x00, HTTPSERVER_HTTP2_HEADER_TABLE_SIZE, 0x00, 0x00,
+        (HTTPSERVER_HTTP2_TABLE_DIMENSION >> 8) & 0xFF, HTTPSERVER_HTTP2_TABLE_DIMENSION & 0xFF,
+        0x00, HTTPSERVER_HTTP2_MAX_CONCURRENT, 0x00, 0x00, 0x00, HTTPSERVER_HTTP2_STREAMS,
+        0x00, HTTPSERVER_HTTP2_INITIAL_WINDOW_SIZE, 0x00, 0x00,
+        (HTTPSERVER_HTTP2_WINDOW >> 8) & 0xFF, HTTPSERVER_HTTP2_WINDOW & 0xFF,
+        0x00, HTTPSERVER_HTTP2_MAX_HEADER_LIST_SIZE, 0x00, 0x00,
+        (HTTPSERVER_HTTP2_HEADER_LIST >> 8) & 0xFF, HTTPSERVER_HTTP2_HEADER_LIST & 0xFF,
+    };
+
+    HttpServer_http2Queue(h2,HTTPSERVER_HTTP2_SETTINGS,0,0,settings,sizeof(settings));
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function sends at most @a limit bytes of the queued frames.
+ *@return The number of bytes accepted by the socket
+ */
+static uint16_t HttpServer_http2Send (HttpServer_DeviceHandle dev,
+                                      uint8_t client,
+                                      uint16_t limit)
+{
+    HttpServer_Http2* h2 = &dev->http2;
+    uint16_t size = h2->outLength - h2->outSent;
+    uint16_t wrote = 0;
+
+    if (size > limit)
+        size = limit;
+    if (size == 0)
+        return 0;
+
+    EthernetServerSocket_writeBytes(dev->socketNumber,
+                                    client,
+                                    &h2->out[h2->outSent],
+                                    size,
+                                    &wrote);
+    HTTPSERVER_METRICS_ADD(dev,bytesOut,wrote);
+    h2->outSent += wrote;
+
+    // The unsent frames are moved back, the buffer is small
+    if (h2->outSent == h2->outLength)
+    {
+        h2->outLength = 0;
+    }
+    else if (h2->outSent > 0)
+    {
+        memmove(h2->out,&h2->out[h2->outSent],h2->outLength - h2->outSent);
+        h2->outLength -= h2->outSent;
+    }
+    h2->outSent = 0;
+    return wrote;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function gives the bytes taken by an entry into the table buffer.
+ */
+static uint16_t HttpServer_hpackLength (const uint8_t* entry)
+{
+    uint16_t nameLength = (entry[0] << 8) | entry[1];
+
+    if (nameLength == HTTPSERVER_HTTP2_ENTRY_LOST)
+        return 4;
+    return 4 + nameLength + ((entry[2] << 8) | entry[3]);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function gives the HPACK size of an entry.
+ */
+static uint16_t HttpServer_hpackSize (const uint8_t* entry)
+{
+    uint16_t nameLength = (entry[0] << 8) | entry[1];
+    uint16_t valueLength = (entry[2] << 8) | entry[3];
+
+    if (nameLength == HTTPSERVER_HTTP2_ENTRY_LOST)
+        return valueLength;
+    return nameLength + valueLength + 32;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function gets an entry of the static table, or of a dynamic table.
+ *@return false when the index is not valid, or the entry has been lost
+ */
+static bool HttpServer_hpackEntry (const HttpServer_Hpack* table,
+                                   uint32_t index,
+                                   const char** name,
+                                   uint16_t* nameLength,
+                                   const char** value,
+                                   uint16_t* valueLength)
+{
+    const uint8_t* entry = table->buffer;
+
+    if (index == 0)
+        return false;
+
+    if (index <= HTTPSERVER_HTTP2_STATIC_NUMBER)
+    {
+        *name = HttpServer_hpackStatic[index - 1].name;
+        *value = HttpServer_hpackStatic[index - 1].value;
+        *nameLength = strlen(*name);
+        *valueLength = strlen(*value);
+        return true;
+    }
+
+    index -= HTTPSERVER_HTTP2_STATIC_NUMBER + 1;
+    if (index >= table->count)
+        return false;
+
+    while (index-- > 0)
+        entry += HttpServer_hpackLength(entry);
+
+    *nameLength = (entry[0] << 8) | entry[1];
+    *valueLength = (entry[2] << 8) | entry[3];
+    *name = (const char*)&entry[4];
+    *value = (const char*)&entry[4 + *nameLength];
+    return (*nameLength != HTTPSERVER_HTTP2_ENTRY_LOST);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function evicts the oldest entry of a dynamic table.
+ */
+static void HttpServer_hpackDrop (HttpServer_Hpack* table)
+{
+    uint16_t offset = 0;
+
+    for (uint8_t i = 1; i < table->count; ++i)
+        offset += HttpServer_hpackLength(&table->buffer[offset]);
+
+    table->size -= HttpServer_hpackSize(&table->buffer[offset]);
+    table->length = offset;
+    table->count--;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function drops the strings of the oldest entry which still has
+ * them, keeping its place and its size.
+ *@return false when no entry has strings
+ */
+static bool HttpServer_hpackForget (HttpServer_Hpack* table)
+{
+    uint16_t offset = 0;
+    uint16_t found = table->length;
+    uint16_t length;
+    uint16_t size;
+
+    for (uint8_t i = 0; i < table->count; ++i)
+    {
+        if (((table->buffer[offset] << 8) | table->buffer[offset + 1]) != HTTPSERVER_HTTP2_ENTRY_LOST)
+            found = offset;
+        offset += HttpServer_hpackLength(&table->buffer[offset]);
+    }
+    if (found == table->length)
+        return false;
+
+    length = HttpServer_hpackLength(&table->buffer[found]);
+    size = HttpServer_hpackSize(&table->buffer[found]);
+    table->buffer[found] = HTTPSERVER_HTTP2_ENTRY_LOST >> 8;
+    table->buffer[found + 1] = HTTPSERVER_HTTP2_ENTRY_LOST & 0xFF;
+    table->buffer[found + 2] = size >> 8;
+    table->buffer[found + 3] = size & 0xFF;
+    memmove(&table->buffer[found + 4],&table->buffer[found + length],table->length - found - length);
+    table->length -= length - 4;
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function changes the max size of a dynamic table.
+ */
+static void HttpServer_hpackResize (HttpServer_Hpack* table, uint16_t max)
+{
+    table->max = max;
+    while (table->size > table->max)
+        HttpServer_hpackDrop(table);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function adds an entry to a dynamic table, evicting the oldest ones.
+ * An entry bigger than the table empties it. The size of the decoder table
+ * is chosen by the client, and it can be bigger than the buffer until the
+ * client gets the settings: then the oldest entries lose their strings, and
+ * only a reference to them is an error. The strings of the entry are lost
+ * too when @a name is NULL.
+ *@return false when not even the place of the entry can be kept
+ */
+static bool HttpServer_hpackInsert (HttpServer_Hpack* table,
+                                    const char* name,
+                                    uint16_t nameLength,
+                                    const char* value,
+                                    uint16_t valueLength)
+{
+    uint32_t size = (uint32_t)nameLength + valueLength + 32;
+    uint16_t length = nameLength + valueLength + 4;
+
+    if (size > table->max)
+    {
+        table->length = 0;
+        table->count = 0;
+        table->size = 0;
+        return true;
+    }
+
+    while ((table->size + size) > table->max)
+        HttpServer_hpackDrop(table);
+
+    while ((name != NULL) && ((table->length + length) > HTTPSERVER_HTTP2_TABLE_DIMENSION))
+    {
+        if (!HttpServer_hpackForget(table))
+            name = NULL;
+    }
+    if (name == NULL)
+    {
+        length = 4;
+        if ((table->length + length) > HTTPSERVER_HTTP2_TABLE_DIMENSION)
+            return false;
+    }
+
+    memmove(&table->buffer[length],table->buffer,table->length);
+    if (name != NULL)
+    {
+        table->buffer[0] = nameLength >> 8;
+        table->buffer[1] = nameLength & 0xFF;
+        table->buffer[2] = valueLength >> 8;
+        table->buffer[3] = valueLength & 0xFF;
+        memcpy(&table->buffer[4],name,nameLength);
+        memcpy(&table->buffer[4 + nameLength],value,valueLength);
+    }
+    else
+    {
+        table->buffer[0] = HTTPSERVER_HTTP2_ENTRY_LOST >> 8;
+        table->buffer[1] = HTTPSERVER_HTTP2_ENTRY_LOST & 0xFF;
+        table->buffer[2] = size >> 8;
+        table->buffer[3] = size & 0xFF;
+    }
+    table->length += length;
+    table->size += size;
+    table->count++;
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function decodes an HPACK integer with a prefix of @a prefix bits.
+ *@return false when the integer is truncated or too big
+ */
+static bool HttpServer_hpackInteger (const uint8_t** data,
+                                     const uint8_t* end,
+                                     uint8_t prefix,
+                                     uint32_t* value)
+{
+    const uint8_t* p = *data;
+    uint8_t mask = (1 << prefix) - 1;
+    uint8_t shift = 0;
+
+    if (p >= end)
+        return false;
+
+    *value = *p++ & mask;
+    if (*value == mask)
+    {
+        do
+        {
+            if ((p >= end) || (shift > 21))
+                return false;
+            *value += (uint32_t)(*p & 0x7F) << shift;
+            shift += 7;
+        } while (*p++ & 0x80);
+    }
+    *data = p;
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function decodes a Huffman coded string, walking the canonical code
+ * one bit at a time. Only the first @a capacity characters are written.
+ *@return false when the coding is not valid
+ */
+static bool HttpServer_hpackHuffman (const uint8_t* data,
+                                     uint16_t length,
+                                     char* out,
+                                     uint16_t capacity,
+                                     uint16_t* decoded)
+{
+    uint32_t code = 0;
+    uint32_t first = 0;
+    uint16_t index = 0;
+    uint8_t bits = 0;
+
+    *decoded = 0;
+    for (uint16_t i = 0; i < length; ++i)
+    {
+        for (int8_t bit = 7; bit >= 0; --bit)
+        {
+            uint8_t count = HttpServer_hpackHuffmanCount[bits];
+
+            code = (code << 1) | ((data[i] >> bit) & 0x01);
+            bits++;
+
+            if ((code - first) < count)
+            {
+                index += code - first;
+                // EOS can't be in a string
+                if (index >= 256)
+                    return false;
+                if (*decoded < capacity)
+                    out[*decoded] = HttpServer_hpackHuffmanSymbol[index];
+                (*decoded)++;
+                code = 0;
+                first = 0;
+                index = 0;
+                bits = 0;
+            }
+            else
+            {
+                index += count;
+                first = (first + count) << 1;
+                if (bits == 30)
+                    return false;
+            }
+        }
+    }
+
+    // The padding is the beginning of EOS, all ones and shorter than a byte
+    return (bits < 8) && (code == ((1UL << bits) - 1));
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function decodes an HPACK string. Only the first @a capacity
+ * characters are written, @a length is the whole length.
+ *@return false when the string is not valid
+ */
+static bool HttpServer_hpackString (const uint8_t** data,
+                                    const uint8_t* end,
+                                    char* out,
+                                    uint16_t capacity,
+                                    uint16_t* length)
+{
+    bool huffman;
+    uint32_t size;
+
+    if (*data >= end)
+        return false;
+
+    huffman = (**data & 0x80) != 0;
+    if (!HttpServer_hpackInteger(data,end,7,&size) || (size > (uint32_t)(end - *data)))
+        return false;
+
+    if (huffman)
+    {
+        if (!HttpServer_hpackHuffman(*data,size,out,capacity,length))
+            return false;
+    }
+    else
+    {
+        *length = size;
+        memcpy(out,*data,(size < capacity) ? size : capacity);
+    }
+    *data += size;
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function encodes an HPACK integer with a prefix of @a prefix bits.
+ *@return The number of bytes written
+ */
+static uint8_t HttpServer_hpackEncodeInteger (uint8_t* out,
+                                              uint8_t first,
+                                              uint8_t prefix,
+                                              uint32_t value)
+{
+    uint8_t mask = (1 << prefix) - 1;
+    uint8_t length = 1;
+
+    if (value < mask)
+    {
+        out[0] = first | value;
+        return 1;
+    }
+
+    out[0] = first | mask;
+    value -= mask;
+    while (value >= 0x80)
+    {
+        out[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[length++] = value;
+    return length;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function encodes a response header, whose name is lowercase, into
+ * the frames buffer: a header of a table is indexed, the others are added
+ * to the dynamic table when they don't change with every response.
+ * The caller checks that there is room for the strings and 12 bytes more.
+ */
+static void HttpServer_hpackEncode (HttpServer_Http2* h2,
+                                    const char* name,
+                                    uint16_t nameLength,
+                                    const char* value,
+                                    uint16_t valueLength)
+{
+    HttpServer_Hpack* table = &h2->encoder;
+    uint8_t* out = &h2->out[h2->outLength];
+    uint16_t length;
+    uint32_t nameIndex = 0;
+    bool indexing;
+
+    for (uint32_t i = 1; i <= (uint32_t)(HTTPSERVER_HTTP2_STATIC_NUMBER + table->count); ++i)
+    {
+        const char* entryName;
+        const char* entryValue;
+        uint16_t entryNameLength, entryValueLength;
+
+        HttpServer_hpackEntry(table,i,&entryName,&entryNameLength,&entryValue,&entryValueLength);
+        if ((entryNameLength != nameLength) || (memcmp(entryName,name,nameLength) != 0))
+            continue;
+
+        if ((entryValueLength == valueLength) && (memcmp(entryValue,value,valueLength) == 0))
+        {
+            h2->outLength += HttpServer_hpackEncodeInteger(out,0x80,7,i);
+            return;
+        }
+        if (nameIndex == 0)
+            nameIndex = i;
+    }
+
+    indexing = ((nameLength + valueLength + 32) <= table->max) &&
+               !HttpServer_http2Listed(HttpServer_hpackVolatile,
+                                       sizeof(HttpServer_hpackVolatile) / sizeof(HttpServer_hpackVolatile[0]),
+                                       name,
+                                       nameLength);
+
+    // Incremental indexing, or without indexing
+    length = HttpServer_hpackEncodeInteger(out,indexing ? 0x40 : 0x00,indexing ? 6 : 4,nameIndex);
+    if (nameIndex == 0)
+    {
+        length += HttpServer_hpackEncodeInteger(&out[length],0x00,7,nameLength);
+        memcpy(&out[length],name,nameLength);
+        length += nameLength;
+    }
+    length += HttpServer_hpackEncodeInteger(&out[length],0x00,7,valueLength);
+    memcpy(&out[length],value,valueLength);
+    length += valueLength;
+    h2->outLength += length;
+
+    if (indexing)
+        HttpServer_hpackInsert(table,name,nameLength,value,valueLength);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function decodes the header block received into the receive buffer
+ * of the client. Every header is written as a "name: value" line,
+ * terminated with '\0', after the last waiting stream: the :authority
+ * pseudo-header becomes the Host header, :method and :path are kept for
+ * the dispatch, the other pseudo-headers and the connection headers are
+ * dropped. The lines beyond the share of the stream, see
+ * @ref HTTPSERVER_HTTP2_HEADER_LIST , are not kept, but the block is decoded
+ * anyway to keep the table in sync.
+ *@param[out] textLength The length of the lines, 0 when they aren't kept
+ *@param[out] malformed Set when a field can't be written into a line
+ *@return The HTTP/2 error code
+ */
+static uint32_t HttpServer_http2Decode (HttpServer_DeviceHandle dev,
+                                        uint8_t client,
+                                        uint16_t* textLength,
+                                        bool* malformed)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_Http2* h2 = &dev->http2;
+    const uint8_t* p = c->rxBuffer;
+    const uint8_t* end = c->rxBuffer + h2->blockLength;
+    char* text = (char*)&h2->pending[h2->pendingLength + sizeof(HttpServer_Http2Stream)];
+    uint16_t room = HTTPSERVER_HTTP2_PENDING_DIMENSION - h2->pendingLength - sizeof(HttpServer_Http2Stream);
+    uint16_t length = 0;
+    bool kept = true;
+
+    while (p < end)
+    {
+        char* line = &text[length];
+        uint16_t capacity = room - length;
+        uint16_t nameLength, valueLength, lineLength;
+        const char* name;
+        const char* value;
+        uint32_t index;
+        bool indexing = false;
+
+        if (*p & 0x80)
+        {
+            // Indexed header
+            if (!HttpServer_hpackInteger(&p,end,7,&index) ||
+                !HttpServer_hpackEntry(&h2->decoder,index,&name,&nameLength,&value,&valueLength))
+                return HTTPSERVER_HTTP2_COMPRESSION_ERROR;
+            if ((nameLength + valueLength + 3) > capacity)
+            {
+                kept = false;
+                continue;
+            }
+            memcpy(line,name,nameLength);
+            memcpy(&line[nameLength + 2],value,valueLength);
+        }
+        else if ((*p & 0xE0) == 0x20)
+        {
+            // Dynamic table size update
+            if (!HttpServer_hpackInteger(&p,end,5,&index) || (index > HTTPSERVER_HTTP2_HPACK_DEFAULT))
+                return HTTPSERVER_HTTP2_COMPRESSION_ERROR;
+            HttpServer_hpackResize(&h2->decoder,index);
+            continue;
+        }
+        else
+        {
+            // Literal header, with incremental indexing or not
+            indexing = (*p & 0x40) != 0;
+            if (!HttpServer_hpackInteger(&p,end,indexing ? 6 : 4,&index))
+                return HTTPSERVER_HTTP2_COMPRESSION_ERROR;
+            if (index > 0)
+            {
+                if (!HttpServer_hpackEntry(&h2->decoder,index,&name,&nameLength,&value,&valueLength))
+                    return HTTPSERVER_HTTP2_COMPRESSION_ERROR;
+                memcpy(line,name,(nameLength < capacity) ? nameLength : capacity);
+            }
+            else if (!HttpServer_hpackString(&p,end,line,capacity,&nameLength))
+            {
+                return HTTPSERVER_HTTP2_COMPRESSION_ERROR;
+            }
+            if (!HttpServer_hpackString(&p,
+                                        end,
+                                        &line[nameLength + 2],
+                                        ((nameLength + 2) < capacity) ? capacity - nameLength - 2 : 0,
+                                        &valueLength))
+                return HTTPSERVER_HTTP2_COMPRESSION_ERROR;
+
+            // The strings of an entry bigger than the room left are lost
+            if (indexing &&
+                !HttpServer_hpackInsert(&h2->decoder,
+                                        ((nameLength + valueLength + 3) <= capacity) ? line : NULL,
+                                        nameLength,
+                                        &line[nameLength + 2],
+                                        valueLength))
+                return HTTPSERVER_HTTP2_COMPRESSION_ERROR;
+        }
+
+        lineLength = nameLength + valueLength + 3;
+        if (lineLength > capacity)
+        {
+            kept = false;
+            continue;
+        }
+        // A line break would inject another header into the request
+        if (!HttpServer_http2Valid(line,nameLength) ||
+            !HttpServer_http2Valid(&line[nameLength + 2],valueLength))
+        {
+            *malformed = true;
+            continue;
+        }
+        line[nameLength] = ':';
+        line[nameLength + 1] = ' ';
+        line[nameLength + 2 + valueLength] = '\0';
+
+        if ((nameLength == 10) && (memcmp(line,":authority",10) == 0))
+        {
+            memmove(&line[4],&line[10],valueLength + 3);
+            memcpy(line,"host",4);
+            lineLength -= 6;
+        }
+        else if ((line[0] == ':') &&
+                 !((nameLength == 7) && (memcmp(line,":method",7) == 0)) &&
+                 !((nameLength == 5) && (memcmp(line,":path",5) == 0)))
+        {
+            continue;
+        }
+        else if (HttpServer_http2Listed(HttpServer_http2Connection,
+                                        sizeof(HttpServer_http2Connection) / sizeof(HttpServer_http2Connection[0]),
+                                        line,
+                                        nameLength))
+        {
+            continue;
+        }
+
+        // The share of the other streams is kept
+        if ((length + lineLength) > HTTPSERVER_HTTP2_HEADER_LIST)
+        {
+            kept = false;
+            continue;
+        }
+        length += lineLength;
+    }
+
+    *textLength = kept ? length : 0;
+    return HTTPSERVER_HTTP2_NO_ERROR;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function finds a waiting stream.
+ *@return The offset of its record, HTTPSERVER_HTTP2_NOT_FOUND when it isn't
+ * waiting
+ */
+static uint16_t HttpServer_http2Find (const HttpServer_Http2* h2, uint32_t id)
+{
+    HttpServer_Http2Stream stream;
+    uint16_t offset = 0;
+
+    while (offset < h2->pendingLength)
+    {
+        memcpy(&stream,&h2->pending[offset],sizeof(stream));
+        if (stream.id == id)
+            return offset;
+        offset += sizeof(stream) + stream.length;
+    }
+    return HTTPSERVER_HTTP2_NOT_FOUND;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function removes a waiting stream.
+ */
+static void HttpServer_http2Remove (HttpServer_Http2* h2, uint16_t offset)
+{
+    HttpServer_Http2Stream stream;
+    uint16_t size;
+
+    memcpy(&stream,&h2->pending[offset],sizeof(stream));
+    size = sizeof(stream) + stream.length;
+    memmove(&h2->pending[offset],&h2->pending[offset + size],h2->pendingLength - offset - size);
+    h2->pendingLength -= size;
+    h2->pendingCount--;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function handles a complete header block: a new stream waits for
+ * its turn, or it is refused when there isn't room for it. The blocks of
+ * the other streams, the trailers, only update the table.
+ */
+static void HttpServer_http2Block (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_Http2* h2 = &dev->http2;
+    HttpServer_Http2Stream stream;
+    uint16_t length = 0;
+    uint32_t error;
+    bool opened = (h2->blockStream & 0x01) && (h2->blockStream > h2->lastStream);
+    bool malformed = false;
+
+    h2->flags &= ~HTTPSERVER_HTTP2_FLAGS_BLOCK;
+    error = HttpServer_http2Decode(dev,client,&length,&malformed);
+    if (error != HTTPSERVER_HTTP2_NO_ERROR)
+    {
+        HttpServer_http2GoAway(dev,client,error);
+        return;
+    }
+    if (!opened)
+        return;
+
+    h2->lastStream = h2->blockStream;
+    if (malformed)
+    {
+        HttpServer_http2Reset(dev,client,h2->blockStream,HTTPSERVER_HTTP2_PROTOCOL_ERROR);
+        return;
+    }
+    if ((length == 0) ||
+        ((h2->pendingCount + ((h2->stream != 0) ? 1 : 0)) >= HTTPSERVER_HTTP2_STREAMS))
+    {
+        HttpServer_http2Reset(dev,client,h2->blockStream,HTTPSERVER_HTTP2_REFUSED_STREAM);
+        return;
+    }
+
+    stream.id = h2->blockStream;
+    stream.window = h2->initialWindow;
+    stream.length = length;
+    memcpy(&h2->pending[h2->pendingLength],&stream,sizeof(stream));
+    h2->pendingLength += sizeof(stream) + length;
+    h2->pendingCount++;
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_HTTP2_STREAM,client,stream.id & 0xFFFF,h2->pendingCount);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function applies a setting of the client.
+ *@return The HTTP/2 error code
+ */
+static uint32_t HttpServer_http2Setting (HttpServer_Http2* h2,
+                                         uint16_t id,
+                                         uint32_t value)
+{
+    HttpServer_Http2Stream stream;
+    int32_t delta;
+
+    switch (id)
+    {
+    case HTTPSERVER_HTTP2_HEADER_TABLE_SIZE:
+        if (value > HTTPSERVER_HTTP2_TABLE_DIMENSION)
+            value = HTTPSERVER_HTTP2_TABLE_DIMENSION;
+        if (value != h2->encoder.max)
+        {
+            HttpServer_hpackResize(&h2->encoder,value);
+            h2->flags |= HTTPSERVER_HTTP2_FLAGS_TABLE_SIZE;
+        }
+        break;
+
+    case HTTPSERVER_HTTP2_INITIAL_WINDOW_SIZE:
+        if (value > 0x7FFFFFFF)
+            return HTTPSERVER_HTTP2_FLOW_CONTROL_ERROR;
+        // The open streams are changed by the difference, none of them
+        // may grow beyond the max window
+        delta = (int32_t)value - h2->initialWindow;
+        if (((int64_t)h2->streamWindow + delta) > 0x7FFFFFFF)
+            return HTTPSERVER_HTTP2_FLOW_CONTROL_ERROR;
+        for (uint16_t offset = 0; offset < h2->pendingLength; offset += sizeof(stream) + stream.length)
+        {
+            memcpy(&stream,&h2->pending[offset],sizeof(stream));
+            if (((int64_t)stream.window + delta) > 0x7FFFFFFF)
+                return HTTPSERVER_HTTP2_FLOW_CONTROL_ERROR;
+        }
+        h2->initialWindow = value;
+        h2->streamWindow += delta;
+        for (uint16_t offset = 0; offset < h2->pendingLength; offset += sizeof(stream) + stream.length)
+        {
+            memcpy(&stream,&h2->pending[offset],sizeof(stream));
+            stream.window += delta;
+            memcpy(&h2->pending[offset],&stream,sizeof(stream));
+        }
+        break;
+
+    case HTTPSERVER_HTTP2_MAX_FRAME_SIZE:
+        if ((value < HTTPSERVER_HTTP2_FRAME_MAX) || (value > 0xFFFFFF))
+            return HTTPSERVER_HTTP2_PROTOCOL_ERROR;
+        h2->maxFrame = value;
+        break;
+
+    default:
+        break;
+    }
+    return HTTPSERVER_HTTP2_NO_ERROR;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function checks the header of a received frame.
+ *@return false when the frame is a connection error
+ */
+static bool HttpServer_http2Begin (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_Http2* h2 = &dev->http2;
+    uint32_t length = ((uint32_t)h2->frame[0] << 16) | (h2->frame[1] << 8) | h2->frame[2];
+    uint8_t type = h2->frame[3];
+    uint8_t flags = h2->frame[4];
+    uint32_t stream = HttpServer_http2Get32(&h2->frame[5]) & 0x7FFFFFFF;
+    uint32_t error = HTTPSERVER_HTTP2_NO_ERROR;
+
+    h2->remaining = length;
+    h2->payloadLength = 0;
+
+    if (length > HTTPSERVER_HTTP2_FRAME_MAX)
+    {
+        error = HTTPSERVER_HTTP2_FRAME_SIZE_ERROR;
+    }
+    else if ((h2->flags & HTTPSERVER_HTTP2_FLAGS_BLOCK) &&
+             ((type != HTTPSERVER_HTTP2_CONTINUATION) || (stream != h2->blockStream)))
+    {
+        // A header block can't be interleaved
+        error = HTTPSERVER_HTTP2_PROTOCOL_ERROR;
+    }
+    else
+    {
+        switch (type)
+        {
+        case HTTPSERVER_HTTP2_HEADERS:
+            if ((stream & 0x01) == 0)
+                error = HTTPSERVER_HTTP2_PROTOCOL_ERROR;
+            h2->blockStream = stream;
+            h2->blockLength = 0;
+            break;
+
+        case HTTPSERVER_HTTP2_CONTINUATION:
+            if (!(h2->flags & HTTPSERVER_HTTP2_FLAGS_BLOCK))
+                error = HTTPSERVER_HTTP2_PROTOCOL_ERROR;
+            break;
+
+        case HTTPSERVER_HTTP2_DATA:
+        case HTTPSERVER_HTTP2_PRIORITY:
+            if (stream == 0)
+                error = HTTPSERVER_HTTP2_PROTOCOL_ERROR;
+            break;
+
+        case HTTPSERVER_HTTP2_RST_STREAM:
+            if (stream == 0)
+                error = HTTPSERVER_HTTP2_PROTOCOL_ERROR;
+            else if (length != 4)
+                error = HTTPSERVER_HTTP2_FRAME_SIZE_ERROR;
+            break;
+
+        case HTTPSERVER_HTTP2_SETTINGS:
+            if (stream != 0)
+                error = HTTPSERVER_HTTP2_PROTOCOL_ERROR;
+            else if (((flags & HTTPSERVER_HTTP2_ACK) && (length > 0)) || ((length % 6) != 0))
+                error = HTTPSERVER_HTTP2_FRAME_SIZE_ERROR;
+            break;
+
+        case HTTPSERVER_HTTP2_PING:
+            if (stream != 0)
+                error = HTTPSERVER_HTTP2_PROTOCOL_ERROR;
+            else if (length != 8)
+                error = HTTPSERVER_HTTP2_FRAME_SIZE_ERROR;
+            break;
+
+        case HTTPSERVER_HTTP2_GOAWAY:
+            if (stream != 0)
+                error = HTTPSERVER_HTTP2_PROTOCOL_ERROR;
+            else if (length < 8)
+                error = HTTPSERVER_HTTP2_FRAME_SIZE_ERROR;
+            break;
+
+        case HTTPSERVER_HTTP2_WINDOW_UPDATE:
+            if (length != 4)
+                error = HTTPSERVER_HTTP2_FRAME_SIZE_ERROR;
+            break;
+
+        case HTTPSERVER_HTTP2_PUSH_PROMISE:
+            // A client can't push
+            error = HTTPSERVER_HTTP2_PROTOCOL_ERROR;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (error != HTTPSERVER_HTTP2_NO_ERROR)
+    {
+        HttpServer_http2GoAway(dev,client,error);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function stores a payload byte of the received frame: the header
+ * blocks go into the receive buffer of the client, the settings are applied
+ * one at a time, the payload of the other frames is dropped after its
+ * first 8 bytes.
+ */
+static void HttpServer_http2Byte (HttpServer_DeviceHandle dev,
+                                  uint8_t client,
+                                  uint8_t data)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_Http2* h2 = &dev->http2;
+    uint32_t error;
+
+    switch (h2->frame[3])
+    {
+    case HTTPSERVER_HTTP2_HEADERS:
+    case HTTPSERVER_HTTP2_CONTINUATION:
+        if (h2->blockLength >= HTTPSERVER_RX_BUFFER_DIMENSION)
+        {
+            HttpServer_http2GoAway(dev,client,HTTPSERVER_HTTP2_ENHANCE_YOUR_CALM);
+            return;
+        }
+        c->rxBuffer[h2->blockLength++] = data;
+        break;
+
+    case HTTPSERVER_HTTP2_SETTINGS:
+        h2->payload[h2->payloadLength++] = data;
+        if (h2->payloadLength == 6)
+        {
+            h2->payloadLength = 0;
+            error = HttpServer_http2Setting(h2,
+                                            (h2->payload[0] << 8) | h2->payload[1],
+                                            HttpServer_http2Get32(&h2->payload[2]));
+            if (error != HTTPSERVER_HTTP2_NO_ERROR)
+                HttpServer_http2GoAway(dev,client,error);
+        }
+        break;
+
+    default:
+        if (h2->payloadLength < sizeof(h2->payload))
+            h2->payload[h2->payloadLength++] = data;
+        break;
+    }
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function updates a flow control window.
+ *@return false when the window overflows
+ */
+static bool HttpServer_http2Window (int32_t* window, uint32_t increment)
+{
+    if (((int64_t)*window + increment) > 0x7FFFFFFF)
+        return false;
+    *window += increment;
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function handles a received frame whose payload is complete.
+ */
+static void HttpServer_http2Process (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_Http2* h2 = &dev->http2;
+    uint32_t length = ((uint32_t)h2->frame[0] << 16) | (h2->frame[1] << 8) | h2->frame[2];
+    uint8_t type = h2->frame[3];
+    uint8_t flags = h2->frame[4];
+    uint32_t stream = HttpServer_http2Get32(&h2->frame[5]) & 0x7FFFFFFF;
+    HttpServer_Http2Stream record;
+    uint16_t offset;
+    uint16_t skip = 0;
+    uint8_t pad = 0;
+    uint32_t value;
+
+    switch (type)
+    {
+    case HTTPSERVER_HTTP2_DATA:
+        // The request bodies are dropped, their room is given back at once
+        if (length > 0)
+        {
+            HttpServer_http2WindowUpdate(h2,0,length);
+            if (!(flags & HTTPSERVER_HTTP2_END_STREAM) &&
+                ((stream == h2->stream) || (HttpServer_http2Find(h2,stream) != HTTPSERVER_HTTP2_NOT_FOUND)))
+                HttpServer_http2WindowUpdate(h2,stream,length);
+        }
+        break;
+
+    case HTTPSERVER_HTTP2_HEADERS:
+        // The padding and the priority are removed from the block
+        if (flags & HTTPSERVER_HTTP2_PADDED)
+        {
+            pad = c->rxBuffer[0];
+            skip = 1;
+        }
+        if (flags & HTTPSERVER_HTTP2_PRIORITY_FLAG)
+            skip += 5;
+        if ((skip + pad) > h2->blockLength)
+        {
+            HttpServer_http2GoAway(dev,client,HTTPSERVER_HTTP2_PROTOCOL_ERROR);
+            break;
+        }
+        h2->blockLength -= skip + pad;
+        memmove(c->rxBuffer,&c->rxBuffer[skip],h2->blockLength);
+        // fall through
+    case HTTPSERVER_HTTP2_CONTINUATION:
+        if (flags & HTTPSERVER_HTTP2_END_HEADERS)
+            HttpServer_http2Block(dev,client);
+        else
+            h2->flags |= HTTPSERVER_HTTP2_FLAGS_BLOCK;
+        break;
+
+    case HTTPSERVER_HTTP2_RST_STREAM:
+        if (stream == h2->stream)
+            h2->flags |= HTTPSERVER_HTTP2_FLAGS_RESET;
+        else if ((offset = HttpServer_http2Find(h2,stream)) != HTTPSERVER_HTTP2_NOT_FOUND)
+            HttpServer_http2Remove(h2,offset);
+        break;
+
+    case HTTPSERVER_HTTP2_SETTINGS:
+        // The entries are already applied
+        if (!(flags & HTTPSERVER_HTTP2_ACK))
+            HttpServer_http2Queue(h2,HTTPSERVER_HTTP2_SETTINGS,HTTPSERVER_HTTP2_ACK,0,NULL,0);
+        break;
+
+    case HTTPSERVER_HTTP2_PING:
+        if (!(flags & HTTPSERVER_HTTP2_ACK))
+            HttpServer_http2Queue(h2,HTTPSERVER_HTTP2_PING,HTTPSERVER_HTTP2_ACK,0,h2->payload,8);
+        break;
+
+    case HTTPSERVER_HTTP2_GOAWAY:
+        h2->flags |= HTTPSERVER_HTTP2_FLAGS_PEER_GOAWAY;
+        break;
+
+    case HTTPSERVER_HTTP2_WINDOW_UPDATE:
+        value = HttpServer_http2Get32(h2->payload) & 0x7FFFFFFF;
+        if ((value == 0) && (stream == 0))
+        {
+            HttpServer_http2GoAway(dev,client,HTTPSERVER_HTTP2_PROTOCOL_ERROR);
+        }
+        else if (value == 0)
+        {
+            // Only the stream is in error, it is dropped as if the client
+            // had reset it
+            HttpServer_http2Reset(dev,client,stream,HTTPSERVER_HTTP2_PROTOCOL_ERROR);
+            if (stream == h2->stream)
+                h2->flags |= HTTPSERVER_HTTP2_FLAGS_RESET;
+            else if ((offset = HttpServer_http2Find(h2,stream)) != HTTPSERVER_HTTP2_NOT_FOUND)
+                HttpServer_http2Remove(h2,offset);
+        }
+        else if (stream == 0)
+        {
+            if (!HttpServer_http2Window(&h2->window,value))
+                HttpServer_http2GoAway(dev,client,HTTPSERVER_HTTP2_FLOW_CONTROL_ERROR);
+        }
+        else if (stream == h2->stream)
+        {
+            if (!HttpServer_http2Window(&h2->streamWindow,value))
+                HttpServer_http2GoAway(dev,client,HTTPSERVER_HTTP2_FLOW_CONTROL_ERROR);
+        }
+        else if ((offset = HttpServer_http2Find(h2,stream)) != HTTPSERVER_HTTP2_NOT_FOUND)
+        {
+            memcpy(&record,&h2->pending[offset],sizeof(record));
+            if (!HttpServer_http2Window(&record.window,value))
+                HttpServer_http2GoAway(dev,client,HTTPSERVER_HTTP2_FLOW_CONTROL_ERROR);
+            memcpy(&h2->pending[offset],&record,sizeof(record));
+        }
+        break;
+
+    default:
+        // PRIORITY and the unknown frames are ignored
+        break;
+    }
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function receives the frames of the client. A frame is started only
+ * when the answers to it can be queued, and nothing is received while a
+ * header block is sent.
+ */
+static void HttpServer_http2Receive (HttpServer_DeviceHandle dev,
+                                     uint8_t client,
+                                     uint16_t* budget)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_Http2* h2 = &dev->http2;
+    int16_t available = 0;
+    uint16_t received = 0;
+    uint8_t data;
+
+    EthernetServerSocket_available(dev->socketNumber,client,&available);
+
+    while ((available > 0) && (*budget > 0) &&
+           ((h2->flags & (HTTPSERVER_HTTP2_FLAGS_CLOSING | HTTPSERVER_HTTP2_FLAGS_CONTINUATION)) == 0))
+    {
+        if ((h2->frameLength == 0) &&
+            ((h2->outLength + HTTPSERVER_HTTP2_CONTROL_ROOM) > HTTPSERVER_HTTP2_OUT_DIMENSION))
+            break;
+
+        EthernetServerSocket_read(dev->socketNumber,client,&data);
+        available--;
+        (*budget)--;
+        received++;
+
+        if (h2->preface > 0)
+        {
+            if (data != (uint8_t)HttpServer_http2Preface[sizeof(HttpServer_http2Preface) - 1 - h2->preface])
+            {
+                HttpServer_http2GoAway(dev,client,HTTPSERVER_HTTP2_PROTOCOL_ERROR);
+                break;
+            }
+            h2->preface--;
+            continue;
+        }
+
+        if (h2->frameLength < HTTPSERVER_HTTP2_FRAME_HEADER)
+        {
+            h2->frame[h2->frameLength++] = data;
+            if ((h2->frameLength < HTTPSERVER_HTTP2_FRAME_HEADER) || !HttpServer_http2Begin(dev,client))
+                continue;
+        }
+        else
+        {
+            HttpServer_http2Byte(dev,client,data);
+            h2->remaining--;
+        }
+
+        if ((h2->remaining == 0) && !(h2->flags & HTTPSERVER_HTTP2_FLAGS_CLOSING))
+        {
+            h2->frameLength = 0;
+            HttpServer_http2Process(dev,client);
+        }
+    }
+
+    if (received > 0)
+    {
+        HTTPSERVER_METRICS_ADD(dev,bytesIn,received);
+        c->lastTick = HttpServer_currentTick();
+    }
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function sends the rest of the DATA frame in progress, then the
+ * queued frames. The payload goes from the trasmission buffer while it has
+ * staged bytes, then from the borrowed body.
+ *@return The number of bytes accepted by the socket
+ */
+static uint16_t HttpServer_http2Flush (HttpServer_DeviceHandle dev,
+                                       uint8_t client,
+                                       uint16_t limit)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_Http2* h2 = &dev->http2;
+    uint16_t wrote = 0;
+    uint16_t sent;
+    uint16_t size;
+
+    if (h2->dataHeaderLength > 0)
+    {
+        size = (h2->dataHeaderLength < limit) ? h2->dataHeaderLength : limit;
+        sent = 0;
+        EthernetServerSocket_writeBytes(dev->socketNumber,
+                                        client,
+                                        &h2->dataHeader[HTTPSERVER_HTTP2_FRAME_HEADER - h2->dataHeaderLength],
+                                        size,
+                                        &sent);
+        HTTPSERVER_METRICS_ADD(dev,bytesOut,sent);
+        h2->dataHeaderLength -= sent;
+        wrote += sent;
+        if (h2->dataHeaderLength > 0)
+            return wrote;
+    }
+
+    if ((h2->data > 0) && (wrote < limit))
+    {
+        size = ((limit - wrote) < h2->data) ? (limit - wrote) : h2->data;
+        sent = 0;
+        if (c->txSent < c->txLength)
+        {
+            EthernetServerSocket_writeBytes(dev->socketNumber,
+                                            client,
+                                            &c->txBuffer[c->txSent],
+                                            size,
+                                            &sent);
+            c->txSent += sent;
+        }
+#if (HTTPSERVER_BORROWED == 1)
+        else
+        {
+            EthernetServerSocket_writeBytes(dev->socketNumber,
+                                            client,
+                                            c->borrowed,
+                                            size,
+                                            &sent);
+            c->borrowed += sent;
+            c->borrowedRemaining -= sent;
+            if (c->borrowedRemaining == 0)
+            {
+                c->txFlags |= HTTPSERVER_TXFLAGS_END;
+                HttpServer_borrowedRelease(dev,client,true);
+            }
+        }
+#endif
+        HTTPSERVER_METRICS_ADD(dev,bytesOut,sent);
+        h2->data -= sent;
+        wrote += sent;
+    }
+
+    if ((h2->data > 0) || (wrote >= limit))
+        return wrote;
+
+    return wrote + HttpServer_http2Send(dev,client,limit - wrote);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function encodes the staged status line and header lines into a
+ * header block. The section is encoded when it is staged whole, or when
+ * it fills the trasmission buffer, and the block goes on into CONTINUATION
+ * frames when the frames buffer is full. Interim responses are dropped.
+ *@param end The end of the staged bytes which can be used
+ *@return false when nothing can be done
+ */
+static bool HttpServer_http2Headers (HttpServer_DeviceHandle dev,
+                                     uint8_t client,
+                                     uint16_t end)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_Http2* h2 = &dev->http2;
+    uint16_t frame = 0;
+    uint8_t type = HTTPSERVER_HTTP2_CONTINUATION;
+    uint8_t flags = 0;
+    bool open = false;
+    bool progress = false;
+
+    if ((h2->phase == HTTPSERVER_HTTP2_PHASE_STATUS) && (c->txLength < HTTPSERVER_TX_BUFFER_DIMENSION))
+    {
+        uint16_t i = c->txSent;
+
+        while (((i + 3) < end) && (memcmp(&c->txBuffer[i],"\r\n\r\n",4) != 0))
+            i++;
+        if ((i + 3) >= end)
+            return false;
+    }
+
+    for (;;)
+    {
+        char* line = (char*)&c->txBuffer[c->txSent];
+        uint16_t length = 0;
+        uint16_t nameLength;
+        char* value;
+        uint16_t valueLength;
+
+        while (((c->txSent + length + 1) < end) && ((line[length] != '\r') || (line[length + 1] != '\n')))
+            length++;
+        if ((c->txSent + length + 1) >= end)
+            break;
+
+        if (h2->phase == HTTPSERVER_HTTP2_PHASE_INTERIM)
+        {
+            if (length == 0)
+                h2->phase = HTTPSERVER_HTTP2_PHASE_STATUS;
+            c->txSent += length + 2;
+            progress = true;
+            continue;
+        }
+
+        if (h2->phase == HTTPSERVER_HTTP2_PHASE_STATUS)
+        {
+            static const char indexed[][4] = {"200","204","206","304","400","404","500"};
+            uint8_t i;
+
+            // "HTTP/1.1 200 OK"
+            if ((length >= 12) && (line[9] == '1'))
+            {
+                h2->phase = HTTPSERVER_HTTP2_PHASE_INTERIM;
+                c->txSent += length + 2;
+                progress = true;
+                continue;
+            }
+            if ((h2->outLength + HTTPSERVER_HTTP2_FRAME_HEADER + 8 + HTTPSERVER_HTTP2_CONTROL_ROOM) > HTTPSERVER_HTTP2_OUT_DIMENSION)
+                break;
+
+            frame = h2->outLength;
+            h2->outLength += HTTPSERVER_HTTP2_FRAME_HEADER;
+            type = HTTPSERVER_HTTP2_HEADERS;
+            open = true;
+
+            if (h2->flags & HTTPSERVER_HTTP2_FLAGS_TABLE_SIZE)
+            {
+                h2->outLength += HttpServer_hpackEncodeInteger(&h2->out[h2->outLength],0x20,5,h2->encoder.max);
+                h2->flags &= ~HTTPSERVER_HTTP2_FLAGS_TABLE_SIZE;
+            }
+
+            for (i = 0; i < (sizeof(indexed) / sizeof(indexed[0])); ++i)
+            {
+                if ((length >= 12) && (memcmp(&line[9],indexed[i],3) == 0))
+                    break;
+            }
+            if (i < (sizeof(indexed) / sizeof(indexed[0])))
+            {
+                h2->out[h2->outLength++] = 0x80 | (8 + i);
+            }
+            else
+            {
+                // Literal without indexing, the name of :status
+                h2->out[h2->outLength++] = 0x08;
+                h2->out[h2->outLength++] = 0x03;
+                memcpy(&h2->out[h2->outLength],(length >= 12) ? &line[9] : "500",3);
+                h2->outLength += 3;
+            }
+            if ((length >= 12) && ((memcmp(&line[9],"204",3) == 0) || (memcmp(&line[9],"304",3) == 0)))
+                h2->flags |= HTTPSERVER_HTTP2_FLAGS_EMPTY;
+
+            h2->phase = HTTPSERVER_HTTP2_PHASE_HEADERS;
+            c->txSent += length + 2;
+            progress = true;
+            continue;
+        }
+
+        // A line which can't fit an empty frame is dropped
+        if ((HTTPSERVER_HTTP2_FRAME_HEADER + length + 12 + HTTPSERVER_HTTP2_CONTROL_ROOM) > HTTPSERVER_HTTP2_OUT_DIMENSION)
+        {
+            HTTPSERVER_TRACE(HTTPSERVER_TRACE_HEADER_OVERFLOW,client,length,0);
+            c->txSent += length + 2;
+            progress = true;
+            continue;
+        }
+        if (!open)
+        {
+            if ((h2->outLength + HTTPSERVER_HTTP2_FRAME_HEADER + length + 12 + HTTPSERVER_HTTP2_CONTROL_ROOM) > HTTPSERVER_HTTP2_OUT_DIMENSION)
+                break;
+            frame = h2->outLength;
+            h2->outLength += HTTPSERVER_HTTP2_FRAME_HEADER;
+            open = true;
+        }
+
+        if (length == 0)
+        {
+            // End of the header section
+            c->txSent += 2;
+            flags |= HTTPSERVER_HTTP2_END_HEADERS;
+            if ((type == HTTPSERVER_HTTP2_HEADERS) && (h2->flags & HTTPSERVER_HTTP2_FLAGS_EMPTY))
+            {
+                flags |= HTTPSERVER_HTTP2_END_STREAM;
+                h2->flags |= HTTPSERVER_HTTP2_FLAGS_ENDED;
+            }
+            h2->phase = (h2->flags & HTTPSERVER_HTTP2_FLAGS_CHUNKED) ?
+                        HTTPSERVER_HTTP2_PHASE_CHUNK_SIZE :
+                        HTTPSERVER_HTTP2_PHASE_BODY;
+            h2->chunk = 0;
+            progress = true;
+            break;
+        }
+
+        if ((h2->outLength + length + 12 + HTTPSERVER_HTTP2_CONTROL_ROOM) > HTTPSERVER_HTTP2_OUT_DIMENSION)
+            break;
+
+        c->txSent += length + 2;
+        progress = true;
+
+        for (nameLength = 0; (nameLength < length) && (line[nameLength] != ':'); ++nameLength)
+        {
+            if ((line[nameLength] >= 'A') && (line[nameLength] <= 'Z'))
+                line[nameLength] += 'a' - 'A';
+        }
+        if (nameLength == length)
+            continue;
+
+        value = &line[nameLength + 1];
+        valueLength = length - nameLength - 1;
+        while ((valueLength > 0) && (*value == ' '))
+        {
+            value++;
+            valueLength--;
+        }
+
+        if (HttpServer_http2Listed(HttpServer_http2Connection,
+                                   sizeof(HttpServer_http2Connection) / sizeof(HttpServer_http2Connection[0]),
+                                   line,
+                                   nameLength))
+        {
+            // The chunked coding is removed from the body
+            if ((nameLength == 17) && (valueLength >= 7) && HttpServer_compareNoCase(value,"chunked",7))
+                h2->flags |= HTTPSERVER_HTTP2_FLAGS_CHUNKED;
+            continue;
+        }
+        if ((nameLength == 14) && (memcmp(line,"content-length",14) == 0) &&
+            (valueLength == 1) && (value[0] == '0'))
+            h2->flags |= HTTPSERVER_HTTP2_FLAGS_EMPTY;
+
+        HttpServer_hpackEncode(h2,line,nameLength,value,valueLength);
+    }
+
+    if (open)
+    {
+        HttpServer_http2FrameHeader(&h2->out[frame],
+                                    h2->outLength - frame - HTTPSERVER_HTTP2_FRAME_HEADER,
+                                    type,
+                                    flags,
+                                    h2->stream);
+        if (flags & HTTPSERVER_HTTP2_END_HEADERS)
+            h2->flags &= ~HTTPSERVER_HTTP2_FLAGS_CONTINUATION;
+        else
+            h2->flags |= HTTPSERVER_HTTP2_FLAGS_CONTINUATION;
+    }
+
+    // The rest of the section is moved back to make room for it
+    if ((h2->phase <= HTTPSERVER_HTTP2_PHASE_HEADERS) && (c->txSent > 0))
+    {
+        memmove(c->txBuffer,&c->txBuffer[c->txSent],c->txLength - c->txSent);
+        c->txLength -= c->txSent;
+        if (c->txFlags & HTTPSERVER_TXFLAGS_CHUNK_OPEN)
+            c->txChunk -= c->txSent;
+        c->txSent = 0;
+    }
+    return progress;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function frames the next part of the staged response: the header
+ * block first, then DATA frames as big as the windows allow. The chunked
+ * coding is removed and the trailers are dropped. The response of a reset
+ * stream is dropped as it comes.
+ *@return false when nothing can be done
+ */
+static bool HttpServer_http2Translate (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_Http2* h2 = &dev->http2;
+    uint16_t end = (c->txFlags & HTTPSERVER_TXFLAGS_CHUNK_OPEN) ? c->txChunk : c->txLength;
+    uint32_t size = 0;
+    bool progress = false;
+
+    if (h2->stream == 0)
+        return false;
+
+    if (h2->phase <= HTTPSERVER_HTTP2_PHASE_HEADERS)
+        return HttpServer_http2Headers(dev,client,end);
+
+    while ((c->txSent < end) &&
+           (h2->phase != HTTPSERVER_HTTP2_PHASE_BODY) &&
+           (h2->phase != HTTPSERVER_HTTP2_PHASE_CHUNK_DATA))
+    {
+        uint8_t data = c->txBuffer[c->txSent++];
+
+        progress = true;
+        switch (h2->phase)
+        {
+        case HTTPSERVER_HTTP2_PHASE_CHUNK_SIZE:
+            if ((data >= '0') && (data <= '9'))
+                h2->chunk = (h2->chunk << 4) | (data - '0');
+            else if ((data >= 'a') && (data <= 'f'))
+                h2->chunk = (h2->chunk << 4) | (data - 'a' + 10);
+            else if ((data >= 'A') && (data <= 'F'))
+                h2->chunk = (h2->chunk << 4) | (data - 'A' + 10);
+            else if (data == '\n')
+                h2->phase = (h2->chunk > 0) ? HTTPSERVER_HTTP2_PHASE_CHUNK_DATA : HTTPSERVER_HTTP2_PHASE_TRAILER;
+            break;
+
+        case HTTPSERVER_HTTP2_PHASE_CHUNK_END:
+            if (data == '\n')
+            {
+                h2->phase = HTTPSERVER_HTTP2_PHASE_CHUNK_SIZE;
+                h2->chunk = 0;
+            }
+            break;
+
+        case HTTPSERVER_HTTP2_PHASE_TRAILER:
+            // The length of the trailer line, an empty one ends the body
+            if (data == '\n')
+            {
+                if (h2->chunk == 0)
+                    h2->phase = HTTPSERVER_HTTP2_PHASE_DONE;
+                h2->chunk = 0;
+            }
+            else if (data != '\r')
+            {
+                h2->chunk++;
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (c->txSent < end)
+    {
+        size = end - c->txSent;
+        if ((h2->phase == HTTPSERVER_HTTP2_PHASE_CHUNK_DATA) && (size > h2->chunk))
+            size = h2->chunk;
+    }
+#if (HTTPSERVER_BORROWED == 1)
+    else if ((c->txSent == c->txLength) && (c->borrowed != NULL))
+    {
+        size = c->borrowedRemaining;
+    }
+#endif
+    if (size == 0)
+        return progress;
+
+    if (h2->flags & (HTTPSERVER_HTTP2_FLAGS_RESET | HTTPSERVER_HTTP2_FLAGS_ENDED))
+    {
+#if (HTTPSERVER_BORROWED == 1)
+        if (c->txSent == c->txLength)
+        {
+            c->txFlags |= HTTPSERVER_TXFLAGS_END;
+            HttpServer_borrowedRelease(dev,client,false);
+            return true;
+        }
+#endif
+        c->txSent += size;
+    }
+    else
+    {
+        if (size > h2->maxFrame)
+            size = h2->maxFrame;
+        if (size > HTTPSERVER_HTTP2_FRAME_MAX)
+            size = HTTPSERVER_HTTP2_FRAME_MAX;
+        if ((int32_t)size > h2->window)
+            size = (h2->window > 0) ? h2->window : 0;
+        if ((int32_t)size > h2->streamWindow)
+            size = (h2->streamWindow > 0) ? h2->streamWindow : 0;
+        // Blocked by the flow control
+        if (size == 0)
+            return progress;
+
+        HttpServer_http2FrameHeader(h2->dataHeader,size,HTTPSERVER_HTTP2_DATA,0,h2->stream);
+        h2->dataHeaderLength = HTTPSERVER_HTTP2_FRAME_HEADER;
+        h2->data = size;
+        h2->window -= size;
+        h2->streamWindow -= size;
+    }
+
+    if (h2->phase == HTTPSERVER_HTTP2_PHASE_CHUNK_DATA)
+    {
+        h2->chunk -= size;
+        if (h2->chunk == 0)
+            h2->phase = HTTPSERVER_HTTP2_PHASE_CHUNK_END;
+    }
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function performs the first waiting stream with the handlers of
+ * HTTP/1.1: its pseudo-headers become the request line, its other lines
+ * the message headers.
+ */
+static void HttpServer_http2Dispatch (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_Http2* h2 = &dev->http2;
+    HttpServer_Http2Stream stream;
+    char* text = (char*)&h2->pending[sizeof(stream)];
+    char* line;
+    bool method = false;
+    bool path = false;
+    bool tooLong = false;
+
+    memcpy(&stream,h2->pending,sizeof(stream));
+    h2->stream = stream.id;
+    h2->streamWindow = stream.window;
+    h2->phase = HTTPSERVER_HTTP2_PHASE_STATUS;
+    h2->flags &= ~(HTTPSERVER_HTTP2_FLAGS_RESET |
+                   HTTPSERVER_HTTP2_FLAGS_ENDED |
+                   HTTPSERVER_HTTP2_FLAGS_EMPTY |
+                   HTTPSERVER_HTTP2_FLAGS_CHUNKED);
+    c->message.version = HTTPSERVER_VERSION_1_1;
+
+    for (line = text; line < &text[stream.length]; line += strlen(line) + 1)
+    {
+        if (strncmp(line,":method: ",9) == 0)
+        {
+            if (strcmp(&line[9],HTTPSERVER_STRING_REQUEST_GET) == 0)
+            {
+                c->message.request = HTTPSERVER_REQUEST_GET;
+                method = true;
+            }
+            else if (strcmp(&line[9],HTTPSERVER_STRING_REQUEST_POST) == 0)
+            {
+                c->message.request = HTTPSERVER_REQUEST_POST;
+                method = true;
+            }
+        }
+        else if (strncmp(line,":path: ",7) == 0)
+        {
+            if (strlen(&line[7]) < HTTPSERVER_MAX_URI_LENGTH)
+            {
+                strcpy(c->message.uri,&line[7]);
+                path = true;
+            }
+            else
+            {
+                tooLong = true;
+            }
+        }
+    }
+
+    c->state = HTTPSERVER_CLIENTSTATE_RESPONSE;
+#if (HTTPSERVER_RATELIMIT == 1)
+    if (!HttpServer_rateLimitRequest(dev,client))
+    {
+        HttpServer_http2Remove(h2,0);
+        return;
+    }
+#endif
+    if (!method || !path)
+    {
+        HTTPSERVER_METRICS_INC(dev,parseErrors);
+        HTTPSERVER_TRACE(HTTPSERVER_TRACE_PARSE_ERROR,client,HTTPSERVER_ERROR_WRONG_REQUEST_FORMAT,stream.length);
+        HttpServer_sendResponse(dev,
+                                tooLong ?
+                                    HTTPSERVER_RESPONSECODE_REQUESTURITOOLARGE :
+                                    HTTPSERVER_RESPONSECODE_BADREQUEST,
+                                "Content-Length: 0\r\nServer: " HTTPSERVER_SERVER_NAME,
+                                "",
+                                client);
+        HttpServer_http2Remove(h2,0);
+        return;
+    }
+
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_REQUEST,client,c->message.request,stream.length);
+    HttpServer_beginRequest(dev,client);
+    for (line = text; line < &text[stream.length]; line += strlen(line) + 1)
+    {
+        if (line[0] != ':')
+            HttpServer_headerLine(dev,client,line,strlen(line));
+    }
+    // The connection is closed by GOAWAY only
+    c->message.flags |= HTTPSERVER_MESSAGEFLAGS_CLOSE;
+
+    HttpServer_http2Remove(h2,0);
+    HttpServer_performRequest(dev,client);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function takes the HTTP/2 connection for a client.
+ *@param preface Bytes of the connection preface still to receive
+ */
+static void HttpServer_http2Open (HttpServer_DeviceHandle dev,
+                                  uint8_t client,
+                                  uint8_t preface)
+{
+    HttpServer_Http2* h2 = &dev->http2;
+
+    h2->client = client;
+    h2->flags = 0;
+    h2->preface = preface;
+    h2->frameLength = 0;
+    h2->lastStream = 0;
+    h2->maxFrame = HTTPSERVER_HTTP2_FRAME_MAX;
+    h2->initialWindow = HTTPSERVER_HTTP2_WINDOW_DEFAULT;
+    h2->window = HTTPSERVER_HTTP2_WINDOW_DEFAULT;
+    h2->stream = 0;
+    h2->dataHeaderLength = 0;
+    h2->data = 0;
+    h2->pendingLength = 0;
+    h2->pendingCount = 0;
+    h2->outLength = 0;
+    h2->outSent = 0;
+
+    h2->decoder.length = 0;
+    h2->decoder.count = 0;
+    h2->decoder.size = 0;
+    h2->decoder.max = HTTPSERVER_HTTP2_HPACK_DEFAULT;
+    // The client knows the size of the table from the settings
+    h2->encoder.length = 0;
+    h2->encoder.count = 0;
+    h2->encoder.size = 0;
+    h2->encoder.max = (HTTPSERVER_HTTP2_TABLE_DIMENSION < HTTPSERVER_HTTP2_HPACK_DEFAULT) ?
+                      HTTPSERVER_HTTP2_TABLE_DIMENSION :
+                      HTTPSERVER_HTTP2_HPACK_DEFAULT;
+    if (h2->encoder.max < HTTPSERVER_HTTP2_HPACK_DEFAULT)
+        h2->flags |= HTTPSERVER_HTTP2_FLAGS_TABLE_SIZE;
+
+    HTTPSERVER_METRICS_INC(dev,http2Connections);
+}
+
+void HttpServer_http2Start (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    uint16_t wrote = 0;
+
+    if (dev->http2.client != HTTPSERVER_HTTP2_FREE)
+    {
+        EthernetServerSocket_writeBytes(dev->socketNumber,
+                                        client,
+                                        HttpServer_http2Busy,
+                                        sizeof(HttpServer_http2Busy),
+                                        &wrote);
+        HttpServer_closeClient(dev,client);
+        return;
+    }
+
+    // The "PRI * HTTP/2.0" line is received
+    HttpServer_http2Open(dev,client,sizeof(HttpServer_http2Preface) - 1 - 16);
+    HttpServer_http2Settings(&dev->http2);
+    c->state = HTTPSERVER_CLIENTSTATE_HTTP2;
+    c->rxIndex = 0;
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_HTTP2_OPEN,client,0,0);
+}
+
+void HttpServer_http2Upgrade (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    static const char response[] =
+            HTTPSERVER_STRING_VERSION_1_1 " 101 Switching Protocols\r\n"
+            "Connection: Upgrade\r\n"
+            "Upgrade: h2c\r\n"
+            "\r\n";
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_Http2* h2 = &dev->http2;
+    const char* upgrade;
+    const char* settings;
+    uint32_t bits = 0;
+    uint8_t count = 0;
+    uint8_t length = 0;
+    bool h2c = false;
+
+    if ((h2->client != HTTPSERVER_HTTP2_FREE) ||
+        (c->message.version != HTTPSERVER_VERSION_1_1) ||
+        (c->message.contentLength > 0) ||
+        ((c->message.flags & HTTPSERVER_MESSAGEFLAGS_UPGRADE) == 0))
+        return;
+
+    upgrade = HttpServer_findHeader(c->message.header,"Upgrade");
+    settings = HttpServer_findHeader(c->message.header,"HTTP2-Settings");
+    if ((upgrade == NULL) || (settings == NULL))
+        return;
+
+    // One of the tokens of the list
+    while ((*upgrade != '\r') && (*upgrade != '\0') && !h2c)
+    {
+        while ((*upgrade == ' ') || (*upgrade == ','))
+            upgrade++;
+        h2c = HttpServer_compareNoCase(upgrade,"h2c",3) &&
+              ((upgrade[3] == ',') || (upgrade[3] == ' ') || (upgrade[3] == '\r') || (upgrade[3] == '\0'));
+        while ((*upgrade != ',') && (*upgrade != '\r') && (*upgrade != '\0'))
+            upgrade++;
+    }
+    if (!h2c)
+        return;
+
+    HttpServer_http2Open(dev,client,sizeof(HttpServer_http2Preface) - 1);
+    memcpy(h2->out,response,sizeof(response) - 1);
+    h2->outLength = sizeof(response) - 1;
+    HttpServer_http2Settings(h2);
+
+    // The settings of the client, base64url
+    for (; ; ++settings)
+    {
+        char ch = *settings;
+        uint8_t digit;
+
+        if ((ch >= 'A') && (ch <= 'Z'))
+            digit = ch - 'A';
+        else if ((ch >= 'a') && (ch <= 'z'))
+            digit = ch - 'a' + 26;
+        else if ((ch >= '0') && (ch <= '9'))
+            digit = ch - '0' + 52;
+        else if ((ch == '-') || (ch == '+'))
+            digit = 62;
+        else if ((ch == '_') || (ch == '/'))
+            digit = 63;
+        else
+            break;
+
+        bits = (bits << 6) | digit;
+        count += 6;
+        if (count >= 8)
+        {
+            count -= 8;
+            h2->payload[length++] = (bits >> count) & 0xFF;
+            if (length == 6)
+            {
+                HttpServer_http2Setting(h2,
+                                        (h2->payload[0] << 8) | h2->payload[1],
+                                        HttpServer_http2Get32(&h2->payload[2]));
+                length = 0;
+            }
+        }
+    }
+
+    // The request is the stream 1, half-closed by the client
+    h2->stream = 1;
+    h2->lastStream = 1;
+    h2->streamWindow = h2->initialWindow;
+    h2->phase = HTTPSERVER_HTTP2_PHASE_STATUS;
+    c->message.flags |= HTTPSERVER_MESSAGEFLAGS_CLOSE;
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_HTTP2_OPEN,client,1,0);
+}
+
+bool HttpServer_http2Service (HttpServer_DeviceHandle dev,
+                              uint8_t client,
+                              uint16_t* budget)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_Http2* h2 = &dev->http2;
+
+    if (h2->flags & HTTPSERVER_HTTP2_FLAGS_CLOSING)
+    {
+        // The current stream is answered, then the queued frames are sent
+        if (c->state == HTTPSERVER_CLIENTSTATE_RESPONSE)
+            return true;
+        if (HttpServer_http2Flush(dev,client,*budget) > 0)
+            c->lastTick = HttpServer_currentTick();
+        if (((h2->outLength == 0) && (h2->dataHeaderLength == 0) && (h2->data == 0)) ||
+            ((uint32_t)(HttpServer_currentTick() - c->lastTick) >= HTTPSERVER_TIMEOUT))
+            HttpServer_closeClient(dev,client);
+        return false;
+    }
+
+    HttpServer_http2Receive(dev,client,budget);
+    if (h2->flags & HTTPSERVER_HTTP2_FLAGS_CLOSING)
+        return false;
+
+    if (c->state != HTTPSERVER_CLIENTSTATE_HTTP2)
+        return (c->state == HTTPSERVER_CLIENTSTATE_RESPONSE);
+
+    if (HttpServer_http2Flush(dev,client,*budget) > 0)
+        c->lastTick = HttpServer_currentTick();
+
+    if ((h2->pendingCount > 0) && !(h2->flags & HTTPSERVER_HTTP2_FLAGS_PEER_GOAWAY))
+    {
+        HttpServer_http2Dispatch(dev,client);
+        return (c->state == HTTPSERVER_CLIENTSTATE_RESPONSE);
+    }
+
+    if ((h2->flags & HTTPSERVER_HTTP2_FLAGS_PEER_GOAWAY) ||
+        ((uint32_t)(HttpServer_currentTick() - c->lastTick) >= HTTPSERVER_HTTP2_TIMEOUT))
+        HttpServer_http2GoAway(dev,client,HTTPSERVER_HTTP2_NO_ERROR);
+    return false;
+}
+
+uint16_t HttpServer_http2Drain (HttpServer_DeviceHandle dev,
+                                uint8_t client,
+                                uint16_t limit)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_Http2* h2 = &dev->http2;
+    uint16_t wrote = 0;
+
+    for (;;)
+    {
+        wrote += HttpServer_http2Flush(dev,client,limit - wrote);
+
+        // The socket is full, or the budget is spent
+        if ((h2->dataHeaderLength > 0) || (h2->data > 0) || (h2->outLength > 0) || (wrote >= limit))
+            break;
+        if (!HttpServer_http2Translate(dev,client))
+            break;
+    }
+
+    if ((c->txSent == c->txLength) && (h2->dataHeaderLength == 0) && (h2->data == 0))
+    {
+        c->txLength = 0;
+        c->txSent = 0;
+    }
+
+    // A response blocked by the flow control waits for WINDOW_UPDATE, which
+    // is received here too while a handler flushes the buffer
+    if ((wrote == 0) && (c->txLength > 0))
+    {
+        uint16_t budget = limit;
+
+        HttpServer_http2Receive(dev,client,&budget);
+    }
+    return wrote;
+}
+
+bool HttpServer_http2StreamEnd (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_Http2* h2 = &dev->http2;
+
+    if ((h2->dataHeaderLength > 0) || (h2->data > 0))
+        return false;
+
+    if (!(h2->flags & (HTTPSERVER_HTTP2_FLAGS_RESET | HTTPSERVER_HTTP2_FLAGS_ENDED)))
+    {
+        if (h2->phase <= HTTPSERVER_HTTP2_PHASE_HEADERS)
+        {
+            // The response has been left without headers
+            if ((h2->outLength + HTTPSERVER_HTTP2_FRAME_HEADER + 4) > HTTPSERVER_HTTP2_OUT_DIMENSION)
+                return false;
+            HttpServer_http2Reset(dev,client,h2->stream,HTTPSERVER_HTTP2_INTERNAL_ERROR);
+        }
+        else if (!HttpServer_http2Queue(h2,HTTPSERVER_HTTP2_DATA,HTTPSERVER_HTTP2_END_STREAM,h2->stream,NULL,0))
+        {
+            return false;
+        }
+    }
+    h2->stream = 0;
+    return true;
+}
+
+void HttpServer_http2Refuse (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_Http2* h2 = &dev->http2;
+
+    HttpServer_http2Reset(dev,client,h2->stream,HTTPSERVER_HTTP2_HTTP_1_1_REQUIRED);
+    h2->flags |= HTTPSERVER_HTTP2_FLAGS_RESET;
+    c->state = HTTPSERVER_CLIENTSTATE_RESPONSE;
+    c->txFlags = HTTPSERVER_TXFLAGS_END;
+}
+
+void HttpServer_http2Release (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    if (dev->http2.client == client)
+        dev->http2.client = HTTPSERVER_HTTP2_FREE;
+}
+
+#endif
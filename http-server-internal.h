@@ -0,0 +1,557 @@
+/*
+ * A simple HTTP/SERVER library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Declarations shared between the modules of the library: they are not part
+ * of the public interface and they MUST NOT be used by the application.
+ */
+
+#ifndef __OHILAB_HTTPSERVER_INTERNAL_H
+#define __OHILAB_HTTPSERVER_INTERNAL_H
+
+#include "http-server.h"
+
+typedef uint32_t (*HttpServer_CurrentTick) (void);
+typedef void (*HttpServer_Delay) (uint32_t);
+
+///The tick source saved by @ref HttpServer_open
+extern HttpServer_CurrentTick HttpServer_currentTick;
+///The delay function saved by @ref HttpServer_open
+extern HttpServer_Delay HttpServer_delay;
+
+/**
+ * @ingroup httpServer_functions
+ * This function appends data to the trasmission buffer of the client. When
+ * the buffer is full, the staged data are sent before continue, see
+ * @ref HttpServer_txFlush : the data are dropped when the response is
+ * aborted.
+ *@param server The server pointer which you have previously definited
+ *@param client The client number
+ *@param[in] data The data to append
+ *@param length The number of bytes to append
+ */
+void HttpServer_txAppend (HttpServer_DeviceHandle dev,
+                          uint8_t client,
+                          const char* data,
+                          uint16_t length);
+
+/**
+ * @ingroup httpServer_functions
+ * This function stages the status line of a response and marks the client
+ * as responding.
+ *@param server The server pointer which you have previously definited
+ *@param code The HTTP response code
+ *@param client The client number
+ */
+void HttpServer_txStatus (HttpServer_DeviceHandle dev,
+                          HttpServer_ResponseCode code,
+                          uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function closes the connection and releases the client slot.
+ *@param server The server pointer which you have previously definited
+ *@param client The client number
+ */
+void HttpServer_closeClient (HttpServer_DeviceHandle dev,
+                             uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function sends to the socket at most @a limit staged bytes.
+ *@param server The server pointer which you have previously definited
+ *@param client The client number
+ *@param limit The max number of bytes to send
+ *@return The number of bytes accepted by the socket
+ */
+uint16_t HttpServer_txDrain (HttpServer_DeviceHandle dev,
+                             uint8_t client,
+                             uint16_t limit);
+
+
+/**
+ * @ingroup httpServer_functions
+ * This function sends all staged bytes, waiting for the socket up to
+ * @ref HTTPSERVER_POLL_QUANTUM_TICKS ticks, so that the other clients
+ * wait at most a quantum. When the socket doesn't take them the response
+ * is aborted: the next data are dropped and the connection is closed by
+ * @ref HttpServer_poll , so the client never gets a truncated body as a
+ * complete one.
+ *@param server The server pointer which you have previously definited
+ *@param client The client number
+ *@return true if all bytes are sent
+ */
+bool HttpServer_txFlush (HttpServer_DeviceHandle dev, uint8_t client);
+
+#if (HTTPSERVER_GENERATOR == 1)
+/**
+ * @ingroup httpServer_functions
+ * Max length of a generated line, end of line included.
+ */
+#define HTTPSERVER_GENERATOR_LINE_LENGTH    80
+
+/**
+ * @ingroup httpServer_functions
+ * The function which writes the line generatorStep of a generated body
+ * into a buffer of @ref HTTPSERVER_GENERATOR_LINE_LENGTH characters. It
+ * can be called again for the same line when it doesn't fit the buffer,
+ * and it can move generatorStep forward to skip the lines which are lost.
+ *@return The length of the line, 0 when the body is complete
+ */
+typedef uint8_t (*HttpServer_Generator) (HttpServer_DeviceHandle dev,
+                                         uint8_t client,
+                                         char* line);
+
+/**
+ * @ingroup httpServer_functions
+ * This function completes the staged headers with a body which is
+ * generated line by line while it is sent: the lines from @a step to
+ * @a end are written into the transmission buffer when there is room for
+ * them, so the poll never waits for the client. The end of the body is
+ * marked by the connection close.
+ *@param server The server pointer which you have previously definited
+ *@param client The client number
+ *@param generator The function which writes the lines
+ *@param step The first line
+ *@param end The line after the last one
+ */
+void HttpServer_txGenerate (HttpServer_DeviceHandle dev,
+                            uint8_t client,
+                            HttpServer_Generator generator,
+                            uint32_t step,
+                            uint32_t end);
+#endif
+
+/**
+ * @ingroup httpServer_functions
+ * This function appends response body data to the trasmission buffer,
+ * framing them into chunks when the chunked transfer coding is used.
+ *@param server The server pointer which you have previously definited
+ *@param client The client number
+ *@param[in] data The data to append
+ *@param length The number of bytes to append
+ */
+void HttpServer_txBody (HttpServer_DeviceHandle dev,
+                        uint8_t client,
+                        const uint8_t* data,
+                        uint16_t length);
+
+/**
+ * @ingroup httpServer_functions
+ * This function searches a header, with case-insensitive name, into a
+ * headers block where every header is terminated by \r\n.
+ *@param[in] headers The headers block
+ *@param[in] name The header name, without ':'
+ *@return The pointer to the first character of the value, NULL when the
+ * header is not present
+ */
+const char* HttpServer_findHeader (const char* headers, const char* name);
+
+/**
+ * @ingroup httpServer_functions
+ * This function initializes the message state of a request whose request
+ * line has been parsed, and moves the client to the headers state.
+ *@param server The server pointer which you have previously definited
+ *@param client The client number
+ */
+void HttpServer_beginRequest (HttpServer_DeviceHandle dev,
+                              uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function parses a request header line, without the ending \r\n,
+ * and appends it to the message headers.
+ *@param server The server pointer which you have previously definited
+ *@param client The client number
+ *@param[in] line The header line
+ *@param length The length of the line
+ */
+void HttpServer_headerLine (HttpServer_DeviceHandle dev,
+                            uint8_t client,
+                            const char* line,
+                            uint16_t length);
+
+/**
+ * @ingroup httpServer_functions
+ * This function performs a request whose headers are complete: the built-in
+ * routes or the application handler are called and, when the handler has
+ * not started a response, the message response is sent.
+ *@param server The server pointer which you have previously definited
+ *@param client The client number
+ */
+void HttpServer_performRequest (HttpServer_DeviceHandle dev,
+                                uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function compares the first @a length characters of two strings,
+ * ignoring the case.
+ *@return true if they are equal
+ */
+bool HttpServer_compareNoCase (const char* a, const char* b, uint16_t length);
+
+/**
+ * @ingroup httpServer_functions
+ * This function updates a CRC32 (IEEE 802.3) checksum.
+ *@param crc The current checksum, 0 at the begin
+ *@param[in] data The data
+ *@param length The number of bytes
+ *@return The updated checksum
+ */
+uint32_t HttpServer_crc32 (uint32_t crc, const uint8_t* data, uint16_t length);
+
+#if (HTTPSERVER_COMPRESSION == 1)
+///Value of @ref HttpServer_Deflate client when the encoder is free
+#define HTTPSERVER_DEFLATE_FREE           0xFF
+
+/**
+ * @ingroup httpServer_functions
+ * This function reserves the encoder for a client.
+ *@return false if the encoder is used by another client
+ */
+bool HttpServer_deflateAcquire (HttpServer_DeviceHandle dev,
+                                uint8_t client,
+                                uint8_t format);
+
+/**
+ * @ingroup httpServer_functions
+ * This function frees the encoder if it is owned by the client.
+ */
+void HttpServer_deflateRelease (HttpServer_DeviceHandle dev, uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function sends the header of the selected format.
+ */
+void HttpServer_deflateStart (HttpServer_DeviceHandle dev);
+
+/**
+ * @ingroup httpServer_functions
+ * This function adds data to the compression window, each full window is
+ * compressed and sent.
+ */
+void HttpServer_deflateWrite (HttpServer_DeviceHandle dev,
+                              const uint8_t* data,
+                              uint16_t length);
+
+/**
+ * @ingroup httpServer_functions
+ * This function compresses the last window and sends the trailer.
+ */
+void HttpServer_deflateFinish (HttpServer_DeviceHandle dev);
+#endif
+
+#if (HTTPSERVER_WEBSOCKET == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function checks, at the end of the headers, if the request is a
+ * WebSocket upgrade. When it is, the handshake response is staged and the
+ * client moves to @ref HTTPSERVER_CLIENTSTATE_WEBSOCKET, or an error
+ * response is staged if the upgrade is refused.
+ *@return true if the request was an upgrade request
+ */
+bool HttpServer_wsUpgrade (HttpServer_DeviceHandle dev, uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function serves an upgraded connection for one quantum: it sends the
+ * staged frames, decodes the received ones and manages the keepalive.
+ *@param budget The max number of bytes to read and write
+ */
+void HttpServer_wsService (HttpServer_DeviceHandle dev,
+                           uint8_t client,
+                           uint16_t budget);
+#endif
+
+#if (HTTPSERVER_SSE == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function publishes a heartbeat comment when no event was published
+ * for @ref HTTPSERVER_SSE_HEARTBEAT ticks and someone is subscribed.
+ */
+void HttpServer_sseHeartbeat (HttpServer_DeviceHandle dev);
+
+/**
+ * @ingroup httpServer_functions
+ * This function serves a subscriber for one quantum: it sends the pending
+ * event records of its channels.
+ *@param budget The max number of bytes to send
+ */
+void HttpServer_sseService (HttpServer_DeviceHandle dev,
+                            uint8_t client,
+                            uint16_t budget);
+#endif
+
+#if (HTTPSERVER_RANGE == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function parses the value of a Range header into the message.
+ */
+void HttpServer_parseRange (HttpServer_MessageHandle message, const char* value);
+
+/**
+ * @ingroup httpServer_functions
+ * This function stores the value of an If-Range header into the message.
+ */
+void HttpServer_parseIfRange (HttpServer_MessageHandle message, const char* value);
+
+/**
+ * @ingroup httpServer_functions
+ * This function reads the next part of the resource which is sent into the
+ * free space of the transmission buffer.
+ *@return false if the resource read fails and the connection is closed
+ */
+bool HttpServer_sourceFill (HttpServer_DeviceHandle dev, uint8_t client);
+#endif
+
+#if (HTTPSERVER_UPLOAD == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function serves an upload for one quantum: it reads the body into
+ * the sink buffer and writes the full blocks. While the sink is busy the
+ * socket isn't read.
+ *@param budget The max number of bytes to read
+ */
+void HttpServer_uploadService (HttpServer_DeviceHandle dev,
+                               uint8_t client,
+                               uint16_t budget);
+
+/**
+ * @ingroup httpServer_functions
+ * This function notifies the sink that the upload is aborted.
+ */
+void HttpServer_uploadAbort (HttpServer_DeviceHandle dev, uint8_t client);
+#endif
+
+#if (HTTPSERVER_RATELIMIT == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function checks the limits of the peer address of a new client:
+ * when they are exceeded a 429 Too Many Requests response is sent and the
+ * connection is closed.
+ *@return true when the client is admitted
+ */
+bool HttpServer_rateLimitConnection (HttpServer_DeviceHandle dev,
+                                     uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function takes a request token of the peer address of a client,
+ * before the request line is parsed: when the requests are too fast a
+ * 429 Too Many Requests response is staged.
+ *@return true when the request can be parsed
+ */
+bool HttpServer_rateLimitRequest (HttpServer_DeviceHandle dev,
+                                  uint8_t client);
+#endif
+
+#if (HTTPSERVER_BORROWED == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function sends to the socket at most @a limit bytes of the borrowed
+ * body, directly from the application buffer.
+ *@return The number of bytes accepted by the socket
+ */
+uint16_t HttpServer_borrowedDrain (HttpServer_DeviceHandle dev,
+                                   uint8_t client,
+                                   uint16_t limit);
+
+/**
+ * @ingroup httpServer_functions
+ * This function gives back the borrowed body to the application, if any.
+ *@param sent true when the whole body was sent
+ */
+void HttpServer_borrowedRelease (HttpServer_DeviceHandle dev,
+                                 uint8_t client,
+                                 bool sent);
+#endif
+
+#if (HTTPSERVER_HTTP2 == 1)
+///Value of @ref HttpServer_Http2 client when the connection is free
+#define HTTPSERVER_HTTP2_FREE             0xFF
+
+/**
+ * @ingroup httpServer_functions
+ * This function starts an HTTP/2 connection with prior knowledge, when the
+ * "PRI * HTTP/2.0" line of the connection preface is received. When the
+ * HTTP/2 connection is used by another client, the client is asked to use
+ * HTTP/1.1 and it is closed.
+ */
+void HttpServer_http2Start (HttpServer_DeviceHandle dev, uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function upgrades the connection to HTTP/2 when the request asks
+ * for h2c and the HTTP/2 connection is free. The 101 response is staged
+ * and the request is performed as the stream 1.
+ */
+void HttpServer_http2Upgrade (HttpServer_DeviceHandle dev, uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function serves the HTTP/2 connection: it sends the queued frames,
+ * processes the received ones and, when no response is sent, performs the
+ * next waiting stream.
+ *@param[in,out] budget The number of bytes which can still be read
+ *@return true when the response of the current stream has to be sent
+ */
+bool HttpServer_http2Service (HttpServer_DeviceHandle dev,
+                              uint8_t client,
+                              uint16_t* budget);
+
+/**
+ * @ingroup httpServer_functions
+ * This function translates the staged HTTP/1.1 response into frames of
+ * the current stream and sends them, within the flow control windows.
+ *@return The number of bytes accepted by the socket
+ */
+uint16_t HttpServer_http2Drain (HttpServer_DeviceHandle dev,
+                                uint8_t client,
+                                uint16_t limit);
+
+/**
+ * @ingroup httpServer_functions
+ * This function ends the current stream when its response is sent.
+ *@return false when the end can't be queued yet
+ */
+bool HttpServer_http2StreamEnd (HttpServer_DeviceHandle dev, uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function resets the current stream with HTTP_1_1_REQUIRED, for the
+ * requests which need the whole connection: the client can retry them
+ * with HTTP/1.1.
+ */
+void HttpServer_http2Refuse (HttpServer_DeviceHandle dev, uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function frees the HTTP/2 connection if it is owned by the client.
+ */
+void HttpServer_http2Release (HttpServer_DeviceHandle dev, uint8_t client);
+#endif
+
+/**
+ * @ingroup httpServer_functions
+ * Number of digits of the biggest 32 bit unsigned integer.
+ */
+#define HTTPSERVER_INTEGER_MAX_LENGTH     10
+
+/**
+ * @ingroup httpServer_functions
+ * This function parses a decimal number.
+ *@param[in,out] text The text pointer, moved after the digits
+ *@param[out] value The parsed value
+ *@return false when there isn't any digit or the value doesn't fit 32 bit
+ */
+bool HttpServer_parseNumber (const char** text, uint32_t* value);
+
+/**
+ * @ingroup httpServer_functions
+ * This function converts an unsigned integer into decimal digits, without
+ * the end string character.
+ *@param[out] buffer The buffer of at least @ref HTTPSERVER_INTEGER_MAX_LENGTH
+ * characters where the digits are stored
+ *@param value The value to convert
+ *@return The number of digits
+ */
+uint8_t HttpServer_formatInteger (char* buffer, uint32_t value);
+
+#if (HTTPSERVER_METRICS == 1)
+/**
+ * @ingroup httpServer_functions
+ * Counters are updated only from @ref HttpServer_poll context, so a plain
+ * increment is enough and no lock is needed.
+ */
+#define HTTPSERVER_METRICS_INC(dev,counter)       ((dev)->metrics.counter++)
+#define HTTPSERVER_METRICS_ADD(dev,counter,value) ((dev)->metrics.counter += (value))
+#define HTTPSERVER_METRICS_OBSERVE(dev,histogram,ticks) \
+    HttpServer_observe(&(dev)->metrics.histogram,(ticks))
+
+/**
+ * @ingroup httpServer_functions
+ * This function adds a sample to a log-bucketed histogram: the sample goes
+ * into the bucket indexed by its number of significant bits.
+ *@param histogram The histogram to update
+ *@param ticks The sample value
+ */
+static inline void HttpServer_observe (HttpServer_Histogram* histogram,
+                                       uint32_t ticks)
+{
+    uint8_t index;
+
+#if defined(__GNUC__)
+    index = (ticks == 0) ? 0 : (32 - __builtin_clz(ticks));
+#else
+    for (index = 0; (index < 32) && ((ticks >> index) != 0); ++index);
+#endif
+    if (index >= HTTPSERVER_METRICS_BUCKETS)
+        index = HTTPSERVER_METRICS_BUCKETS - 1;
+
+    histogram->bucket[index]++;
+    histogram->count++;
+    histogram->sum += ticks;
+}
+#else
+#define HTTPSERVER_METRICS_INC(dev,counter)
+#define HTTPSERVER_METRICS_ADD(dev,counter,value)
+#define HTTPSERVER_METRICS_OBSERVE(dev,histogram,ticks)
+#endif
+
+#if (HTTPSERVER_TRACE_ENABLE == 1)
+///The trace ring buffer
+extern HttpServer_TraceRecord HttpServer_traceBuffer[HTTPSERVER_TRACE_DIMENSION];
+///Index of the next trace record, it is never reset to detect the wrap
+extern uint32_t HttpServer_traceHead;
+
+/**
+ * @ingroup httpServer_functions
+ * Tracepoint: it stores a binary record into the trace ring buffer, the
+ * decoding is done only when the trace is dumped.
+ */
+#define HTTPSERVER_TRACE(event,client,arg0,arg1) \
+    HttpServer_trace((event),(client),(uint16_t)(arg0),(uint16_t)(arg1))
+
+static inline void HttpServer_trace (uint8_t event,
+                                     uint8_t client,
+                                     uint16_t arg0,
+                                     uint16_t arg1)
+{
+    HttpServer_TraceRecord* record =
+            &HttpServer_traceBuffer[HttpServer_traceHead++ & (HTTPSERVER_TRACE_DIMENSION - 1)];
+
+    record->tick = HttpServer_currentTick();
+    record->event = event;
+    record->client = client;
+    record->arg0 = arg0;
+    record->arg1 = arg1;
+}
+#else
+#define HTTPSERVER_TRACE(event,client,arg0,arg1)
+#endif
+
+#endif // __OHILAB_HTTPSERVER_INTERNAL_H
@@ -0,0 +1,341 @@
+/*
+ * A simple HTTP/SERVER library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Streaming JSON writer: the tokens are written with
+ * HttpServer_writeResponse straight into the transmission buffer of the
+ * client (chunked or compressed as any streamed response), without an
+ * intermediate body buffer, heap or printf. A big document is written by
+ * a producer from the poll, a buffer at a time.
+ */
+
+#include "http-server.h"
+#include "http-server-internal.h"
+
+#if (HTTPSERVER_JSON == 1)
+
+#if (HTTPSERVER_JSON_MAX_DEPTH < 1) || (HTTPSERVER_JSON_MAX_DEPTH > 32)
+#error "HTTPSERVER_JSON_MAX_DEPTH must be between 1 and 32, one bit of elements for each level"
+#endif
+
+static const char HttpServer_jsonHex[] = "0123456789abcdef";
+
+/**
+ * @ingroup httpServer_functions
+ * This function writes raw characters of the response.
+ */
+static inline void HttpServer_jsonWrite (HttpServer_Json* json,
+                                         const char* text,
+                                         uint16_t length)
+{
+    HttpServer_writeResponse(json->dev,(const uint8_t*)text,length,json->client);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function writes the separator before a value, when needed.
+ * @return false when the value is inside a dropped level and must not be
+ *         written.
+ */
+static bool HttpServer_jsonSeparator (HttpServer_Json* json)
+{
+    uint32_t bit;
+
+    if (json->overflow > 0)
+        return false;
+
+    if (json->key)
+    {
+        json->key = false;
+        return true;
+    }
+
+    // The top level has a single value
+    if (json->depth == 0)
+        return true;
+
+    bit = 1ul << (json->depth - 1);
+    if (json->elements & bit)
+        HttpServer_jsonWrite(json,",",1);
+    json->elements |= bit;
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function opens an object or an array, when the nesting allows it.
+ */
+static bool HttpServer_jsonBegin (HttpServer_Json* json, const char* bracket)
+{
+    if ((json->overflow > 0) || (json->depth == HTTPSERVER_JSON_MAX_DEPTH))
+    {
+        // The outermost dropped level stands as null
+        if (HttpServer_jsonSeparator(json))
+            HttpServer_jsonWrite(json,"null",4);
+        json->overflow++;
+        return false;
+    }
+
+    HttpServer_jsonSeparator(json);
+    HttpServer_jsonWrite(json,bracket,1);
+    json->depth++;
+    json->elements &= ~(1ul << (json->depth - 1));
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function closes an object or an array.
+ */
+static void HttpServer_jsonClose (HttpServer_Json* json, const char* bracket)
+{
+    if (json->overflow > 0)
+    {
+        json->overflow--;
+        return;
+    }
+
+    json->depth--;
+    HttpServer_jsonWrite(json,bracket,1);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function writes a quoted and escaped string.
+ */
+static void HttpServer_jsonQuoted (HttpServer_Json* json, const char* value)
+{
+    const char* run = value;
+    char escape[6] = { '\\', 'u', '0', '0' };
+    uint8_t length;
+
+    HttpServer_jsonWrite(json,"\"",1);
+    for (; *value != '\0'; ++value)
+    {
+        uint8_t c = *value;
+
+        if ((c >= 0x20) && (c != '"') && (c != '\\'))
+            continue;
+
+        // Write the characters which don't need the escape at once
+        if (value > run)
+            HttpServer_jsonWrite(json,run,value - run);
+        run = value + 1;
+
+        length = 2;
+        switch (c)
+        {
+        case '"':  escape[1] = '"';  break;
+        case '\\': escape[1] = '\\'; break;
+        case '\n': escape[1] = 'n';  break;
+        case '\r': escape[1] = 'r';  break;
+        case '\t': escape[1] = 't';  break;
+        case '\b': escape[1] = 'b';  break;
+        case '\f': escape[1] = 'f';  break;
+        default:
+            escape[1] = 'u';
+            escape[4] = HttpServer_jsonHex[c >> 4];
+            escape[5] = HttpServer_jsonHex[c & 0x0F];
+            length = 6;
+            break;
+        }
+        HttpServer_jsonWrite(json,escape,length);
+    }
+    if (value > run)
+        HttpServer_jsonWrite(json,run,value - run);
+    HttpServer_jsonWrite(json,"\"",1);
+}
+
+void HttpServer_jsonStart (HttpServer_Json* json,
+                           HttpServer_DeviceHandle dev,
+                           HttpServer_ResponseCode code,
+                           uint8_t client)
+{
+    json->dev = dev;
+    json->client = client;
+    json->depth = 0;
+    json->key = false;
+    json->elements = 0;
+    json->overflow = 0;
+    json->producer = NULL;
+
+    HttpServer_startResponse(dev,code,"Content-Type: application/json",client);
+}
+
+void HttpServer_jsonEnd (HttpServer_Json* json)
+{
+    HttpServer_endResponse(json->dev,json->client);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function calls the JSON producer from the poll.
+ */
+static void HttpServer_jsonProduce (void* context, uint8_t client)
+{
+    HttpServer_Json* json = (HttpServer_Json*)context;
+
+    (void)client;
+    json->producer(json,json->context);
+}
+
+void HttpServer_jsonContinue (HttpServer_Json* json,
+                              void (*producer)(HttpServer_Json* json, void* context),
+                              void* context)
+{
+    json->producer = producer;
+    json->context = context;
+    HttpServer_continueResponse(json->dev,HttpServer_jsonProduce,json,json->client);
+}
+
+bool HttpServer_jsonFull (HttpServer_Json* json)
+{
+    HttpServer_ClientHandle c = &json->dev->clients[json->client];
+
+    // An aborted response takes nothing more
+    return (c->txAborted) || (c->txLength > (HTTPSERVER_TX_BUFFER_DIMENSION / 2));
+}
+
+bool HttpServer_jsonBeginObject (HttpServer_Json* json)
+{
+    return HttpServer_jsonBegin(json,"{");
+}
+
+void HttpServer_jsonEndObject (HttpServer_Json* json)
+{
+    HttpServer_jsonClose(json,"}");
+}
+
+bool HttpServer_jsonBeginArray (HttpServer_Json* json)
+{
+    return HttpServer_jsonBegin(json,"[");
+}
+
+void HttpServer_jsonEndArray (HttpServer_Json* json)
+{
+    HttpServer_jsonClose(json,"]");
+}
+
+void HttpServer_jsonKey (HttpServer_Json* json, const char* key)
+{
+    if (!HttpServer_jsonSeparator(json))
+        return;
+    HttpServer_jsonQuoted(json,key);
+    HttpServer_jsonWrite(json,":",1);
+    json->key = true;
+}
+
+void HttpServer_jsonString (HttpServer_Json* json, const char* value)
+{
+    if (!HttpServer_jsonSeparator(json))
+        return;
+    HttpServer_jsonQuoted(json,value);
+}
+
+void HttpServer_jsonInteger (HttpServer_Json* json, int32_t value)
+{
+    char buffer[HTTPSERVER_INTEGER_MAX_LENGTH + 1];
+    uint8_t length = 0;
+
+    if (!HttpServer_jsonSeparator(json))
+        return;
+    if (value < 0)
+        buffer[length++] = '-';
+    // The unsigned negation is valid also for INT32_MIN
+    length += HttpServer_formatInteger(&buffer[length],
+                                       (value < 0) ? (0u - (uint32_t)value) : (uint32_t)value);
+    HttpServer_jsonWrite(json,buffer,length);
+}
+
+void HttpServer_jsonFixed (HttpServer_Json* json, int32_t value, uint8_t decimals)
+{
+    // Sign, integer part, point and fraction
+    char buffer[(2 * HTTPSERVER_INTEGER_MAX_LENGTH) + 2];
+    char fraction[HTTPSERVER_INTEGER_MAX_LENGTH];
+    uint32_t magnitude = (value < 0) ? (0u - (uint32_t)value) : (uint32_t)value;
+    uint32_t integer = magnitude;
+    uint32_t scale = 1;
+    uint8_t length = 0;
+    uint8_t digits;
+
+    // The number of digits of an int32 is the max meaningful precision
+    if (decimals > HTTPSERVER_INTEGER_MAX_LENGTH)
+    {
+        HttpServer_jsonNull(json);
+        return;
+    }
+    if (!HttpServer_jsonSeparator(json))
+        return;
+
+    // 10^9 is the biggest power which fits 32 bit: with 10 decimals the
+    // integer part is always 0
+    if (decimals == HTTPSERVER_INTEGER_MAX_LENGTH)
+    {
+        integer = 0;
+    }
+    else if (decimals > 0)
+    {
+        for (uint8_t i = 0; i < decimals; ++i)
+            scale *= 10;
+        integer = magnitude / scale;
+        magnitude %= scale;
+    }
+
+    if (value < 0)
+        buffer[length++] = '-';
+    length += HttpServer_formatInteger(&buffer[length],integer);
+
+    if (decimals > 0)
+    {
+        // The fraction is padded with leading zeros
+        digits = HttpServer_formatInteger(fraction,magnitude);
+        buffer[length++] = '.';
+        memset(&buffer[length],'0',decimals - digits);
+        memcpy(&buffer[length + decimals - digits],fraction,digits);
+        length += decimals;
+    }
+    HttpServer_jsonWrite(json,buffer,length);
+}
+
+void HttpServer_jsonBool (HttpServer_Json* json, bool value)
+{
+    if (!HttpServer_jsonSeparator(json))
+        return;
+    if (value)
+        HttpServer_jsonWrite(json,"true",4);
+    else
+        HttpServer_jsonWrite(json,"false",5);
+}
+
+void HttpServer_jsonNull (HttpServer_Json* json)
+{
+    if (!HttpServer_jsonSeparator(json))
+        return;
+    HttpServer_jsonWrite(json,"null",4);
+}
+
+#endif // HTTPSERVER_JSON
@@ -0,0 +1,274 @@
+/*
+ * A simple HTTP/SERVER library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "http-server.h"
+#include "http-server-internal.h"
+
+#if (HTTPSERVER_METRICS == 1)
+
+static const char* const HttpServer_metricsMethod[HTTPSERVER_REQUEST_CONNECT+1] =
+{
+    HTTPSERVER_STRING_REQUEST_GET,
+    HTTPSERVER_STRING_REQUEST_POST,
+    HTTPSERVER_STRING_REQUEST_PUT,
+    HTTPSERVER_STRING_REQUEST_OPTIONS,
+    HTTPSERVER_STRING_REQUEST_HEAD,
+    HTTPSERVER_STRING_REQUEST_DELETE,
+    HTTPSERVER_STRING_REQUEST_TRACE,
+    HTTPSERVER_STRING_REQUEST_CONNECT,
+};
+
+static const char* const HttpServer_metricsCounterName[] =
+{
+    "connections_accepted_total",
+    "connections_closed_total",
+    "connections_refused_total",
+#if (HTTPSERVER_RATELIMIT == 1)
+    "rate_limited_total",
+#endif
+#if (HTTPSERVER_HTTP2 == 1)
+    "http2_connections_total",
+#endif
+    "parse_errors_total",
+    "timeouts_total",
+    "received_bytes_total",
+    "sent_bytes_total",
+};
+
+static const char* const HttpServer_metricsHistogramName[] =
+{
+    "first_line",
+    "headers",
+    "handler",
+    "send",
+};
+
+/**
+ * @ingroup httpServer_functions
+ * Number of lines of each part of the metrics: type and value of each
+ * counter, type and one line for each method or status class, type,
+ * buckets, sum and count of each histogram.
+ */
+#define HTTPSERVER_METRICS_COUNTER_LINES   (2 * (sizeof(HttpServer_metricsCounterName) / sizeof(HttpServer_metricsCounterName[0])))
+#define HTTPSERVER_METRICS_REQUEST_LINES   (HTTPSERVER_REQUEST_CONNECT + 2)
+#define HTTPSERVER_METRICS_RESPONSE_LINES  6
+#define HTTPSERVER_METRICS_HISTOGRAM_LINES (HTTPSERVER_METRICS_BUCKETS + 3)
+#define HTTPSERVER_METRICS_LINES           (HTTPSERVER_METRICS_COUNTER_LINES +  \
+                                            HTTPSERVER_METRICS_REQUEST_LINES +  \
+                                            HTTPSERVER_METRICS_RESPONSE_LINES + \
+                                            (4 * HTTPSERVER_METRICS_HISTOGRAM_LINES))
+
+/**
+ * @ingroup httpServer_functions
+ * This function appends a string to the line.
+ *@return The new length of the line
+ */
+static uint8_t HttpServer_metricsString (char* line,
+                                         uint8_t length,
+                                         const char* string)
+{
+    uint8_t size = strlen(string);
+
+    memcpy(&line[length],string,size);
+    return length + size;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function appends an unsigned integer and the end line to the line.
+ *@return The new length of the line
+ */
+static uint8_t HttpServer_metricsValue (char* line,
+                                        uint8_t length,
+                                        uint32_t value)
+{
+    length += HttpServer_formatInteger(&line[length],value);
+    line[length++] = '\n';
+    return length;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function writes a line of a counter: its type, or its value.
+ */
+static uint8_t HttpServer_metricsCounter (char* line,
+                                          const char* name,
+                                          bool type,
+                                          uint32_t value)
+{
+    uint8_t length;
+
+    if (type)
+    {
+        length = HttpServer_metricsString(line,0,"# TYPE httpserver_");
+        length = HttpServer_metricsString(line,length,name);
+        return HttpServer_metricsString(line,length," counter\n");
+    }
+
+    length = HttpServer_metricsString(line,0,"httpserver_");
+    length = HttpServer_metricsString(line,length,name);
+    length = HttpServer_metricsString(line,length," ");
+    return HttpServer_metricsValue(line,length,value);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function writes a line of a histogram: its type, a cumulative
+ * bucket, the sum or the count.
+ *@param step The line, from 0 to HTTPSERVER_METRICS_HISTOGRAM_LINES - 1
+ */
+static uint8_t HttpServer_metricsHistogram (char* line,
+                                            const char* name,
+                                            const HttpServer_Histogram* histogram,
+                                            uint8_t step)
+{
+    uint32_t total = 0;
+    uint8_t length;
+
+    if (step == 0)
+    {
+        length = HttpServer_metricsString(line,0,"# TYPE httpserver_");
+        length = HttpServer_metricsString(line,length,name);
+        return HttpServer_metricsString(line,length,"_ticks histogram\n");
+    }
+
+    length = HttpServer_metricsString(line,0,"httpserver_");
+    length = HttpServer_metricsString(line,length,name);
+    if (step == (HTTPSERVER_METRICS_HISTOGRAM_LINES - 2))
+    {
+        length = HttpServer_metricsString(line,length,"_ticks_sum ");
+        return HttpServer_metricsValue(line,length,histogram->sum);
+    }
+    if (step == (HTTPSERVER_METRICS_HISTOGRAM_LINES - 1))
+    {
+        length = HttpServer_metricsString(line,length,"_ticks_count ");
+        return HttpServer_metricsValue(line,length,histogram->count);
+    }
+
+    // The bucket i counts the samples lower than 2^i
+    step -= 1;
+    for (uint8_t i = 0; i <= step; ++i)
+        total += histogram->bucket[i];
+    length = HttpServer_metricsString(line,length,"_ticks_bucket{le=\"");
+    if (step == (HTTPSERVER_METRICS_BUCKETS - 1))
+        length = HttpServer_metricsString(line,length,"+Inf");
+    else
+        length += HttpServer_formatInteger(&line[length],(1ul << step) - 1);
+    length = HttpServer_metricsString(line,length,"\"} ");
+    return HttpServer_metricsValue(line,length,total);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function writes a line of the metrics, see @ref HttpServer_Generator .
+ * The values are read when the line is written.
+ */
+static uint8_t HttpServer_metricsLine (HttpServer_DeviceHandle dev,
+                                       uint8_t client,
+                                       char* line)
+{
+    const HttpServer_Metrics* metrics = &dev->metrics;
+    const uint32_t counters[] =
+    {
+        metrics->connectionsAccepted,
+        metrics->connectionsClosed,
+        metrics->connectionsRefused,
+#if (HTTPSERVER_RATELIMIT == 1)
+        metrics->rateLimited,
+#endif
+#if (HTTPSERVER_HTTP2 == 1)
+        metrics->http2Connections,
+#endif
+        metrics->parseErrors,
+        metrics->timeouts,
+        metrics->bytesIn,
+        metrics->bytesOut,
+    };
+    const HttpServer_Histogram* const histograms[] =
+    {
+        &metrics->firstLine,
+        &metrics->headers,
+        &metrics->handler,
+        &metrics->send,
+    };
+    uint32_t step = dev->clients[client].generatorStep;
+    uint8_t length;
+
+    if (step < HTTPSERVER_METRICS_COUNTER_LINES)
+    {
+        return HttpServer_metricsCounter(line,
+                                         HttpServer_metricsCounterName[step / 2],
+                                         (step % 2) == 0,
+                                         counters[step / 2]);
+    }
+    step -= HTTPSERVER_METRICS_COUNTER_LINES;
+
+    if (step == 0)
+        return HttpServer_metricsString(line,0,"# TYPE httpserver_requests_total counter\n");
+    if (step < HTTPSERVER_METRICS_REQUEST_LINES)
+    {
+        length = HttpServer_metricsString(line,0,"httpserver_requests_total{method=\"");
+        length = HttpServer_metricsString(line,length,HttpServer_metricsMethod[step - 1]);
+        length = HttpServer_metricsString(line,length,"\"} ");
+        return HttpServer_metricsValue(line,length,metrics->requests[step - 1]);
+    }
+    step -= HTTPSERVER_METRICS_REQUEST_LINES;
+
+    if (step == 0)
+        return HttpServer_metricsString(line,0,"# TYPE httpserver_responses_total counter\n");
+    if (step < HTTPSERVER_METRICS_RESPONSE_LINES)
+    {
+        length = HttpServer_metricsString(line,0,"httpserver_responses_total{class=\"");
+        line[length++] = '0' + step;
+        length = HttpServer_metricsString(line,length,"xx\"} ");
+        return HttpServer_metricsValue(line,length,metrics->responses[step - 1]);
+    }
+    step -= HTTPSERVER_METRICS_RESPONSE_LINES;
+
+    if (step >= (4 * HTTPSERVER_METRICS_HISTOGRAM_LINES))
+        return 0;
+    return HttpServer_metricsHistogram(line,
+                                       HttpServer_metricsHistogramName[step / HTTPSERVER_METRICS_HISTOGRAM_LINES],
+                                       histograms[step / HTTPSERVER_METRICS_HISTOGRAM_LINES],
+                                       step % HTTPSERVER_METRICS_HISTOGRAM_LINES);
+}
+
+void HttpServer_sendMetrics (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    // The body length is not known in advance: the end of the body is
+    // marked by the connection close. The lines are written while the
+    // response is sent, so a slow client doesn't hold the poll.
+    HttpServer_sendResponse(dev,
+                            HTTPSERVER_RESPONSECODE_OK,
+                            "Content-Type: text/plain; version=0.0.4\r\n"
+                            "Connection: close\r\nServer: " HTTPSERVER_SERVER_NAME,
+                            "",
+                            client);
+    HttpServer_txGenerate(dev,client,HttpServer_metricsLine,0,HTTPSERVER_METRICS_LINES);
+}
+
+#endif // HTTPSERVER_METRICS
@@ -0,0 +1,400 @@
+/*
+ * A simple HTTP/SERVER library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Incremental multipart/form-data parser (RFC 7578) fed by the upload
+ * sink. The body is received block by block into the receive buffer of the
+ * client and the delimiters are searched with the Boyer-Moore-Horspool
+ * algorithm. The tail of a block which can be the begin of a delimiter is
+ * kept in a carry buffer and the search continues with the next block, so
+ * no more than a block and a delimiter are stored.
+ */
+
+#include "http-server.h"
+#include "http-server-internal.h"
+
+#if (HTTPSERVER_MULTIPART == 1)
+
+/**
+ * @ingroup httpServer_functions
+ * The multipart parser states.
+ */
+typedef enum
+{
+    ///Before the first delimiter, the data are discarded
+    HTTPSERVER_MULTIPART_PREAMBLE,
+    ///After a delimiter: -- or \r\n is expected
+    HTTPSERVER_MULTIPART_BOUNDARY,
+    ///The first - of the closing delimiter is received
+    HTTPSERVER_MULTIPART_BOUNDARY_DASH,
+    ///The \r of the delimiter line end is received
+    HTTPSERVER_MULTIPART_BOUNDARY_CR,
+    ///Receiving the part headers
+    HTTPSERVER_MULTIPART_HEADERS,
+    ///Receiving the part data
+    HTTPSERVER_MULTIPART_DATA,
+    ///After the closing delimiter, the data are discarded
+    HTTPSERVER_MULTIPART_EPILOGUE,
+
+} HttpServer_MultipartState;
+
+/**
+ * @ingroup httpServer_functions
+ * This function returns a byte of the carry buffer followed by the block.
+ */
+static inline uint8_t HttpServer_multipartByte (const HttpServer_Multipart* parser,
+                                                const uint8_t* data,
+                                                uint16_t index)
+{
+    return (index < parser->carryLength) ? parser->carry[index] :
+                                           data[index - parser->carryLength];
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function searches the delimiter into the carry buffer followed by
+ * the block.
+ *@param[out] position The delimiter position when it is found, otherwise
+ * the first position which can still be the begin of a delimiter
+ *@return true if the delimiter is found
+ */
+static bool HttpServer_multipartSearch (const HttpServer_Multipart* parser,
+                                        const uint8_t* data,
+                                        uint16_t length,
+                                        uint16_t* position)
+{
+    uint16_t total = parser->carryLength + length;
+    uint16_t last = parser->delimiterLength - 1;
+    uint16_t index = 0;
+    int16_t i;
+
+    while ((index + last) < total)
+    {
+        // Compare from the end of the delimiter
+        for (i = last;
+             (i >= 0) && (HttpServer_multipartByte(parser,data,index + i) == parser->delimiter[i]);
+             --i);
+
+        if (i < 0)
+        {
+            *position = index;
+            return true;
+        }
+        index += parser->skip[HttpServer_multipartByte(parser,data,index + last)];
+    }
+
+    *position = index;
+    return false;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function passes to the application the part data up to the end
+ * position of the carry buffer followed by the block.
+ */
+static bool HttpServer_multipartEmit (HttpServer_Multipart* parser,
+                                      const uint8_t* data,
+                                      uint16_t end,
+                                      bool last)
+{
+    uint16_t fromCarry = (end < parser->carryLength) ? end : parser->carryLength;
+
+    // The preamble is discarded
+    if (parser->state != HTTPSERVER_MULTIPART_DATA)
+        return true;
+
+    if ((fromCarry > 0) &&
+        !parser->dataCallback(parser->context,parser->carry,fromCarry,last && (end == fromCarry)))
+    {
+        return false;
+    }
+    if ((end > fromCarry) || ((fromCarry == 0) && last))
+        return parser->dataCallback(parser->context,data,end - fromCarry,last);
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * The sink write function: it parses a block of the body.
+ */
+static HttpServer_SinkStatus HttpServer_multipartWrite (void* context,
+                                                        uint32_t offset,
+                                                        const uint8_t* data,
+                                                        uint16_t length)
+{
+    HttpServer_Multipart* parser = context;
+    uint16_t index = 0;
+    uint16_t position, keep, end;
+    const uint8_t* segment;
+    uint16_t segmentLength;
+    uint8_t c;
+
+    (void)offset;
+
+    while (index < length)
+    {
+        switch (parser->state)
+        {
+        case HTTPSERVER_MULTIPART_PREAMBLE:
+        case HTTPSERVER_MULTIPART_DATA:
+            segment = &data[index];
+            segmentLength = length - index;
+
+            if (HttpServer_multipartSearch(parser,segment,segmentLength,&position))
+            {
+                if (!HttpServer_multipartEmit(parser,segment,position,true))
+                    return HTTPSERVER_SINK_ERROR;
+
+                // The delimiter is longer than the carry buffer, so it
+                // always ends into the block
+                index += position + parser->delimiterLength - parser->carryLength;
+                parser->carryLength = 0;
+                parser->state = HTTPSERVER_MULTIPART_BOUNDARY;
+                break;
+            }
+
+            if (!HttpServer_multipartEmit(parser,segment,position,false))
+                return HTTPSERVER_SINK_ERROR;
+
+            // Keep the tail which can be the begin of a delimiter
+            keep = parser->carryLength + segmentLength - position;
+            if (position < parser->carryLength)
+            {
+                memmove(parser->carry,&parser->carry[position],parser->carryLength - position);
+                memcpy(&parser->carry[parser->carryLength - position],segment,segmentLength);
+            }
+            else
+            {
+                memcpy(parser->carry,&segment[position - parser->carryLength],keep);
+            }
+            parser->carryLength = keep;
+            return HTTPSERVER_SINK_OK;
+
+        case HTTPSERVER_MULTIPART_BOUNDARY:
+            c = data[index++];
+            if (c == '-')
+                parser->state = HTTPSERVER_MULTIPART_BOUNDARY_DASH;
+            else if (c == '\r')
+                parser->state = HTTPSERVER_MULTIPART_BOUNDARY_CR;
+            else if ((c != ' ') && (c != '\t'))
+                return HTTPSERVER_SINK_ERROR;
+            break;
+
+        case HTTPSERVER_MULTIPART_BOUNDARY_DASH:
+            if (data[index++] != '-')
+                return HTTPSERVER_SINK_ERROR;
+            parser->state = HTTPSERVER_MULTIPART_EPILOGUE;
+            break;
+
+        case HTTPSERVER_MULTIPART_BOUNDARY_CR:
+            if (data[index++] != '\n')
+                return HTTPSERVER_SINK_ERROR;
+            parser->headersLength = 0;
+            // A part without headers begins with the empty line
+            parser->match = 2;
+            parser->state = HTTPSERVER_MULTIPART_HEADERS;
+            break;
+
+        case HTTPSERVER_MULTIPART_HEADERS:
+            c = data[index++];
+            if (parser->headersLength < HTTPSERVER_MULTIPART_HEADERS_LENGTH)
+                parser->headers[parser->headersLength] = c;
+            parser->headersLength++;
+
+            if (c == "\r\n\r\n"[parser->match])
+                parser->match++;
+            else
+                parser->match = (c == '\r') ? 1 : 0;
+
+            if (parser->match == 4)
+            {
+                // Drop the empty line
+                end = parser->headersLength - 2;
+                if (end > HTTPSERVER_MULTIPART_HEADERS_LENGTH)
+                    end = HTTPSERVER_MULTIPART_HEADERS_LENGTH;
+                parser->headers[end] = '\0';
+
+                if (parser->partCallback != 0)
+                    parser->partCallback(parser->context,parser->headers);
+                parser->state = HTTPSERVER_MULTIPART_DATA;
+            }
+            break;
+
+        default:
+            // Epilogue
+            return HTTPSERVER_SINK_OK;
+        }
+    }
+    return HTTPSERVER_SINK_OK;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * The sink finish function.
+ */
+static HttpServer_ResponseCode HttpServer_multipartFinish (void* context,
+                                                           uint32_t length,
+                                                           uint32_t crc,
+                                                           bool complete)
+{
+    HttpServer_Multipart* parser = context;
+
+    (void)length;
+    (void)crc;
+
+    return parser->finishCallback(parser->context,
+                                  complete && (parser->state == HTTPSERVER_MULTIPART_EPILOGUE));
+}
+
+HttpServer_Error HttpServer_startMultipart (HttpServer_DeviceHandle dev,
+                                            HttpServer_Multipart* parser,
+                                            uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    const char* type = HttpServer_findHeader(c->message.header,"Content-Type");
+    const char* boundary = NULL;
+    uint8_t length = 0;
+    bool quoted = false;
+
+    if ((type != NULL) && HttpServer_compareNoCase(type,"multipart/",10))
+    {
+        for (; (*type != '\0') && (*type != '\r'); ++type)
+        {
+            if (HttpServer_compareNoCase(type,"boundary=",9))
+            {
+                boundary = type + 9;
+                break;
+            }
+        }
+    }
+
+    if (boundary != NULL)
+    {
+        if (*boundary == '"')
+        {
+            quoted = true;
+            boundary++;
+        }
+        while ((length <= HTTPSERVER_MULTIPART_BOUNDARY_LENGTH) &&
+               (boundary[length] != '\0') && (boundary[length] != '\r') &&
+               (quoted ? (boundary[length] != '"') :
+                         ((boundary[length] != ';') && (boundary[length] != ' '))))
+        {
+            length++;
+        }
+    }
+
+    if ((length == 0) || (length > HTTPSERVER_MULTIPART_BOUNDARY_LENGTH))
+    {
+        HttpServer_sendResponse(dev,
+                                HTTPSERVER_RESPONSECODE_BADREQUEST,
+                                "Content-Length: 0\r\nServer: " HTTPSERVER_SERVER_NAME,
+                                "",
+                                client);
+        return HTTPSERVER_ERROR_WRONG_REQUEST_FORMAT;
+    }
+
+    memcpy(parser->delimiter,"\r\n--",4);
+    memcpy(&parser->delimiter[4],boundary,length);
+    parser->delimiterLength = length + 4;
+
+    // Horspool shift: distance of the last occurrence of each byte from
+    // the end of the delimiter, its last byte excluded
+    memset(parser->skip,parser->delimiterLength,sizeof(parser->skip));
+    for (uint8_t i = 0; i < (parser->delimiterLength - 1); ++i)
+        parser->skip[parser->delimiter[i]] = parser->delimiterLength - 1 - i;
+
+    // The first delimiter is at the begin of the body, without the
+    // preceding line end
+    parser->carry[0] = '\r';
+    parser->carry[1] = '\n';
+    parser->carryLength = 2;
+    parser->state = HTTPSERVER_MULTIPART_PREAMBLE;
+
+    // The body blocks are received into the receive buffer, which is not
+    // used during the upload
+    parser->sink.buffer = c->rxBuffer;
+    parser->sink.blockSize = HTTPSERVER_RX_BUFFER_DIMENSION;
+    parser->sink.write = HttpServer_multipartWrite;
+    parser->sink.finish = HttpServer_multipartFinish;
+    parser->sink.context = parser;
+
+    return HttpServer_startUpload(dev,&parser->sink,client);
+}
+
+bool HttpServer_multipartParameter (const char* headers,
+                                    const char* name,
+                                    char* value,
+                                    uint16_t size)
+{
+    const char* p = HttpServer_findHeader(headers,"Content-Disposition");
+    uint16_t nameLength = strlen(name);
+    uint16_t length = 0;
+    bool quoted;
+
+    if ((p == NULL) || (size == 0))
+        return false;
+
+    for (;;)
+    {
+        while ((*p == ' ') || (*p == ';'))
+            p++;
+        if ((*p == '\0') || (*p == '\r'))
+            return false;
+
+        if (HttpServer_compareNoCase(p,name,nameLength) && (p[nameLength] == '='))
+            break;
+
+        // Skip the parameter, its value can be a quoted string
+        while ((*p != '\0') && (*p != '\r') && (*p != ';'))
+        {
+            if (*p++ == '"')
+            {
+                while ((*p != '\0') && (*p != '\r') && (*p != '"'))
+                    p++;
+                if (*p == '"')
+                    p++;
+            }
+        }
+    }
+
+    p += nameLength + 1;
+    quoted = (*p == '"');
+    if (quoted)
+        p++;
+    while ((*p != '\0') && (*p != '\r') &&
+           (quoted ? (*p != '"') : ((*p != ';') && (*p != ' '))))
+    {
+        if (length < (size - 1))
+            value[length++] = *p;
+        p++;
+    }
+    value[length] = '\0';
+    return true;
+}
+
+#endif // HTTPSERVER_MULTIPART
@@ -0,0 +1,181 @@
+/*
+ * A simple HTTP/SERVER library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Configuration profiles: each one gives the defaults of the sizing and
+ * feature macros for a class of target. Every macro can still be defined
+ * in board.h, the profile only fills the ones which are not defined, and
+ * the remaining ones take the defaults of http-server.h.
+ */
+
+#ifndef __OHILAB_HTTPSERVER_PROFILE_H
+#define __OHILAB_HTTPSERVER_PROFILE_H
+
+/**
+ * @ingroup httpServer_macros
+ * Small parts: short requests, one response at a time for each
+ * connection, only the core features.
+ */
+#define HTTPSERVER_PROFILE_TINY             0
+/**
+ * @ingroup httpServer_macros
+ * The defaults of http-server.h.
+ */
+#define HTTPSERVER_PROFILE_DEFAULT          1
+/**
+ * @ingroup httpServer_macros
+ * Parts with RAM to spare: long headers, wide buffers and all features.
+ */
+#define HTTPSERVER_PROFILE_GATEWAY          2
+
+/**
+ * @ingroup httpServer_macros
+ * The configuration profile.
+ */
+#ifndef HTTPSERVER_PROFILE
+#define HTTPSERVER_PROFILE                  HTTPSERVER_PROFILE_DEFAULT
+#endif
+
+#if (HTTPSERVER_PROFILE == HTTPSERVER_PROFILE_TINY)
+
+#ifndef HTTPSERVER_MAX_URI_LENGTH
+#define HTTPSERVER_MAX_URI_LENGTH           63
+#endif
+#ifndef HTTPSERVER_HEADERS_MAX_LENGTH
+#define HTTPSERVER_HEADERS_MAX_LENGTH       255
+#endif
+#ifndef HTTPSERVER_BODY_MAX_LENGTH
+#define HTTPSERVER_BODY_MAX_LENGTH          63
+#endif
+#ifndef HTTPSERVER_RX_BUFFER_DIMENSION
+#define HTTPSERVER_RX_BUFFER_DIMENSION      127
+#endif
+#ifndef HTTPSERVER_TX_BUFFER_DIMENSION
+#define HTTPSERVER_TX_BUFFER_DIMENSION      127
+#endif
+#ifndef HTTPSERVER_KEEPALIVE
+#define HTTPSERVER_KEEPALIVE                0
+#endif
+#ifndef HTTPSERVER_BORROWED
+#define HTTPSERVER_BORROWED                 1
+#endif
+#ifndef HTTPSERVER_CORK
+#define HTTPSERVER_CORK                     0
+#endif
+#ifndef HTTPSERVER_ARENA
+#define HTTPSERVER_ARENA                    0
+#endif
+#ifndef HTTPSERVER_COMPRESSION
+#define HTTPSERVER_COMPRESSION              0
+#endif
+#ifndef HTTPSERVER_WEBSOCKET
+#define HTTPSERVER_WEBSOCKET                0
+#endif
+#ifndef HTTPSERVER_SSE
+#define HTTPSERVER_SSE                      0
+#endif
+#ifndef HTTPSERVER_RANGE
+#define HTTPSERVER_RANGE                    0
+#endif
+#ifndef HTTPSERVER_UPLOAD
+#define HTTPSERVER_UPLOAD                   1
+#endif
+#ifndef HTTPSERVER_MULTIPART
+#define HTTPSERVER_MULTIPART                0
+#endif
+#ifndef HTTPSERVER_JSON
+#define HTTPSERVER_JSON                     0
+#endif
+#ifndef HTTPSERVER_RATELIMIT_ENTRIES
+#define HTTPSERVER_RATELIMIT_ENTRIES        8
+#endif
+#ifndef HTTPSERVER_METRICS
+#define HTTPSERVER_METRICS                  0
+#endif
+#ifndef HTTPSERVER_TRACE_ENABLE
+#define HTTPSERVER_TRACE_ENABLE             0
+#endif
+
+#elif (HTTPSERVER_PROFILE == HTTPSERVER_PROFILE_GATEWAY)
+
+#ifndef HTTPSERVER_MAX_URI_LENGTH
+#define HTTPSERVER_MAX_URI_LENGTH           255
+#endif
+#ifndef HTTPSERVER_HEADERS_MAX_LENGTH
+#define HTTPSERVER_HEADERS_MAX_LENGTH       2047
+#endif
+#ifndef HTTPSERVER_BODY_MAX_LENGTH
+#define HTTPSERVER_BODY_MAX_LENGTH          511
+#endif
+#ifndef HTTPSERVER_RX_BUFFER_DIMENSION
+#define HTTPSERVER_RX_BUFFER_DIMENSION      1023
+#endif
+#ifndef HTTPSERVER_TX_BUFFER_DIMENSION
+#define HTTPSERVER_TX_BUFFER_DIMENSION      2920
+#endif
+#ifndef HTTPSERVER_ARENA_DIMENSION
+#define HTTPSERVER_ARENA_DIMENSION          2048
+#endif
+#ifndef HTTPSERVER_POLL_QUANTUM_BYTES
+#define HTTPSERVER_POLL_QUANTUM_BYTES       1460
+#endif
+#ifndef HTTPSERVER_COMPRESSION_WINDOW
+#define HTTPSERVER_COMPRESSION_WINDOW       4096
+#endif
+#ifndef HTTPSERVER_COMPRESSION_HASH_BITS
+#define HTTPSERVER_COMPRESSION_HASH_BITS    10
+#endif
+#ifndef HTTPSERVER_SSE_BUFFER_DIMENSION
+#define HTTPSERVER_SSE_BUFFER_DIMENSION     2048
+#endif
+#ifndef HTTPSERVER_RATELIMIT_ENTRIES
+#define HTTPSERVER_RATELIMIT_ENTRIES        64
+#endif
+#ifndef HTTPSERVER_HTTP2
+#define HTTPSERVER_HTTP2                    1
+#endif
+#ifndef HTTPSERVER_HTTP2_STREAMS
+#define HTTPSERVER_HTTP2_STREAMS            8
+#endif
+#ifndef HTTPSERVER_HTTP2_PENDING_DIMENSION
+#define HTTPSERVER_HTTP2_PENDING_DIMENSION  4096
+#endif
+#ifndef HTTPSERVER_HTTP2_TABLE_DIMENSION
+#define HTTPSERVER_HTTP2_TABLE_DIMENSION    512
+#endif
+#ifndef HTTPSERVER_HTTP2_OUT_DIMENSION
+#define HTTPSERVER_HTTP2_OUT_DIMENSION      512
+#endif
+#ifndef HTTPSERVER_TRACE_DIMENSION
+#define HTTPSERVER_TRACE_DIMENSION          256
+#endif
+
+#elif (HTTPSERVER_PROFILE != HTTPSERVER_PROFILE_DEFAULT)
+#error "HTTPSERVER_PROFILE must be one of the HTTPSERVER_PROFILE_* values"
+#endif
+
+#endif // __OHILAB_HTTPSERVER_PROFILE_H
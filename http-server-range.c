@@ -0,0 +1,225 @@
+/*
+ * A simple HTTP/SERVER library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Byte range requests (RFC 7233): a single range is parsed from the Range
+ * header, it is served only when the optional If-Range validator matches.
+ * Multiple ranges and malformed headers are ignored, so the whole resource
+ * is sent, as allowed by the RFC.
+ */
+
+#include "http-server.h"
+#include "http-server-internal.h"
+
+#if (HTTPSERVER_RANGE == 1)
+
+void HttpServer_parseRange (HttpServer_MessageHandle message, const char* value)
+{
+    uint8_t flags = HTTPSERVER_RANGEFLAGS_PRESENT;
+
+    while (*value == ' ') value++;
+    if (!HttpServer_compareNoCase(value,"bytes=",6))
+        return;
+    value += 6;
+    while (*value == ' ') value++;
+
+    if (*value == '-')
+    {
+        value++;
+        if (!HttpServer_parseNumber(&value,&message->rangeFirst))
+            return;
+        flags |= HTTPSERVER_RANGEFLAGS_SUFFIX;
+    }
+    else
+    {
+        if (!HttpServer_parseNumber(&value,&message->rangeFirst) || (*value++ != '-'))
+            return;
+
+        if (HttpServer_parseNumber(&value,&message->rangeLast))
+        {
+            if (message->rangeLast < message->rangeFirst)
+                return;
+        }
+        else
+        {
+            flags |= HTTPSERVER_RANGEFLAGS_OPEN;
+        }
+    }
+
+    // Only a single range is served
+    while (*value == ' ') value++;
+    if (*value != '\0')
+        return;
+
+    message->rangeFlags |= flags;
+}
+
+void HttpServer_parseIfRange (HttpServer_MessageHandle message, const char* value)
+{
+    uint16_t length;
+
+    while (*value == ' ') value++;
+    length = strlen(value);
+    while ((length > 0) && (value[length-1] == ' ')) length--;
+
+    message->rangeFlags |= HTTPSERVER_RANGEFLAGS_IF;
+    // A truncated validator must not match
+    if (length > HTTPSERVER_RANGE_VALIDATOR_LENGTH)
+        length = 0;
+    memcpy(message->ifRange,value,length);
+    message->ifRange[length] = '\0';
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function checks the If-Range condition: the range is served only if
+ * the client copy is the current one. The strong comparison is used, so a
+ * weak entity tag never matches.
+ */
+static bool HttpServer_rangeValid (HttpServer_MessageHandle message,
+                                   const char* validator)
+{
+    if ((message->rangeFlags & HTTPSERVER_RANGEFLAGS_IF) == 0)
+        return true;
+
+    return (validator != NULL) &&
+           (strncmp(validator,"W/",2) != 0) &&
+           (message->ifRange[0] != '\0') &&
+           (strcmp(message->ifRange,validator) == 0);
+}
+
+void HttpServer_sendResource (HttpServer_DeviceHandle dev,
+                              const char* headers,
+                              const HttpServer_Resource* resource,
+                              uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_MessageHandle m = &c->message;
+    HttpServer_ResponseCode code = HTTPSERVER_RESPONSECODE_OK;
+    uint32_t first = 0;
+    uint32_t last = resource->length - 1;
+    uint32_t count = resource->length;
+    char number[HTTPSERVER_INTEGER_MAX_LENGTH];
+
+    if ((m->rangeFlags & HTTPSERVER_RANGEFLAGS_PRESENT) &&
+        HttpServer_rangeValid(m,resource->validator))
+    {
+        if (m->rangeFlags & HTTPSERVER_RANGEFLAGS_SUFFIX)
+        {
+            first = (resource->length > m->rangeFirst) ? (resource->length - m->rangeFirst) : 0;
+            // bytes=-0 can't be satisfied
+            if (m->rangeFirst == 0)
+                first = resource->length;
+        }
+        else
+        {
+            first = m->rangeFirst;
+            if (((m->rangeFlags & HTTPSERVER_RANGEFLAGS_OPEN) == 0) && (m->rangeLast < last))
+                last = m->rangeLast;
+        }
+
+        if (first >= resource->length)
+        {
+            static const char unsatisfiable[] =
+                    "\r\nContent-Length: 0\r\nServer: " HTTPSERVER_SERVER_NAME "\r\n\r\n";
+
+            HttpServer_txStatus(dev,HTTPSERVER_RESPONSECODE_REQUESTEDRANGENOTSATISFIABLE,client);
+            HttpServer_txAppend(dev,client,"Content-Range: bytes */",23);
+            HttpServer_txAppend(dev,client,number,HttpServer_formatInteger(number,resource->length));
+            HttpServer_txAppend(dev,client,unsatisfiable,sizeof(unsatisfiable) - 1);
+            c->sourceRemaining = 0;
+            c->txFlags = HTTPSERVER_TXFLAGS_END;
+            return;
+        }
+
+        code = HTTPSERVER_RESPONSECODE_PARTIALCONTENT;
+        count = last - first + 1;
+    }
+
+    HttpServer_txStatus(dev,code,client);
+    if (headers[0] != '\0')
+    {
+        HttpServer_txAppend(dev,client,headers,strlen(headers));
+        HttpServer_txAppend(dev,client,"\r\n",2);
+    }
+    HttpServer_txAppend(dev,client,"Accept-Ranges: bytes\r\n",22);
+    if (code == HTTPSERVER_RESPONSECODE_PARTIALCONTENT)
+    {
+        HttpServer_txAppend(dev,client,"Content-Range: bytes ",21);
+        HttpServer_txAppend(dev,client,number,HttpServer_formatInteger(number,first));
+        HttpServer_txAppend(dev,client,"-",1);
+        HttpServer_txAppend(dev,client,number,HttpServer_formatInteger(number,last));
+        HttpServer_txAppend(dev,client,"/",1);
+        HttpServer_txAppend(dev,client,number,HttpServer_formatInteger(number,resource->length));
+        HttpServer_txAppend(dev,client,"\r\n",2);
+    }
+    HttpServer_txAppend(dev,client,"Content-Length: ",16);
+    HttpServer_txAppend(dev,client,number,HttpServer_formatInteger(number,count));
+    HttpServer_txAppend(dev,client,"\r\n\r\n",4);
+
+    // The body is read by HttpServer_poll as the transmission buffer is
+    // freed, see HttpServer_sourceFill
+    c->sourceRead = resource->read;
+    c->sourceContext = resource->context;
+    c->sourceOffset = first;
+    c->sourceRemaining = (m->request == HTTPSERVER_REQUEST_HEAD) ? 0 : count;
+    c->txFlags = (c->sourceRemaining == 0) ? HTTPSERVER_TXFLAGS_END : 0;
+}
+
+bool HttpServer_sourceFill (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    uint16_t size = HTTPSERVER_TX_BUFFER_DIMENSION - c->txLength;
+    uint16_t read;
+
+    if (size == 0)
+        return true;
+    if (size > c->sourceRemaining)
+        size = c->sourceRemaining;
+
+    read = c->sourceRead(c->sourceContext,
+                         c->sourceOffset,
+                         &c->txBuffer[c->txLength],
+                         size);
+
+    // The announced length can't be sent anymore: the client sees the
+    // connection closed before the end of the body
+    if ((read == 0) || (read > size))
+    {
+        HttpServer_closeClient(dev,client);
+        return false;
+    }
+
+    c->txLength += read;
+    c->sourceOffset += read;
+    c->sourceRemaining -= read;
+    if (c->sourceRemaining == 0)
+        c->txFlags |= HTTPSERVER_TXFLAGS_END;
+    return true;
+}
+
+#endif // HTTPSERVER_RANGE
@@ -0,0 +1,235 @@
+/*
+ * A simple HTTP/SERVER library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Rate limit of each peer address. The token buckets are kept in a small
+ * open addressing table: an address is stored in one of the
+ * HTTPSERVER_RATELIMIT_PROBES entries following its hash, and when they are
+ * all taken the entry used least recently is given to the new address.
+ * A bucket is a single tick, the time when it is full again, so refilling
+ * it costs nothing and an entry whose buckets are full is as good as free.
+ */
+
+#include "http-server.h"
+#include "http-server-internal.h"
+
+#if (HTTPSERVER_RATELIMIT == 1)
+
+#if ((HTTPSERVER_RATELIMIT_ENTRIES & (HTTPSERVER_RATELIMIT_ENTRIES - 1)) != 0)
+#error "HTTPSERVER_RATELIMIT_ENTRIES must be a power of two"
+#endif
+#if (HTTPSERVER_RATELIMIT_PROBES == 0) || (HTTPSERVER_RATELIMIT_PROBES > HTTPSERVER_RATELIMIT_ENTRIES)
+#error "HTTPSERVER_RATELIMIT_PROBES must be between 1 and HTTPSERVER_RATELIMIT_ENTRIES"
+#endif
+#if (HTTPSERVER_RATELIMIT_CONNECTION_BURST == 0) || (HTTPSERVER_RATELIMIT_REQUEST_BURST == 0)
+#error "HTTPSERVER_RATELIMIT_CONNECTION_BURST and HTTPSERVER_RATELIMIT_REQUEST_BURST must not be 0"
+#endif
+
+/**
+ * @ingroup httpServer_functions
+ * The response sent, without parsing the request, to the limited clients.
+ */
+static const char HttpServer_rateLimitResponse[] =
+        HTTPSERVER_STRING_VERSION_1_1 " 429 Too Many Requests\r\n"
+        "Retry-After: " HTTPSERVER_RATELIMIT_RETRY_AFTER "\r\n"
+        "Content-Length: 0\r\n"
+        "Connection: close\r\n"
+        "Server: " HTTPSERVER_SERVER_NAME "\r\n\r\n";
+
+/**
+ * @ingroup httpServer_functions
+ * This function returns the ticks since both the buckets of an entry are
+ * full, negative when a bucket is still refilling.
+ */
+static inline int32_t HttpServer_rateLimitIdle (const HttpServer_RateLimit* entry,
+                                                uint32_t now)
+{
+    int32_t connection = (int32_t)(now - entry->connectionTick);
+    int32_t request = (int32_t)(now - entry->requestTick);
+
+    return (connection < request) ? connection : request;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function returns the entry of an address, a new one with full
+ * buckets when the address isn't tracked.
+ */
+static HttpServer_RateLimit* HttpServer_rateLimitEntry (HttpServer_DeviceHandle dev,
+                                                        uint32_t address,
+                                                        uint32_t now)
+{
+    // Fibonacci hashing spreads the addresses of the same subnet
+    uint16_t index = (uint16_t)((address * 2654435761u) >> 16);
+    HttpServer_RateLimit* entry;
+    HttpServer_RateLimit* victim = NULL;
+    int32_t victimIdle = 0;
+    int32_t idle;
+
+    for (uint8_t i = 0; i < HTTPSERVER_RATELIMIT_PROBES; ++i)
+    {
+        entry = &dev->rateLimit[(index + i) & (HTTPSERVER_RATELIMIT_ENTRIES - 1)];
+        if (entry->address == address)
+            return entry;
+
+        idle = (entry->address == 0) ? INT32_MAX : HttpServer_rateLimitIdle(entry,now);
+        if ((victim == NULL) || (idle > victimIdle))
+        {
+            victim = entry;
+            victimIdle = idle;
+        }
+    }
+
+    victim->address = address;
+    victim->connectionTick = now;
+    victim->requestTick = now;
+    return victim;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function takes a token from a bucket.
+ *@param[in,out] bucket The tick when the bucket is full
+ *@param ticks The ticks to earn a token
+ *@param burst The bucket capacity
+ *@return false when the bucket is empty
+ */
+static bool HttpServer_rateLimitTake (uint32_t* bucket,
+                                      uint32_t now,
+                                      uint32_t ticks,
+                                      uint32_t burst)
+{
+    if ((int32_t)(*bucket - now) < 0)
+        *bucket = now;
+
+    if ((*bucket - now) > (ticks * (burst - 1)))
+        return false;
+
+    *bucket += ticks;
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function counts the refused client and its 429 response.
+ */
+static void HttpServer_rateLimited (HttpServer_DeviceHandle dev,
+                                    uint8_t client,
+                                    HttpServer_RateLimitReason reason)
+{
+#if (HTTPSERVER_TRACE_ENABLE == 0)
+    (void)client;
+    (void)reason;
+#if (HTTPSERVER_METRICS == 0)
+    (void)dev;
+#endif
+#endif
+    HTTPSERVER_METRICS_INC(dev,rateLimited);
+    HTTPSERVER_METRICS_INC(dev,responses['4' - '1']);
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_RATELIMITED,client,reason,dev->clients[client].address);
+}
+
+bool HttpServer_rateLimitConnection (HttpServer_DeviceHandle dev,
+                                     uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_RateLimit* entry;
+    HttpServer_RateLimitReason reason;
+    uint8_t clients = 0;
+    uint16_t wrote = 0;
+
+    c->address = (dev->addressCallback != 0) ? dev->addressCallback(dev->appDevice,client) : 0;
+    if (c->address == 0)
+        return true;
+
+    for (uint8_t i = 0; i < ETHERNET_MAX_LISTEN_CLIENT; ++i)
+    {
+        if ((dev->clients[i].state != HTTPSERVER_CLIENTSTATE_IDLE) &&
+            (dev->clients[i].address == c->address))
+        {
+            clients++;
+        }
+    }
+
+    entry = HttpServer_rateLimitEntry(dev,c->address,HttpServer_currentTick());
+    if (clients >= HTTPSERVER_RATELIMIT_CLIENTS)
+    {
+        reason = HTTPSERVER_RATELIMIT_REASON_CLIENTS;
+    }
+    else if (!HttpServer_rateLimitTake(&entry->connectionTick,
+                                       HttpServer_currentTick(),
+                                       HTTPSERVER_RATELIMIT_CONNECTION_TICKS,
+                                       HTTPSERVER_RATELIMIT_CONNECTION_BURST))
+    {
+        reason = HTTPSERVER_RATELIMIT_REASON_CONNECTIONS;
+    }
+    else
+    {
+        return true;
+    }
+
+    HttpServer_rateLimited(dev,client,reason);
+    EthernetServerSocket_writeBytes(dev->socketNumber,
+                                    client,
+                                    (uint8_t*)HttpServer_rateLimitResponse,
+                                    sizeof(HttpServer_rateLimitResponse) - 1,
+                                    &wrote);
+    EthernetServerSocket_disconnectClient(dev->socketNumber,client);
+    return false;
+}
+
+bool HttpServer_rateLimitRequest (HttpServer_DeviceHandle dev,
+                                  uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_RateLimit* entry;
+
+    if (c->address == 0)
+        return true;
+
+    entry = HttpServer_rateLimitEntry(dev,c->address,HttpServer_currentTick());
+    if (HttpServer_rateLimitTake(&entry->requestTick,
+                                 HttpServer_currentTick(),
+                                 HTTPSERVER_RATELIMIT_REQUEST_TICKS,
+                                 HTTPSERVER_RATELIMIT_REQUEST_BURST))
+    {
+        return true;
+    }
+
+    HttpServer_rateLimited(dev,client,HTTPSERVER_RATELIMIT_REASON_REQUESTS);
+    // Sent after the end of a previous response, if any
+    HttpServer_txAppend(dev,
+                        client,
+                        HttpServer_rateLimitResponse,
+                        sizeof(HttpServer_rateLimitResponse) - 1);
+    c->state = HTTPSERVER_CLIENTSTATE_RESPONSE;
+    c->txFlags = HTTPSERVER_TXFLAGS_END;
+    c->lastTick = HttpServer_currentTick();
+    return false;
+}
+
+#endif // HTTPSERVER_RATELIMIT
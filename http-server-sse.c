@@ -0,0 +1,279 @@
+/*
+ * A simple HTTP/SERVER library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Server-Sent Events: the subscribed connections stay open and receive the
+ * events published by the application. Each event is formatted only once
+ * into a shared ring buffer, every subscriber sends it from there keeping
+ * its own position, so the cost of an event doesn't depend on the number
+ * of subscribers.
+ */
+
+#include "http-server.h"
+#include "http-server-internal.h"
+
+#if (HTTPSERVER_SSE == 1)
+
+#if ((HTTPSERVER_SSE_BUFFER_DIMENSION & (HTTPSERVER_SSE_BUFFER_DIMENSION - 1)) != 0)
+#error "HTTPSERVER_SSE_BUFFER_DIMENSION must be a power of two"
+#endif
+
+///Channels mask and length which precede every event record
+#define HTTPSERVER_SSE_RECORD_HEADER      3
+
+#define HTTPSERVER_SSE_INDEX(position)    ((position) & (HTTPSERVER_SSE_BUFFER_DIMENSION - 1))
+
+/**
+ * @ingroup httpServer_functions
+ * This function copies data at the head of the ring buffer.
+ */
+static void HttpServer_sseWrite (HttpServer_DeviceHandle dev,
+                                 const void* data,
+                                 uint16_t length)
+{
+    const uint8_t* bytes = data;
+
+    for (uint16_t i = 0; i < length; ++i)
+        dev->sse.buffer[HTTPSERVER_SSE_INDEX(dev->sse.head++)] = bytes[i];
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function writes the record header and updates the heartbeat time.
+ */
+static void HttpServer_sseRecord (HttpServer_DeviceHandle dev,
+                                  uint8_t channels,
+                                  uint16_t length)
+{
+    uint8_t header[HTTPSERVER_SSE_RECORD_HEADER] =
+    {
+        channels,
+        length >> 8,
+        length & 0xFF,
+    };
+
+    HttpServer_sseWrite(dev,header,HTTPSERVER_SSE_RECORD_HEADER);
+    dev->sse.lastTick = HttpServer_currentTick();
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_SSE_EVENT,0,channels,length);
+}
+
+void HttpServer_sseStart (HttpServer_DeviceHandle dev,
+                          uint8_t channels,
+                          uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    static const char headers[] =
+            "Content-Type: text/event-stream\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Connection: close\r\n"
+            "Server: " HTTPSERVER_SERVER_NAME "\r\n\r\n";
+
+#if (HTTPSERVER_HTTP2 == 1)
+    // A stream can't take the connection
+    if (dev->http2.client == client)
+    {
+        HttpServer_http2Refuse(dev,client);
+        return;
+    }
+#endif
+
+    HttpServer_txStatus(dev,HTTPSERVER_RESPONSECODE_OK,client);
+    HttpServer_txAppend(dev,client,headers,sizeof(headers) - 1);
+
+    // Only the events published from now on are sent
+    c->sseOffset = dev->sse.head;
+    c->sseSent = 0;
+    c->sseChannels = channels;
+    c->state = HTTPSERVER_CLIENTSTATE_SSE;
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_SSE_START,client,channels,0);
+}
+
+HttpServer_Error HttpServer_sseSend (HttpServer_DeviceHandle dev,
+                                     uint8_t channels,
+                                     const char* event,
+                                     const char* data)
+{
+    uint32_t length = 1;
+    const char* line;
+    const char* end;
+
+    // Measure the event: the name field, a data field for each line and
+    // the empty line
+    if (event != NULL)
+        length += 8 + strlen(event);
+    line = data;
+    do
+    {
+        end = strchr(line,'\n');
+        if (end == NULL)
+            end = line + strlen(line);
+        length += 7 + (end - line);
+        line = end + 1;
+    } while (*end != '\0');
+
+    if ((length + HTTPSERVER_SSE_RECORD_HEADER) > HTTPSERVER_SSE_BUFFER_DIMENSION)
+        return HTTPSERVER_ERROR_WRONG_PARAM;
+
+    HttpServer_sseRecord(dev,channels,length);
+    if (event != NULL)
+    {
+        HttpServer_sseWrite(dev,"event: ",7);
+        HttpServer_sseWrite(dev,event,strlen(event));
+        HttpServer_sseWrite(dev,"\n",1);
+    }
+    line = data;
+    do
+    {
+        end = strchr(line,'\n');
+        if (end == NULL)
+            end = line + strlen(line);
+        HttpServer_sseWrite(dev,"data: ",6);
+        HttpServer_sseWrite(dev,line,end - line);
+        HttpServer_sseWrite(dev,"\n",1);
+        line = end + 1;
+    } while (*end != '\0');
+    HttpServer_sseWrite(dev,"\n",1);
+
+    return HTTPSERVER_ERROR_OK;
+}
+
+void HttpServer_sseClose (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+
+    if (c->state != HTTPSERVER_CLIENTSTATE_SSE)
+        return;
+
+    // The connection is closed when the staged bytes are sent
+    c->state = HTTPSERVER_CLIENTSTATE_RESPONSE;
+    c->txFlags = HTTPSERVER_TXFLAGS_END;
+}
+
+void HttpServer_sseHeartbeat (HttpServer_DeviceHandle dev)
+{
+    if ((uint32_t)(HttpServer_currentTick() - dev->sse.lastTick) < HTTPSERVER_SSE_HEARTBEAT)
+        return;
+
+    for (uint8_t i = 0; i < ETHERNET_MAX_LISTEN_CLIENT; i++)
+    {
+        if (dev->clients[i].state == HTTPSERVER_CLIENTSTATE_SSE)
+        {
+            // A comment line is ignored by the clients
+            HttpServer_sseRecord(dev,HTTPSERVER_SSE_CHANNEL_ALL,3);
+            HttpServer_sseWrite(dev,":\n\n",3);
+            return;
+        }
+    }
+    dev->sse.lastTick = HttpServer_currentTick();
+}
+
+void HttpServer_sseService (HttpServer_DeviceHandle dev,
+                            uint8_t client,
+                            uint16_t budget)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    uint32_t now = HttpServer_currentTick();
+    int16_t available = 0;
+    uint16_t length, size, first;
+    uint16_t wrote = 0;
+    uint8_t data;
+
+    // Nothing is expected from the subscriber
+    EthernetServerSocket_available(dev->socketNumber,client,&available);
+    for (; (available > 0) && (budget > 0); available--, budget--)
+        EthernetServerSocket_read(dev->socketNumber,client,&data);
+
+    // The response headers are sent first
+    if (c->txLength > 0)
+    {
+        if (HttpServer_txDrain(dev,client,budget) > 0)
+            c->lastTick = now;
+        else if ((uint32_t)(now - c->lastTick) >= HTTPSERVER_TIMEOUT)
+            HttpServer_closeClient(dev,client);
+        return;
+    }
+
+    // The oldest pending records are overwritten
+    if ((uint32_t)(dev->sse.head - c->sseOffset) > HTTPSERVER_SSE_BUFFER_DIMENSION)
+    {
+        HTTPSERVER_TRACE(HTTPSERVER_TRACE_SSE_OVERRUN,client,dev->sse.head - c->sseOffset,0);
+        HttpServer_closeClient(dev,client);
+        return;
+    }
+
+    if (c->sseOffset == dev->sse.head)
+    {
+        c->lastTick = now;
+        return;
+    }
+
+    while ((c->sseOffset != dev->sse.head) && (budget > 0))
+    {
+        length = ((uint16_t)dev->sse.buffer[HTTPSERVER_SSE_INDEX(c->sseOffset + 1)] << 8) |
+                 dev->sse.buffer[HTTPSERVER_SSE_INDEX(c->sseOffset + 2)];
+
+        if ((dev->sse.buffer[HTTPSERVER_SSE_INDEX(c->sseOffset)] & c->sseChannels) != 0)
+        {
+            // Send the record text up to the end of the ring buffer
+            size = length - c->sseSent;
+            first = HTTPSERVER_SSE_BUFFER_DIMENSION -
+                    HTTPSERVER_SSE_INDEX(c->sseOffset + HTTPSERVER_SSE_RECORD_HEADER + c->sseSent);
+            if (size > first)
+                size = first;
+            if (size > budget)
+                size = budget;
+
+            wrote = 0;
+            EthernetServerSocket_writeBytes(dev->socketNumber,
+                                            client,
+                                            &dev->sse.buffer[HTTPSERVER_SSE_INDEX(c->sseOffset + HTTPSERVER_SSE_RECORD_HEADER + c->sseSent)],
+                                            size,
+                                            &wrote);
+            HTTPSERVER_METRICS_ADD(dev,bytesOut,wrote);
+            c->sseSent += wrote;
+            budget -= wrote;
+            if (wrote > 0)
+                c->lastTick = now;
+            if (wrote < size)
+                break;
+            // Wrapped record: send the rest from the begin of the buffer
+            if (c->sseSent < length)
+                continue;
+        }
+
+        c->sseOffset += HTTPSERVER_SSE_RECORD_HEADER + length;
+        c->sseSent = 0;
+    }
+
+    if ((uint32_t)(now - c->lastTick) >= HTTPSERVER_TIMEOUT)
+    {
+        HTTPSERVER_METRICS_INC(dev,timeouts);
+        HttpServer_closeClient(dev,client);
+    }
+}
+
+#endif // HTTPSERVER_SSE
@@ -0,0 +1,187 @@
+/*
+ * A simple HTTP/SERVER library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "http-server.h"
+#include "http-server-internal.h"
+
+#if (HTTPSERVER_TRACE_ENABLE == 1)
+
+#if ((HTTPSERVER_TRACE_DIMENSION & (HTTPSERVER_TRACE_DIMENSION - 1)) != 0)
+#error "HTTPSERVER_TRACE_DIMENSION must be a power of two"
+#endif
+
+HttpServer_TraceRecord HttpServer_traceBuffer[HTTPSERVER_TRACE_DIMENSION];
+uint32_t HttpServer_traceHead = 0;
+
+static const char* const HttpServer_traceEventName[HTTPSERVER_TRACE_EVENT_NUMBER] =
+{
+    "OPEN",
+    "OPEN_FAIL",
+    "CONNECT",
+    "REFUSED",
+    "DISCONNECT",
+    "CLOSE",
+    "REQUEST",
+    "PARSE_ERROR",
+    "LINE_TOO_LONG",
+    "HEADER_OVERFLOW",
+    "HANDLER",
+    "RESPONSE",
+    "SENT",
+    "TIMEOUT",
+    "WEBSOCKET_OPEN",
+    "WEBSOCKET_FRAME",
+    "WEBSOCKET_CLOSE",
+    "SSE_START",
+    "SSE_EVENT",
+    "SSE_OVERRUN",
+    "UPLOAD_START",
+    "UPLOAD_BUSY",
+    "UPLOAD_END",
+    "KEEPALIVE",
+    "RATELIMITED",
+    "HTTP2_OPEN",
+    "HTTP2_STREAM",
+    "HTTP2_RESET",
+    "HTTP2_GOAWAY",
+};
+
+/**
+ * @ingroup httpServer_functions
+ * Max length of a decoded trace line, end string character included.
+ */
+#define HTTPSERVER_TRACE_LINE_LENGTH    64
+
+#if (HTTPSERVER_TRACE_LINE_LENGTH >= HTTPSERVER_GENERATOR_LINE_LENGTH)
+#error "A trace line and its end of line must fit HTTPSERVER_GENERATOR_LINE_LENGTH"
+#endif
+
+/**
+ * @ingroup httpServer_functions
+ * This function decodes a trace record as a line of text: tick, client,
+ * event name and the two arguments.
+ *@param[in] record The record to decode
+ *@param[out] line The buffer of @ref HTTPSERVER_TRACE_LINE_LENGTH characters
+ *@return The length of the line, end string character excluded
+ */
+static uint8_t HttpServer_traceFormat (const HttpServer_TraceRecord* record,
+                                       char* line)
+{
+    uint8_t length;
+    const char* name = "?";
+
+    if (record->event < HTTPSERVER_TRACE_EVENT_NUMBER)
+        name = HttpServer_traceEventName[record->event];
+
+    length = HttpServer_formatInteger(line,record->tick);
+    line[length++] = ' ';
+    line[length++] = '#';
+    length += HttpServer_formatInteger(&line[length],record->client);
+    line[length++] = ' ';
+    strcpy(&line[length],name);
+    length += strlen(name);
+    line[length++] = ' ';
+    length += HttpServer_formatInteger(&line[length],record->arg0);
+    line[length++] = ' ';
+    length += HttpServer_formatInteger(&line[length],record->arg1);
+    line[length] = '\0';
+
+    return length;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function returns the index of the oldest record still stored.
+ */
+static uint32_t HttpServer_traceTail (void)
+{
+    if (HttpServer_traceHead > HTTPSERVER_TRACE_DIMENSION)
+        return HttpServer_traceHead - HTTPSERVER_TRACE_DIMENSION;
+    return 0;
+}
+
+void HttpServer_traceDump (void (*print)(const char* line))
+{
+    char line[HTTPSERVER_TRACE_LINE_LENGTH];
+    uint32_t head = HttpServer_traceHead;
+
+    for (uint32_t i = HttpServer_traceTail(); i != head; ++i)
+    {
+        HttpServer_traceFormat(&HttpServer_traceBuffer[i & (HTTPSERVER_TRACE_DIMENSION - 1)],
+                               line);
+        print(line);
+    }
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function writes the line of a record, see @ref HttpServer_Generator .
+ * The records overwritten while the trace is sent are skipped.
+ */
+static uint8_t HttpServer_traceLine (HttpServer_DeviceHandle dev,
+                                     uint8_t client,
+                                     char* line)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    uint32_t tail = HttpServer_traceTail();
+    uint8_t length;
+
+    if ((int32_t)(tail - c->generatorStep) > 0)
+    {
+        if ((int32_t)(tail - c->generatorEnd) >= 0)
+            return 0;
+        c->generatorStep = tail;
+    }
+
+    length = HttpServer_traceFormat(&HttpServer_traceBuffer[c->generatorStep & (HTTPSERVER_TRACE_DIMENSION - 1)],
+                                    line);
+    line[length++] = '\n';
+    return length;
+}
+
+void HttpServer_sendTrace (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    // The response itself is traced: stop at the current head
+    uint32_t head = HttpServer_traceHead;
+
+    // The body length is not known in advance: the end of the body is
+    // marked by the connection close
+    HttpServer_sendResponse(dev,
+                            HTTPSERVER_RESPONSECODE_OK,
+                            "Content-Type: text/plain\r\n"
+                            "Connection: close\r\nServer: " HTTPSERVER_SERVER_NAME,
+                            "",
+                            client);
+    HttpServer_txGenerate(dev,client,HttpServer_traceLine,HttpServer_traceTail(),head);
+}
+
+void HttpServer_traceClear (void)
+{
+    HttpServer_traceHead = 0;
+}
+
+#endif // HTTPSERVER_TRACE_ENABLE
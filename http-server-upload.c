@@ -0,0 +1,233 @@
+/*
+ * A simple HTTP/SERVER library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Request body upload into an application sink (for example a firmware
+ * image written into the flash). The body is never buffered by the server
+ * besides the sink block: when the sink is busy the socket isn't read, so
+ * the TCP window closes and the client waits.
+ */
+
+#include "http-server.h"
+#include "http-server-internal.h"
+
+#if (HTTPSERVER_UPLOAD == 1)
+
+HttpServer_Error HttpServer_startUpload (HttpServer_DeviceHandle dev,
+                                         const HttpServer_Sink* sink,
+                                         uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+
+    if ((sink->buffer == NULL) || (sink->blockSize == 0) ||
+        (sink->write == 0) || (sink->finish == 0))
+    {
+        return HTTPSERVER_ERROR_WRONG_PARAM;
+    }
+
+#if (HTTPSERVER_HTTP2 == 1)
+    // The request bodies of HTTP/2 are not received
+    if (dev->http2.client == client)
+    {
+        HttpServer_http2Refuse(dev,client);
+        return HTTPSERVER_ERROR_OK;
+    }
+#endif
+
+    // The chunked bodies are not decoded, also when a length is given
+    if ((c->message.flags & (HTTPSERVER_MESSAGEFLAGS_CONTENT_LENGTH |
+                             HTTPSERVER_MESSAGEFLAGS_TRANSFER_ENCODING)) !=
+        HTTPSERVER_MESSAGEFLAGS_CONTENT_LENGTH)
+    {
+        HttpServer_sendResponse(dev,
+                                HTTPSERVER_RESPONSECODE_LENGTHREQUIRED,
+                                "Content-Length: 0\r\nServer: " HTTPSERVER_SERVER_NAME,
+                                "",
+                                client);
+        return HTTPSERVER_ERROR_OK;
+    }
+
+    // The client waits for the interim response before sending the body
+    if (c->message.flags & HTTPSERVER_MESSAGEFLAGS_EXPECT_CONTINUE)
+        HttpServer_txAppend(dev,client,"HTTP/1.1 100 Continue\r\n\r\n",25);
+
+    c->sink = sink;
+    c->uploadOffset = 0;
+    c->uploadRemaining = c->message.contentLength;
+    c->uploadCrc = 0;
+    c->uploadBlock = 0;
+    c->uploadBusy = false;
+    c->lastTick = HttpServer_currentTick();
+    c->state = HTTPSERVER_CLIENTSTATE_UPLOAD;
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_UPLOAD_START,client,sink->blockSize,0);
+    return HTTPSERVER_ERROR_OK;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function stages the final response of the upload.
+ */
+static void HttpServer_uploadFinish (HttpServer_DeviceHandle dev,
+                                     uint8_t client,
+                                     HttpServer_ResponseCode code)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    static const char hex[] = "0123456789abcdef";
+    static const char server[] = "\r\nServer: " HTTPSERVER_SERVER_NAME "\r\n\r\n";
+    char body[48];
+    char number[HTTPSERVER_INTEGER_MAX_LENGTH];
+    uint8_t length = 0;
+
+    // {"length":N,"crc32":"xxxxxxxx"}
+    memcpy(&body[length],"{\"length\":",10);
+    length += 10;
+    length += HttpServer_formatInteger(&body[length],c->uploadOffset);
+    memcpy(&body[length],",\"crc32\":\"",10);
+    length += 10;
+    for (int8_t shift = 28; shift >= 0; shift -= 4)
+        body[length++] = hex[(c->uploadCrc >> shift) & 0x0F];
+    memcpy(&body[length],"\"}",2);
+    length += 2;
+
+    HttpServer_txStatus(dev,code,client);
+    HttpServer_txAppend(dev,client,"Content-Type: application/json\r\nContent-Length: ",48);
+    HttpServer_txAppend(dev,client,number,HttpServer_formatInteger(number,length));
+    HttpServer_txAppend(dev,client,server,sizeof(server) - 1);
+    HttpServer_txAppend(dev,client,body,length);
+    c->txFlags = HTTPSERVER_TXFLAGS_END;
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_UPLOAD_END,client,code,1);
+}
+
+void HttpServer_uploadAbort (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+
+    c->sink->finish(c->sink->context,c->uploadOffset + c->uploadBlock,c->uploadCrc,false);
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_UPLOAD_END,client,0,0);
+}
+
+void HttpServer_uploadService (HttpServer_DeviceHandle dev,
+                               uint8_t client,
+                               uint16_t budget)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    const HttpServer_Sink* sink = c->sink;
+    HttpServer_SinkStatus status;
+    int16_t available = 0;
+    uint16_t size;
+
+    // Send the interim response
+    if (c->txLength > 0)
+        HttpServer_txDrain(dev,client,budget);
+
+    for (;;)
+    {
+        // Write the full block, or the last one
+        if ((c->uploadBlock == sink->blockSize) ||
+            ((c->uploadRemaining == 0) && (c->uploadBlock > 0)))
+        {
+            status = sink->write(sink->context,c->uploadOffset,sink->buffer,c->uploadBlock);
+
+            if (status == HTTPSERVER_SINK_BUSY)
+            {
+                // Back-pressure: the received data stay into the socket
+                // and the client doesn't time out, but a sink which stays
+                // busy doesn't hold the client forever
+                if (!c->uploadBusy)
+                {
+                    HTTPSERVER_TRACE(HTTPSERVER_TRACE_UPLOAD_BUSY,client,c->uploadOffset / sink->blockSize,0);
+                    c->uploadBusy = true;
+                    c->uploadBusyTick = HttpServer_currentTick();
+                }
+                else if ((uint32_t)(HttpServer_currentTick() - c->uploadBusyTick) >= HTTPSERVER_TIMEOUT)
+                {
+                    HTTPSERVER_METRICS_INC(dev,timeouts);
+                    HttpServer_uploadAbort(dev,client);
+                    HttpServer_sendResponse(dev,
+                                            HTTPSERVER_RESPONSECODE_SERVICEUNAVAILABLE,
+                                            "Content-Length: 0\r\nServer: " HTTPSERVER_SERVER_NAME,
+                                            "",
+                                            client);
+                    return;
+                }
+                c->lastTick = HttpServer_currentTick();
+                return;
+            }
+            c->uploadBusy = false;
+            if (status == HTTPSERVER_SINK_ERROR)
+            {
+                HttpServer_uploadAbort(dev,client);
+                HttpServer_sendResponse(dev,
+                                        HTTPSERVER_RESPONSECODE_INTERNALSERVERERROR,
+                                        "Content-Length: 0\r\nServer: " HTTPSERVER_SERVER_NAME,
+                                        "",
+                                        client);
+                return;
+            }
+            c->uploadOffset += c->uploadBlock;
+            c->uploadBlock = 0;
+        }
+
+        if (c->uploadRemaining == 0)
+        {
+            HttpServer_uploadFinish(dev,
+                                    client,
+                                    sink->finish(sink->context,c->uploadOffset,c->uploadCrc,true));
+            return;
+        }
+
+        EthernetServerSocket_available(dev->socketNumber,client,&available);
+        size = sink->blockSize - c->uploadBlock;
+        if (size > c->uploadRemaining)
+            size = c->uploadRemaining;
+        if (size > budget)
+            size = budget;
+        if (size > available)
+            size = available;
+        if (size == 0)
+            break;
+
+        for (uint16_t i = 0; i < size; ++i)
+            EthernetServerSocket_read(dev->socketNumber,client,&sink->buffer[c->uploadBlock + i]);
+
+        c->uploadCrc = HttpServer_crc32(c->uploadCrc,&sink->buffer[c->uploadBlock],size);
+        c->uploadBlock += size;
+        c->uploadRemaining -= size;
+        budget -= size;
+        c->lastTick = HttpServer_currentTick();
+        HTTPSERVER_METRICS_ADD(dev,bytesIn,size);
+    }
+
+    if ((uint32_t)(HttpServer_currentTick() - c->lastTick) >= HTTPSERVER_TIMEOUT)
+    {
+        HTTPSERVER_METRICS_INC(dev,timeouts);
+        HttpServer_uploadAbort(dev,client);
+        HttpServer_closeClient(dev,client);
+    }
+}
+
+#endif // HTTPSERVER_UPLOAD
@@ -0,0 +1,560 @@
+/*
+ * A simple HTTP/SERVER library
+ * Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@warcomeb.it>
+ *  Gianluca Calignano <g.calignano97@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * WebSocket (RFC 6455) support: opening handshake, framing of the upgraded
+ * connection and ping/pong keepalive. The upgraded connection keeps its
+ * @ref HttpServer_Client slot, the received payload is unmasked into the
+ * receive buffer and passed to the application in parts of at most
+ * HTTPSERVER_RX_BUFFER_DIMENSION bytes.
+ */
+
+#include "http-server.h"
+#include "http-server-internal.h"
+
+#if (HTTPSERVER_WEBSOCKET == 1)
+
+#if (HTTPSERVER_RX_BUFFER_DIMENSION < 125)
+#error "HTTPSERVER_RX_BUFFER_DIMENSION must hold a WebSocket control frame (125 bytes)"
+#endif
+
+#define HTTPSERVER_WEBSOCKET_OPCODE_CONTINUATION  0x00
+#define HTTPSERVER_WEBSOCKET_OPCODE_TEXT          0x01
+#define HTTPSERVER_WEBSOCKET_OPCODE_BINARY        0x02
+#define HTTPSERVER_WEBSOCKET_OPCODE_CLOSE         0x08
+#define HTTPSERVER_WEBSOCKET_OPCODE_PING          0x09
+#define HTTPSERVER_WEBSOCKET_OPCODE_PONG          0x0A
+
+#define HTTPSERVER_WEBSOCKET_STATUS_NORMAL        1000
+#define HTTPSERVER_WEBSOCKET_STATUS_PROTOCOL      1002
+#define HTTPSERVER_WEBSOCKET_STATUS_NONE          1005
+#define HTTPSERVER_WEBSOCKET_STATUS_ABNORMAL      1006
+
+///Max length of the Sec-WebSocket-Key header value
+#define HTTPSERVER_WEBSOCKET_KEY_MAX_LENGTH       60
+
+static const char HttpServer_wsGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+static const char HttpServer_base64Alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+ * @ingroup httpServer_functions
+ * This function processes a 64 bytes block of SHA-1.
+ */
+static void HttpServer_sha1Block (uint32_t hash[5], const uint8_t* block)
+{
+    uint32_t w[16];
+    uint32_t a = hash[0], b = hash[1], c = hash[2], d = hash[3], e = hash[4];
+    uint32_t f, k, tmp;
+
+    for (uint8_t t = 0; t < 16; ++t)
+    {
+        w[t] = ((uint32_t)block[4*t] << 24) | ((uint32_t)block[4*t+1] << 16) |
+               ((uint32_t)block[4*t+2] << 8) | block[4*t+3];
+    }
+
+    for (uint8_t t = 0; t < 80; ++t)
+    {
+        if (t >= 16)
+        {
+            tmp = w[(t-3) & 0x0F] ^ w[(t-8) & 0x0F] ^ w[(t-14) & 0x0F] ^ w[t & 0x0F];
+            w[t & 0x0F] = (tmp << 1) | (tmp >> 31);
+        }
+
+        if (t < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (t < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (t < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        tmp = ((a << 5) | (a >> 27)) + f + e + k + w[t & 0x0F];
+        e = d;
+        d = c;
+        c = (b << 30) | (b >> 2);
+        b = a;
+        a = tmp;
+    }
+
+    hash[0] += a;
+    hash[1] += b;
+    hash[2] += c;
+    hash[3] += d;
+    hash[4] += e;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function computes the Sec-WebSocket-Accept value: the base64 of the
+ * SHA-1 of the key concatenated with the WebSocket GUID.
+ *@param[in] key The Sec-WebSocket-Key value
+ *@param length The key length
+ *@param[out] accept The 28 characters of the result, end string included
+ */
+static void HttpServer_wsAcceptKey (const char* key, uint8_t length, char accept[29])
+{
+    uint32_t hash[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    uint8_t message[128];
+    uint8_t digest[20];
+    uint8_t total = length + sizeof(HttpServer_wsGuid) - 1;
+    uint8_t blocks = (total + 9 + 63) / 64;
+    uint32_t bits = (uint32_t)total * 8;
+
+    // Message, end bit and the length in bits at the end of the last block
+    memset(message,0,sizeof(message));
+    memcpy(message,key,length);
+    memcpy(&message[length],HttpServer_wsGuid,sizeof(HttpServer_wsGuid) - 1);
+    message[total] = 0x80;
+    for (uint8_t i = 0; i < 4; ++i)
+        message[blocks * 64 - 1 - i] = (bits >> (8 * i)) & 0xFF;
+
+    for (uint8_t i = 0; i < blocks; ++i)
+        HttpServer_sha1Block(hash,&message[64 * i]);
+
+    for (uint8_t i = 0; i < 20; ++i)
+        digest[i] = (hash[i / 4] >> (24 - 8 * (i % 4))) & 0xFF;
+
+    // 20 bytes are 6 groups of 3 bytes and a last group of 2 bytes
+    for (uint8_t i = 0, j = 0; i < 21; i += 3, j += 4)
+    {
+        uint32_t group = ((uint32_t)digest[i] << 16) | ((uint32_t)digest[i+1] << 8);
+        if (i < 18) group |= digest[i+2];
+
+        accept[j]   = HttpServer_base64Alphabet[(group >> 18) & 0x3F];
+        accept[j+1] = HttpServer_base64Alphabet[(group >> 12) & 0x3F];
+        accept[j+2] = HttpServer_base64Alphabet[(group >> 6) & 0x3F];
+        accept[j+3] = (i < 18) ? HttpServer_base64Alphabet[group & 0x3F] : '=';
+    }
+    accept[28] = '\0';
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function stages a frame.
+ */
+static void HttpServer_wsFrame (HttpServer_DeviceHandle dev,
+                                uint8_t client,
+                                uint8_t opcode,
+                                const uint8_t* data,
+                                uint16_t length)
+{
+    char header[4];
+    uint8_t headerLength = 2;
+
+    header[0] = 0x80 | opcode;
+    if (length < 126)
+    {
+        header[1] = length;
+    }
+    else
+    {
+        header[1] = 126;
+        header[2] = length >> 8;
+        header[3] = length & 0xFF;
+        headerLength = 4;
+    }
+
+    HttpServer_txAppend(dev,client,header,headerLength);
+    HttpServer_txAppend(dev,client,(const char*)data,length);
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function notifies the application that the connection is closed.
+ */
+static void HttpServer_wsNotifyClose (HttpServer_DeviceHandle dev,
+                                      uint8_t client,
+                                      const uint8_t* data,
+                                      uint16_t length)
+{
+    if (dev->websocketCallback != 0)
+    {
+        dev->websocketCallback(dev->appDevice,
+                               HTTPSERVER_WEBSOCKET_CLOSE,
+                               data,
+                               length,
+                               true,
+                               client);
+    }
+}
+
+bool HttpServer_wsUpgrade (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    static const char server[] = "\r\nServer: " HTTPSERVER_SERVER_NAME "\r\n\r\n";
+    const char* value;
+    uint8_t length = 0;
+    char accept[29];
+
+    // The upgrade must be a connection option too (RFC 6455 4.2.1)
+    if ((dev->websocketCallback == 0) ||
+        (c->message.request != HTTPSERVER_REQUEST_GET) ||
+        (c->message.version != HTTPSERVER_VERSION_1_1) ||
+        ((c->message.flags & HTTPSERVER_MESSAGEFLAGS_UPGRADE) == 0))
+    {
+        return false;
+    }
+
+    value = HttpServer_findHeader(c->message.header,"Upgrade");
+    if ((value == NULL) || !HttpServer_compareNoCase(value,"websocket",9))
+        return false;
+
+    value = HttpServer_findHeader(c->message.header,"Sec-WebSocket-Version");
+    if ((value == NULL) || (strncmp(value,"13",2) != 0))
+    {
+        HttpServer_sendResponse(dev,
+                                HTTPSERVER_RESPONSECODE_BADREQUEST,
+                                "Sec-WebSocket-Version: 13\r\n"
+                                "Content-Length: 0\r\nServer: " HTTPSERVER_SERVER_NAME,
+                                "",
+                                client);
+        return true;
+    }
+
+    value = HttpServer_findHeader(c->message.header,"Sec-WebSocket-Key");
+    if (value != NULL)
+    {
+        while ((value[length] > ' ') && (length < HTTPSERVER_WEBSOCKET_KEY_MAX_LENGTH))
+            length++;
+    }
+    if ((length == 0) || (length == HTTPSERVER_WEBSOCKET_KEY_MAX_LENGTH))
+    {
+        HttpServer_sendResponse(dev,
+                                HTTPSERVER_RESPONSECODE_BADREQUEST,
+                                "Content-Length: 0\r\nServer: " HTTPSERVER_SERVER_NAME,
+                                "",
+                                client);
+        return true;
+    }
+    HttpServer_wsAcceptKey(value,length,accept);
+
+    if (dev->websocketCallback(dev->appDevice,
+                               HTTPSERVER_WEBSOCKET_OPEN,
+                               (const uint8_t*)c->message.uri,
+                               strlen(c->message.uri),
+                               true,
+                               client) != HTTPSERVER_ERROR_OK)
+    {
+        HttpServer_sendResponse(dev,
+                                HTTPSERVER_RESPONSECODE_FORBIDDEN,
+                                "Content-Length: 0\r\nServer: " HTTPSERVER_SERVER_NAME,
+                                "",
+                                client);
+        return true;
+    }
+
+    HttpServer_txStatus(dev,HTTPSERVER_RESPONSECODE_SWITCHINGPROTOCOLS,client);
+    HttpServer_txAppend(dev,
+                        client,
+                        "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                        "Sec-WebSocket-Accept: ",
+                        63);
+    HttpServer_txAppend(dev,client,accept,28);
+    HttpServer_txAppend(dev,client,server,sizeof(server) - 1);
+
+    memset(&c->websocket,0,sizeof(c->websocket));
+    c->websocket.pingTick = HttpServer_currentTick();
+    c->rxIndex = 0;
+    c->state = HTTPSERVER_CLIENTSTATE_WEBSOCKET;
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_WEBSOCKET_OPEN,client,0,0);
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function returns the length of the frame header, once its first two
+ * bytes are known.
+ */
+static uint8_t HttpServer_wsHeaderLength (const HttpServer_WebSocket* ws)
+{
+    uint8_t length = 2;
+
+    if (ws->headerLength < 2)
+        return 2;
+
+    if ((ws->header[1] & 0x7F) == 126)
+        length += 2;
+    else if ((ws->header[1] & 0x7F) == 127)
+        length += 8;
+    if (ws->header[1] & 0x80)
+        length += 4;
+    return length;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function decodes the received frame header.
+ *@return false when the frame violates the protocol
+ */
+static bool HttpServer_wsParseHeader (HttpServer_WebSocket* ws)
+{
+    uint8_t length = ws->header[1] & 0x7F;
+    uint8_t index = 2;
+
+    ws->fin = (ws->header[0] & 0x80) != 0;
+    ws->opcode = ws->header[0] & 0x0F;
+
+    // The client frames MUST be masked
+    if ((ws->header[1] & 0x80) == 0)
+        return false;
+
+    if (length == 126)
+    {
+        ws->remaining = ((uint32_t)ws->header[2] << 8) | ws->header[3];
+        index = 4;
+    }
+    else if (length == 127)
+    {
+        // Payloads bigger than 4GB are not supported
+        if (ws->header[2] | ws->header[3] | ws->header[4] | ws->header[5])
+            return false;
+        ws->remaining = ((uint32_t)ws->header[6] << 24) | ((uint32_t)ws->header[7] << 16) |
+                        ((uint32_t)ws->header[8] << 8) | ws->header[9];
+        index = 10;
+    }
+    else
+    {
+        ws->remaining = length;
+    }
+    memcpy(ws->mask,&ws->header[index],4);
+    ws->maskIndex = 0;
+
+    if (ws->opcode & 0x08)
+    {
+        // Control frames can't be fragmented and have a short payload
+        return ws->fin && (ws->remaining <= 125) &&
+               (ws->opcode <= HTTPSERVER_WEBSOCKET_OPCODE_PONG);
+    }
+
+    if (ws->opcode == HTTPSERVER_WEBSOCKET_OPCODE_CONTINUATION)
+        return (ws->messageOpcode != 0);
+
+    if ((ws->opcode != HTTPSERVER_WEBSOCKET_OPCODE_TEXT) &&
+        (ws->opcode != HTTPSERVER_WEBSOCKET_OPCODE_BINARY))
+        return false;
+
+    // A new message can't start before the end of the previous one
+    if (ws->messageOpcode != 0)
+        return false;
+    ws->messageOpcode = ws->opcode;
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function manages a completely received control frame.
+ */
+static void HttpServer_wsControl (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+
+    switch (c->websocket.opcode)
+    {
+    case HTTPSERVER_WEBSOCKET_OPCODE_PING:
+        HttpServer_wsFrame(dev,
+                           client,
+                           HTTPSERVER_WEBSOCKET_OPCODE_PONG,
+                           c->rxBuffer,
+                           c->rxIndex);
+        break;
+    case HTTPSERVER_WEBSOCKET_OPCODE_CLOSE:
+        HTTPSERVER_TRACE(HTTPSERVER_TRACE_WEBSOCKET_CLOSE,
+                         client,
+                         (c->rxIndex >= 2) ?
+                             (((uint16_t)c->rxBuffer[0] << 8) | c->rxBuffer[1]) :
+                             HTTPSERVER_WEBSOCKET_STATUS_NONE,
+                         0);
+        HttpServer_wsNotifyClose(dev,client,c->rxBuffer,c->rxIndex);
+        // Echo the status and close the connection
+        HttpServer_wsFrame(dev,
+                           client,
+                           HTTPSERVER_WEBSOCKET_OPCODE_CLOSE,
+                           c->rxBuffer,
+                           (c->rxIndex >= 2) ? 2 : 0);
+        c->state = HTTPSERVER_CLIENTSTATE_RESPONSE;
+        c->txFlags = HTTPSERVER_TXFLAGS_END;
+        break;
+    default:
+        // Pong: the activity is already registered
+        break;
+    }
+}
+
+void HttpServer_wsService (HttpServer_DeviceHandle dev,
+                           uint8_t client,
+                           uint16_t budget)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    HttpServer_WebSocket* ws = &c->websocket;
+    int16_t available = 0;
+    uint32_t now;
+    uint8_t data;
+
+    if (HttpServer_txDrain(dev,client,budget) > 0)
+        budget = (budget > 1) ? (budget >> 1) : 1;
+
+    EthernetServerSocket_available(dev->socketNumber,client,&available);
+    if (available > budget)
+        available = budget;
+    HTTPSERVER_METRICS_ADD(dev,bytesIn,available);
+
+    while ((available > 0) && (c->state == HTTPSERVER_CLIENTSTATE_WEBSOCKET))
+    {
+        EthernetServerSocket_read(dev->socketNumber,client,&data);
+        available--;
+        c->lastTick = HttpServer_currentTick();
+
+        if (ws->headerLength < HttpServer_wsHeaderLength(ws))
+        {
+            ws->header[ws->headerLength++] = data;
+            if (ws->headerLength < HttpServer_wsHeaderLength(ws))
+                continue;
+
+            if (!HttpServer_wsParseHeader(ws))
+            {
+                HttpServer_wsClose(dev,HTTPSERVER_WEBSOCKET_STATUS_PROTOCOL,client);
+                HttpServer_wsNotifyClose(dev,client,NULL,0);
+                return;
+            }
+            HTTPSERVER_TRACE(HTTPSERVER_TRACE_WEBSOCKET_FRAME,client,ws->opcode,ws->remaining);
+            ws->pingTick = c->lastTick;
+            c->rxIndex = 0;
+        }
+        else
+        {
+            c->rxBuffer[c->rxIndex++] = data ^ ws->mask[ws->maskIndex];
+            ws->maskIndex = (ws->maskIndex + 1) & 0x03;
+            ws->remaining--;
+        }
+
+        if ((ws->opcode & 0x08) == 0)
+        {
+            // Data frame: pass the payload when the buffer is full or the
+            // frame is complete
+            if ((c->rxIndex == HTTPSERVER_RX_BUFFER_DIMENSION) ||
+                ((ws->remaining == 0) && ((c->rxIndex > 0) || ws->fin)))
+            {
+                bool last = (ws->remaining == 0) && ws->fin;
+
+                dev->websocketCallback(dev->appDevice,
+                                       (ws->messageOpcode == HTTPSERVER_WEBSOCKET_OPCODE_TEXT) ?
+                                           HTTPSERVER_WEBSOCKET_TEXT :
+                                           HTTPSERVER_WEBSOCKET_BINARY,
+                                       c->rxBuffer,
+                                       c->rxIndex,
+                                       last,
+                                       client);
+                c->rxIndex = 0;
+                if (last)
+                    ws->messageOpcode = 0;
+            }
+        }
+        else if (ws->remaining == 0)
+        {
+            HttpServer_wsControl(dev,client);
+        }
+
+        // Wait for the next frame header
+        if (ws->remaining == 0)
+            ws->headerLength = 0;
+    }
+
+    if (c->state != HTTPSERVER_CLIENTSTATE_WEBSOCKET)
+        return;
+
+    now = HttpServer_currentTick();
+    if ((uint32_t)(now - c->lastTick) >= HTTPSERVER_WEBSOCKET_TIMEOUT)
+    {
+        HTTPSERVER_METRICS_INC(dev,timeouts);
+        HTTPSERVER_TRACE(HTTPSERVER_TRACE_WEBSOCKET_CLOSE,client,HTTPSERVER_WEBSOCKET_STATUS_ABNORMAL,0);
+        HttpServer_wsNotifyClose(dev,client,NULL,0);
+        HttpServer_closeClient(dev,client);
+    }
+    else if ((uint32_t)(now - ws->pingTick) >= HTTPSERVER_WEBSOCKET_PING_PERIOD)
+    {
+        HttpServer_wsFrame(dev,client,HTTPSERVER_WEBSOCKET_OPCODE_PING,NULL,0);
+        ws->pingTick = now;
+    }
+}
+
+HttpServer_Error HttpServer_wsSend (HttpServer_DeviceHandle dev,
+                                    HttpServer_WebSocketEvent type,
+                                    const uint8_t* data,
+                                    uint16_t length,
+                                    uint8_t client)
+{
+    if (client >= ETHERNET_MAX_LISTEN_CLIENT)
+        return HTTPSERVER_ERROR_WRONG_CLIENT_NUMBER;
+    if (dev->clients[client].state != HTTPSERVER_CLIENTSTATE_WEBSOCKET)
+        return HTTPSERVER_ERROR_WRONG_PARAM;
+
+    HttpServer_wsFrame(dev,
+                       client,
+                       (type == HTTPSERVER_WEBSOCKET_TEXT) ?
+                           HTTPSERVER_WEBSOCKET_OPCODE_TEXT :
+                           HTTPSERVER_WEBSOCKET_OPCODE_BINARY,
+                       data,
+                       length);
+    return HTTPSERVER_ERROR_OK;
+}
+
+void HttpServer_wsClose (HttpServer_DeviceHandle dev,
+                         uint16_t status,
+                         uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    uint8_t payload[2];
+
+    if (c->state != HTTPSERVER_CLIENTSTATE_WEBSOCKET)
+        return;
+
+    payload[0] = status >> 8;
+    payload[1] = status & 0xFF;
+    HttpServer_wsFrame(dev,client,HTTPSERVER_WEBSOCKET_OPCODE_CLOSE,payload,2);
+
+    // The connection is closed when the close frame is sent
+    c->state = HTTPSERVER_CLIENTSTATE_RESPONSE;
+    c->txFlags = HTTPSERVER_TXFLAGS_END;
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_WEBSOCKET_CLOSE,client,status,0);
+}
+
+#endif // HTTPSERVER_WEBSOCKET
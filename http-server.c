@@ -26,12 +26,46 @@
  */
 
 #include "http-server.h"
+#include "http-server-internal.h"
 #include "utility.h"
 
-#ifdef OHILAB_HTTPSERVER_DEBUG
-#include "cli/cli.h"
+// The longest request line is "POST " URI " HTTP/1.1"
+#if ((HTTPSERVER_MAX_URI_LENGTH + 14) > HTTPSERVER_RX_BUFFER_DIMENSION)
+#error "HTTPSERVER_RX_BUFFER_DIMENSION must hold a request line of HTTPSERVER_MAX_URI_LENGTH"
+#endif
+#if (HTTPSERVER_RX_BUFFER_DIMENSION > 65534) || (HTTPSERVER_TX_BUFFER_DIMENSION > 65534)
+#error "HTTPSERVER_RX_BUFFER_DIMENSION and HTTPSERVER_TX_BUFFER_DIMENSION must fit 16 bit indexes"
+#endif
+#if (HTTPSERVER_HEADERS_MAX_LENGTH > 65534)
+#error "HTTPSERVER_HEADERS_MAX_LENGTH must fit a 16 bit index"
+#endif
+#if (HTTPSERVER_POLL_QUANTUM_BYTES == 0) || (HTTPSERVER_POLL_QUANTUM_BYTES > 65535)
+#error "HTTPSERVER_POLL_QUANTUM_BYTES must be between 1 and 65535"
+#endif
+#if (HTTPSERVER_OVERLOAD_CLIENTS > ETHERNET_MAX_LISTEN_CLIENT)
+#error "HTTPSERVER_OVERLOAD_CLIENTS must not be greater than ETHERNET_MAX_LISTEN_CLIENT"
+#endif
+#if (HTTPSERVER_KEEPALIVE == 1) && (HTTPSERVER_KEEPALIVE_TIMEOUT > HTTPSERVER_TIMEOUT)
+#error "HTTPSERVER_KEEPALIVE_TIMEOUT must not be greater than HTTPSERVER_TIMEOUT"
+#endif
+#if (HTTPSERVER_KEEPALIVE == 1) && \
+    ((HTTPSERVER_KEEPALIVE_MAX_REQUESTS < 1) || (HTTPSERVER_KEEPALIVE_MAX_REQUESTS > 255))
+#error "HTTPSERVER_KEEPALIVE_MAX_REQUESTS must be between 1 and 255"
+#endif
+#if (HTTPSERVER_CORK == 1) && (HTTPSERVER_CORK_TICKS >= HTTPSERVER_TIMEOUT)
+#error "HTTPSERVER_CORK_TICKS must be less than HTTPSERVER_TIMEOUT"
+#endif
+#if (HTTPSERVER_CORK == 1) && ((HTTPSERVER_CORK_SEGMENT == 0) || (HTTPSERVER_CORK_SEGMENT > HTTPSERVER_TX_BUFFER_DIMENSION))
+#error "HTTPSERVER_CORK_SEGMENT must be between 1 and HTTPSERVER_TX_BUFFER_DIMENSION"
+#endif
+#if (HTTPSERVER_GENERATOR == 1) && (HTTPSERVER_TX_BUFFER_DIMENSION < HTTPSERVER_GENERATOR_LINE_LENGTH)
+#error "HTTPSERVER_TX_BUFFER_DIMENSION must hold a line of the metrics and of the trace"
+#endif
+#if (HTTPSERVER_ARENA == 1) && (((HTTPSERVER_ARENA_DIMENSION % 4) != 0) || (HTTPSERVER_ARENA_DIMENSION > 65532))
+#error "HTTPSERVER_ARENA_DIMENSION must be a multiple of 4 which fits a 16 bit index"
 #endif
 
+
 const char HttpServer_responseCode[40][36] =
         {
                 {'1','0','0',' ','C','o','n','t','i','n','u','e','\0'},
@@ -76,29 +110,39 @@ const char HttpServer_responseCode[40][36] =
                 {'5','0','5',' ','H','T','T','P',' ','V','e','r','s','i','o','n',' ','N','o','t',' ','S','u','p','p','o','r','t','e','d','\0'}
         };
 
-typedef uint32_t (*HttpServer_CurrentTick) (void);
-typedef void (*HttpServer_Delay) (uint32_t);
+/**
+ * @ingroup httpServer_functions
+ * The response sent, without parsing the request, to the clients refused
+ * when the server is overloaded.
+ */
+static const char HttpServer_overloadResponse[] =
+        HTTPSERVER_STRING_VERSION_1_1 " 503 Service Unavailable\r\n"
+        "Retry-After: " HTTPSERVER_OVERLOAD_RETRY_AFTER "\r\n"
+        "Content-Length: 0\r\n"
+        "Connection: close\r\n"
+        "Server: " HTTPSERVER_SERVER_NAME "\r\n\r\n";
 
-static HttpServer_CurrentTick HttpServer_currentTick;
-static HttpServer_Delay HttpServer_delay;
+HttpServer_CurrentTick HttpServer_currentTick;
+HttpServer_Delay HttpServer_delay;
 
 /**
  * @ingroup httpServer_functions
- * This function stores the incoming line
+ * This function collects the incoming line without waiting for data: it reads
+ * the available bytes, up to the remaining quantum, and stores them into the
+ * receive buffer of the client. The line is terminated with '\0' and the
+ * \r\n characters are removed.
  *@param server The server pointer which you have previously definited
- *@param[out] buffer The buffer where the line is going to save
- *@param maxLength The maximum buffer length
- *@param timeout Timeout
  *@param client The number of the listened client
- *@param[out] The number of the character received including \r\n characters
- *@return HTTPSERRVER_ERROR_OK or HTTPSERVER_ERROR_OK_EMPTY_LINE if everything
-  gone well other erros otherwise
+ *@param[in,out] budget The number of bytes which can still be read during this
+ * pass, it is decreased by the number of read bytes
+ *@param[out] The number of the character of the line, \r\n excluded
+ *@return HTTPSERVER_ERROR_OK or HTTPSERVER_ERROR_OK_EMPTYLINE when a line is
+ * completed, HTTPSERVER_ERROR_IN_PROGRESS when more data are needed, other
+ * errors otherwise
  */
 static HttpServer_Error HttpServer_getLine (HttpServer_DeviceHandle dev,
-                                            char* buffer,
-                                            uint16_t maxLength,
-                                            uint16_t timeout,
                                             uint8_t client,
+                                            uint16_t* budget,
                                             int16_t* received);
 
 /**
@@ -115,6 +159,108 @@ static HttpServer_Error HttpServer_parseRequest (HttpServer_DeviceHandle dev,
                                                  uint16_t length,
                                                  uint8_t client);
 
+/**
+ * @ingroup httpServer_functions
+ * This function serves a client for one quantum of the current
+ * @ref HttpServer_poll pass.
+ *@param server The server pointer which you have previously definited
+ *@param client The number of the served client
+ */
+static void HttpServer_serviceClient (HttpServer_DeviceHandle dev,
+                                      uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function terminates the open chunk, writing its size into the
+ * reserved header.
+ *@param server The server pointer which you have previously definited
+ *@param client The client number
+ */
+static void HttpServer_txCloseChunk (HttpServer_DeviceHandle dev,
+                                     uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function parses the value of an Accept-Encoding header.
+ *@param[in] value The header value
+ *@return The accepted codings, see @ref HttpServer_Encoding
+ */
+static uint8_t HttpServer_parseAcceptEncoding (const char* value);
+
+/**
+ * @ingroup httpServer_functions
+ * This function prepares a connected client to receive a request.
+ *@param server The server pointer which you have previously definited
+ *@param client The client number
+ */
+static void HttpServer_resetClient (HttpServer_DeviceHandle dev,
+                                    uint8_t client);
+
+#if (HTTPSERVER_CORK == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function checks if less than a segment of staged bytes has to wait
+ * for the next ones: while the response is corked, or when its end can go
+ * out with the response of a pipelined request.
+ */
+static bool HttpServer_txHold (HttpServer_DeviceHandle dev,
+                               uint8_t client);
+#endif
+
+#if (HTTPSERVER_GENERATOR == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function writes the next lines of a generated body as long as they
+ * fit the transmission buffer, and ends the response after the last one.
+ *@param server The server pointer which you have previously definited
+ *@param client The client number
+ */
+static void HttpServer_generatorFill (HttpServer_DeviceHandle dev,
+                                      uint8_t client);
+#endif
+
+/**
+ * @ingroup httpServer_functions
+ * This function calls the producer of a streamed body until the
+ * transmission buffer is half full, the producer has nothing to write or
+ * it ends the response.
+ *@param server The server pointer which you have previously definited
+ *@param client The client number
+ */
+static void HttpServer_producerFill (HttpServer_DeviceHandle dev,
+                                     uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function parses the value of a Connection header.
+ *@param[in] value The header value
+ *@return The @ref HttpServer_MessageFlags of the connection options
+ */
+static uint8_t HttpServer_parseConnection (const char* value);
+
+/**
+ * @ingroup httpServer_functions
+ * This function checks the server load when a new connection is detected.
+ * Above the configured watermarks the pre-serialized
+ * @ref HttpServer_overloadResponse is sent and the connection is closed.
+ *@param server The server pointer which you have previously definited
+ *@param client The number of the new client
+ *@return true if the client can be served, false if it was refused
+ */
+static bool HttpServer_admitClient (HttpServer_DeviceHandle dev,
+                                    uint8_t client);
+
+#ifndef OHILAB_HTTPSERVER_MODULE_TEST
+/**
+ * @ingroup httpServer_functions
+ * This function updates the smoothed execution time of the request handler.
+ *@param server The server pointer which you have previously definited
+ *@param ticks The execution time of the last request
+ */
+static void HttpServer_updateLatency (HttpServer_DeviceHandle dev,
+                                      uint32_t ticks);
+#endif
+
 HttpServer_Error HttpServer_open (HttpServer_DeviceHandle dev)
 {
     // Check if the port is valid
@@ -137,315 +283,809 @@ HttpServer_Error HttpServer_open (HttpServer_DeviceHandle dev)
     // Open the server socket
     if (EthernetServerSocket_connect(dev->socketNumber,dev->port) != ETHERNETSOCKET_ERROR_OK)
     {
-#ifdef OHILAB_HTTPSERVER_DEBUG
-        Cli_sendMessage("HttpServer_open:",
-                        "opening server fail",
-                        CLI_MESSAGETYPE_INFO);
-#endif
+        HTTPSERVER_TRACE(HTTPSERVER_TRACE_OPEN_FAIL,0,dev->port,dev->socketNumber);
         return HTTPSERVER_ERROR_OPEN_FAIL;
     }
 
     // Reset all buffer
     for (uint8_t i = 0; i < ETHERNET_MAX_LISTEN_CLIENT; ++i)
-            dev->clients[i].rxIndex = 0;
-
-#ifdef OHILAB_HTTPSERVER_DEBUG
-    Cli_sendMessage("HttpServer_open:",
-                    "server is started",
-                    CLI_MESSAGETYPE_INFO);
+    {
+        dev->clients[i].rxIndex = 0;
+        dev->clients[i].txLength = 0;
+        dev->clients[i].txSent = 0;
+        dev->clients[i].state = HTTPSERVER_CLIENTSTATE_IDLE;
+        dev->clients[i].txAborted = false;
+        dev->clients[i].producer = NULL;
+#if (HTTPSERVER_BORROWED == 1)
+        dev->clients[i].borrowed = NULL;
+#endif
+#if (HTTPSERVER_GENERATOR == 1)
+        dev->clients[i].generator = NULL;
+#endif
+#if (HTTPSERVER_ARENA == 1)
+        dev->clients[i].message.arena.peak = 0;
+#endif
+    }
+    dev->pollStart = 0;
+    dev->date[0] = '\0';
+#if (HTTPSERVER_RATELIMIT == 1)
+    memset(dev->rateLimit,0,sizeof(dev->rateLimit));
+#endif
+#if (HTTPSERVER_COMPRESSION == 1)
+    dev->deflate.client = HTTPSERVER_DEFLATE_FREE;
+#endif
+#if (HTTPSERVER_HTTP2 == 1)
+    dev->http2.client = HTTPSERVER_HTTP2_FREE;
+#endif
+#if (HTTPSERVER_SSE == 1)
+    dev->sse.head = 0;
+    dev->sse.lastTick = HttpServer_currentTick();
 #endif
+    dev->activeClients = 0;
+    dev->handlerLatency = 0;
+#if (HTTPSERVER_METRICS == 1)
+    memset(&dev->metrics,0,sizeof(dev->metrics));
+#endif
+
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_OPEN,0,dev->port,dev->socketNumber);
     return HTTPSERVER_ERROR_OK;
 }
 
 void HttpServer_poll (HttpServer_DeviceHandle dev)
 {
-    uint8_t data;
-    int16_t received = 0;
-    uint16_t wrote = 0;
-#ifdef OHILAB_HTTPSERVER_DEBUG
-    char cliBuffer [64];
-    uint8_t cliStringLength;
-    char character [2];
+    uint8_t client;
+
+#if (HTTPSERVER_SSE == 1)
+    HttpServer_sseHeartbeat(dev);
 #endif
-    uint8_t j = 0;
-    HttpServer_Error error = HTTPSERVER_ERROR_OK;
 
-    for (uint8_t i = 0; i < ETHERNET_MAX_LISTEN_CLIENT; i++)
+    // The control-plane clients are served first, then the bulk ones.
+    // Inside each class the first served client rotates at every pass.
+    for (uint8_t pass = 0; pass < 2; ++pass)
     {
-#ifdef OHILAB_HTTPSERVER_DEBUG
-        //converting uint8_t to char
-        character[0] = i + '0';
-        character[1] = '\0';
-#endif
+        HttpServer_Priority priority = (pass == 0) ? HTTPSERVER_PRIORITY_HIGH :
+                                                     HTTPSERVER_PRIORITY_NORMAL;
 
-        // When a client is not connected, jump to the next
-        if (!EthernetServerSocket_isConnected(dev->socketNumber,i))
+        for (uint8_t i = 0; i < ETHERNET_MAX_LISTEN_CLIENT; i++)
         {
-            continue;
-        }
-#ifdef OHILAB_HTTPSERVER_DEBUG
-        strncpy(cliBuffer, "new client #",12);
-        strncpy(&cliBuffer[12],character,1);
-        strncpy(&cliBuffer[13], " is connected",13);
-        strncpy(&cliBuffer[26], '\0',1);
-        Cli_sendMessage("HttpServer_poll:",cliBuffer, CLI_MESSAGETYPE_INFO);
+            client = (dev->pollStart + i) % ETHERNET_MAX_LISTEN_CLIENT;
 
-#endif
-        // Clear index
-        received = 0;
-        dev->clients[i].rxIndex = 0;
-        // Get first line
-        error = HttpServer_getLine(dev,
-                                   dev->clients[i].rxBuffer,
-                                   HTTPSERVER_RX_BUFFER_DIMENSION,
-                                   HTTPSERVER_TIMEOUT,
-                                   i,
-                                   &received);
-        // When there isn't message, jump to the next client
-        if (received < 0)
-        {
-            //close the connection for this client
-            EthernetServerSocket_disconnectClient(dev->socketNumber,
-                                                  i);
-#ifdef OHILAB_HTTPSERVER_DEBUG
-            strncpy(cliBuffer, "client #",8);
-            strncpy(&cliBuffer[7],character,1);
-            strncpy(&cliBuffer[8], " is disconnected",15);
-            strncpy(&cliBuffer[24], '\0',1);
-            Cli_sendMessage("HttpServer_poll:",cliBuffer, CLI_MESSAGETYPE_INFO);
-#endif
+            if (dev->clients[client].priority != priority)
+                continue;
 
-            continue;
+            HttpServer_serviceClient(dev,client);
         }
-        // Parse the first line of the request
-        error = HttpServer_parseRequest(dev,
-                                        dev->clients[i].rxBuffer,
-                                        received,
-                                        i);
-        if (error != HTTPSERVER_ERROR_OK)
+    }
+
+    dev->pollStart = (dev->pollStart + 1) % ETHERNET_MAX_LISTEN_CLIENT;
+}
+
+static void HttpServer_serviceClient (HttpServer_DeviceHandle dev,
+                                      uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    int16_t received = 0;
+    uint16_t budget = HTTPSERVER_POLL_QUANTUM_BYTES;
+    uint32_t startTick = HttpServer_currentTick();
+    HttpServer_Error error = HTTPSERVER_ERROR_OK;
+    // When a client is not connected, release its slot
+    if (!EthernetServerSocket_isConnected(dev->socketNumber,client))
+    {
+        if (c->state != HTTPSERVER_CLIENTSTATE_IDLE)
         {
-#ifdef OHILAB_HTTPSERVER_DEBUG
-            strncpy(cliBuffer, "client #",8);
-            strncpy(&cliBuffer[7],character,1);
-            strncpy(&cliBuffer[8], " is disconnected",16);
-            strncpy(&cliBuffer[25], '\0',1);
-            Cli_sendMessage("HttpServer_poll:",cliBuffer, CLI_MESSAGETYPE_INFO);
-            Cli_sendMessage("",character,CLI_MESSAGETYPE_INFO);
-
-#endif
-            //Send bad request and disconnect the client!
-            HttpServer_sendResponse(dev, HTTPSERVER_RESPONSECODE_BADREQUEST,
-                                    "Content-Length: 0\r\nServer: OHILab\r\n\n\r",
-                                    "",
-                                    i);
-            EthernetServerSocket_disconnectClient(dev->socketNumber,
-                                                  i);
-            // Jump to the next client
-            continue;
+            HTTPSERVER_TRACE(HTTPSERVER_TRACE_DISCONNECT,client,c->state,0);
+#if (HTTPSERVER_WEBSOCKET == 1)
+            if ((c->state == HTTPSERVER_CLIENTSTATE_WEBSOCKET) && (dev->websocketCallback != 0))
+                dev->websocketCallback(dev->appDevice,HTTPSERVER_WEBSOCKET_CLOSE,NULL,0,true,client);
+#endif
+#if (HTTPSERVER_UPLOAD == 1)
+            if (c->state == HTTPSERVER_CLIENTSTATE_UPLOAD)
+                HttpServer_uploadAbort(dev,client);
+#endif
+#if (HTTPSERVER_BORROWED == 1)
+            HttpServer_borrowedRelease(dev,client,false);
+#endif
+            c->state = HTTPSERVER_CLIENTSTATE_IDLE;
+            c->priority = HTTPSERVER_PRIORITY_NORMAL;
+            c->txLength = 0;
+            c->txSent = 0;
+            dev->activeClients--;
+            HTTPSERVER_METRICS_INC(dev,connectionsClosed);
+#if (HTTPSERVER_COMPRESSION == 1)
+            HttpServer_deflateRelease(dev,client);
+#endif
+#if (HTTPSERVER_HTTP2 == 1)
+            HttpServer_http2Release(dev,client);
+#endif
         }
+        return;
+    }
+
+    if (c->state == HTTPSERVER_CLIENTSTATE_IDLE)
+    {
+        // Under overload the connection is refused before allocating
+        // anything for it
+        if (!HttpServer_admitClient(dev,client))
+            return;
+#if (HTTPSERVER_RATELIMIT == 1)
+        if (!HttpServer_rateLimitConnection(dev,client))
+            return;
+#endif
+
+        HTTPSERVER_TRACE(HTTPSERVER_TRACE_CONNECT,client,dev->activeClients,0);
+        HttpServer_resetClient(dev,client);
+        c->requests = 0;
+        c->txAborted = false;
+        dev->activeClients++;
+        HTTPSERVER_METRICS_INC(dev,connectionsAccepted);
+    }
+
+#if (HTTPSERVER_HTTP2 == 1)
+    // The streams of the HTTP/2 connection are sent by the response path
+    // below, one at a time
+    if ((dev->http2.client == client) && !HttpServer_http2Service(dev,client,&budget))
+        return;
+#endif
+    // The data of an aborted response are lost: the connection is closed,
+    // so that the client can't take what it received as complete
+    if (c->txAborted)
+    {
+        HTTPSERVER_TRACE(HTTPSERVER_TRACE_TIMEOUT,client,c->state,0);
+        HTTPSERVER_METRICS_INC(dev,timeouts);
+#if (HTTPSERVER_WEBSOCKET == 1)
+        if ((c->state == HTTPSERVER_CLIENTSTATE_WEBSOCKET) && (dev->websocketCallback != 0))
+            dev->websocketCallback(dev->appDevice,HTTPSERVER_WEBSOCKET_CLOSE,NULL,0,true,client);
+#endif
+#if (HTTPSERVER_UPLOAD == 1)
+        if (c->state == HTTPSERVER_CLIENTSTATE_UPLOAD)
+            HttpServer_uploadAbort(dev,client);
+#endif
+        HttpServer_closeClient(dev,client);
+        return;
+    }
+#if (HTTPSERVER_WEBSOCKET == 1)
+    if (c->state == HTTPSERVER_CLIENTSTATE_WEBSOCKET)
+    {
+        HttpServer_wsService(dev,client,budget);
+        return;
+    }
+#endif
+#if (HTTPSERVER_SSE == 1)
+    if (c->state == HTTPSERVER_CLIENTSTATE_SSE)
+    {
+        HttpServer_sseService(dev,client,budget);
+        return;
+    }
+#endif
+#if (HTTPSERVER_UPLOAD == 1)
+    if (c->state == HTTPSERVER_CLIENTSTATE_UPLOAD)
+    {
+        HttpServer_uploadService(dev,client,budget);
+        return;
+    }
+#endif
+
+    // Send the staged response, when it is completely sent close the
+    // connection
+    if (c->state == HTTPSERVER_CLIENTSTATE_RESPONSE)
+    {
+        bool hold = false;
 
-#ifdef OHILAB_HTTPSERVER_DEBUG
-        Cli_sendMessage("HttpServer_poll: ",
-                        "First line is parsed",
-                        CLI_MESSAGETYPE_INFO);
+#if (HTTPSERVER_RANGE == 1)
+        // Read the next part of the resource which is sent
+        if ((c->sourceRemaining > 0) && !HttpServer_sourceFill(dev,client))
+            return;
 #endif
-        // The request was received
-        do
+#if (HTTPSERVER_GENERATOR == 1)
+        // Write the next lines of the body which is generated
+        if (c->generator != NULL)
+            HttpServer_generatorFill(dev,client);
+#endif
+        // Write the next part of the body which is produced, while the
+        // previous one is sent
+        if (c->producer != NULL)
+            HttpServer_producerFill(dev,client);
+#if (HTTPSERVER_CORK == 1)
+        hold = HttpServer_txHold(dev,client);
+#endif
+        if (!hold)
         {
+            // A streamed response is going on: don't keep its data into the
+            // open chunk when nothing else can be sent
+            if ((c->txFlags & HTTPSERVER_TXFLAGS_CHUNK_OPEN) && (c->txSent == c->txChunk))
+                HttpServer_txCloseChunk(dev,client);
 
-            //put every headers in headerBuffer
-            error = HttpServer_getLine(dev,
-                                       dev->clients[i].rxBuffer,
-                                       HTTPSERVER_RX_BUFFER_DIMENSION,
-                                       HTTPSERVER_TIMEOUT,
-                                       i,
-                                       &received);
+            if (HttpServer_txDrain(dev,client,budget) > 0)
+                c->lastTick = HttpServer_currentTick();
+#if (HTTPSERVER_BORROWED == 1)
+            // The borrowed body follows the staged headers
+            else if ((c->borrowed != NULL) && (HttpServer_borrowedDrain(dev,client,budget) > 0))
+                c->lastTick = HttpServer_currentTick();
+#endif
+        }
 
-            if (error == HTTPSERVER_ERROR_OK)
+        // A held end of response is sent with the next one, so it isn't
+        // recorded as sent
+        if (((c->txLength == 0) || hold) && (c->txFlags & HTTPSERVER_TXFLAGS_END))
+        {
+            if (!hold)
+            {
+                HTTPSERVER_TRACE(HTTPSERVER_TRACE_SENT,client,c->priority,0);
+                HTTPSERVER_METRICS_OBSERVE(dev,send,HttpServer_currentTick() - c->phaseTick);
+            }
+#if (HTTPSERVER_HTTP2 == 1)
+            if (dev->http2.client == client)
             {
-                if((received + dev->clients[i].rxIndex) < HTTPSERVER_HEADERS_MAX_LENGTH)
+                // The connection waits for the next stream
+                if (HttpServer_http2StreamEnd(dev,client))
                 {
-                    strncpy(&dev->clients[i].message.header[dev->clients[i].rxIndex],
-                            dev->clients[i].rxBuffer,
-                            received);
-                    dev->clients[i].rxIndex += received;
+                    HttpServer_resetClient(dev,client);
+                    c->state = HTTPSERVER_CLIENTSTATE_HTTP2;
+                    c->priority = HTTPSERVER_PRIORITY_NORMAL;
                 }
-                else
-                {
-#ifdef OHILAB_HTTPSERVER_DEBUG
-                    Cli_sendMessage("HttpServer_poll:",
-                                    "header buffer too short",
-                                    CLI_MESSAGETYPE_INFO);
+                return;
+            }
 #endif
-                }
+            if (c->txFlags & HTTPSERVER_TXFLAGS_KEEPALIVE)
+            {
+                // Wait for the next request on the same connection
+                HTTPSERVER_TRACE(HTTPSERVER_TRACE_KEEPALIVE,client,c->requests,0);
+                HttpServer_resetClient(dev,client);
+                c->priority = HTTPSERVER_PRIORITY_NORMAL;
             }
+            else
+            {
+                HttpServer_closeClient(dev,client);
+            }
+        }
+        else if ((uint32_t)(HttpServer_currentTick() - c->lastTick) >= HTTPSERVER_TIMEOUT)
+        {
+            HTTPSERVER_METRICS_INC(dev,timeouts);
+            HttpServer_closeClient(dev,client);
+        }
+        return;
+    }
+
+    while ((budget > 0) &&
+           ((uint32_t)(HttpServer_currentTick() - startTick) < HTTPSERVER_POLL_QUANTUM_TICKS))
+    {
+        error = HttpServer_getLine(dev,client,&budget,&received);
+
+        if (error == HTTPSERVER_ERROR_IN_PROGRESS)
+            break;
+
+        c->lastTick = HttpServer_currentTick();
+
+        if (error == HTTPSERVER_ERROR_LINE_TOO_LONG)
+        {
+            HTTPSERVER_METRICS_INC(dev,parseErrors);
+            HttpServer_sendResponse(dev,
+                                    (c->state == HTTPSERVER_CLIENTSTATE_REQUEST) ?
+                                        HTTPSERVER_RESPONSECODE_REQUESTURITOOLARGE :
+                                        HTTPSERVER_RESPONSECODE_BADREQUEST,
+                                    "Content-Length: 0\r\nServer: " HTTPSERVER_SERVER_NAME,
+                                    "",
+                                    client);
+            return;
+        }
 
-            //  If we received an empty line, this would indicate the end of the message
+        if (c->state == HTTPSERVER_CLIENTSTATE_REQUEST)
+        {
+            // Ignore empty lines before the request line
+            if (error == HTTPSERVER_ERROR_OK_EMPTYLINE)
+                continue;
 
-            if (received < 0)
+#if (HTTPSERVER_HTTP2 == 1)
+            // The connection preface of HTTP/2 with prior knowledge
+            if ((received == 14) && (memcmp(c->rxBuffer,"PRI * HTTP/2.0",14) == 0))
             {
-#ifndef OHILAB_HTTPSERVER_MODULE_TEST
-                // Performing the request
-                dev->performingCallback(dev->appDevice, &dev->clients[i].message, i);
-#ifdef OHILAB_HTTPSERVER_DEBUG
-                Cli_sendMessage("HttpServer_poll:",
-                                "performing the request",
-                                CLI_MESSAGETYPE_INFO);
-#endif
-                // Just for test
-                HttpServer_sendResponse(dev,
-                                        dev->clients[i].message.responseCode,
-                                        dev->clients[i].message.header,
-                                        dev->clients[i].message.body,
-                                        i);
-
-                memset(dev->clients[i].message.header,
-                        0,
-                        sizeof(dev->clients[i].message.header));
-                memset(dev->clients[i].message.body,
-                        0,
-                        sizeof(dev->clients[i].message.body));
-                memset(dev->clients[i].message.uri,
-                        0,
-                        sizeof(dev->clients[i].message.uri));
-
-                memset(dev->clients[i].txBuffer,
-                        0,
-                        sizeof(dev->clients[i].txBuffer));
-#endif
-#ifdef OHILAB_HTTPSERVER_MODULE_TEST
-#ifdef OHILAB_HTTPSERVER_DEBUG
-                Cli_sendMessage("HttpServer_poll:",
-                                "request received",
-                                CLI_MESSAGETYPE_INFO);
+                HttpServer_http2Start(dev,client);
+                return;
+            }
 #endif
-                // Just for test
-                HttpServer_sendResponse(dev,
-                                        HTTPSERVER_RESPONSECODE_BADREQUEST,
-                                        "Content-Length: 0\r\nServer: OHILab\r\n\n\r",
-                                        "",
-                                        i);
-#endif
-                EthernetServerSocket_disconnectClient(dev->socketNumber,
-                                                       i);
-#ifdef OHILAB_HTTPSERVER_DEBUG
-                strncpy(cliBuffer, "client #",8);
-                strncpy(&cliBuffer[7],character,1);
-                strncpy(&cliBuffer[8], " is disconnected",15);
-                strncpy(&cliBuffer[24], '\0',1);
-                Cli_sendMessage("HttpServer_poll:",cliBuffer, CLI_MESSAGETYPE_INFO);
+#if (HTTPSERVER_RATELIMIT == 1)
+            if (!HttpServer_rateLimitRequest(dev,client))
+                return;
 #endif
+            // Parse the first line of the request
+            error = HttpServer_parseRequest(dev,
+                                            (char*)c->rxBuffer,
+                                            received,
+                                            client);
+            if (error != HTTPSERVER_ERROR_OK)
+            {
+                HTTPSERVER_METRICS_INC(dev,parseErrors);
+                HTTPSERVER_TRACE(HTTPSERVER_TRACE_PARSE_ERROR,client,error,received);
+                //Send bad request and disconnect the client!
+                if (error != HTTPSERVER_ERROR_URI_TOO_LONG)
+                {
+                    HttpServer_sendResponse(dev,
+                                            HTTPSERVER_RESPONSECODE_BADREQUEST,
+                                            "Content-Length: 0\r\nServer: " HTTPSERVER_SERVER_NAME,
+                                            "",
+                                            client);
+                }
+                return;
             }
-    }while (received > 0);
+            HTTPSERVER_TRACE(HTTPSERVER_TRACE_REQUEST,client,c->message.request,received);
+            HttpServer_beginRequest(dev,client);
+            continue;
+        }
+
+        // Put every headers in header buffer
+        if (error == HTTPSERVER_ERROR_OK)
+        {
+            HttpServer_headerLine(dev,client,(char*)c->rxBuffer,received);
+            continue;
+        }
+
+        // If we received an empty line, this would indicate the end of the message
+        HTTPSERVER_METRICS_OBSERVE(dev,headers,c->lastTick - c->phaseTick);
+        HttpServer_performRequest(dev,client);
+        // The response is sent with the next quanta
+        return;
+    }
+
+#if (HTTPSERVER_CORK == 1)
+    // The end of the previous response waits only for a pipelined request
+    // which is already received
+    if (c->txLength > 0)
+        HttpServer_txDrain(dev,client,budget);
+#endif
+
+    // Check if timeout occur, if yes close the connection. A kept-alive
+    // connection waiting for its next request is closed earlier.
+    if ((uint32_t)(HttpServer_currentTick() - c->lastTick) >=
+        (((c->requests > 0) && (c->state == HTTPSERVER_CLIENTSTATE_REQUEST) && (c->rxIndex == 0)) ?
+            HTTPSERVER_KEEPALIVE_TIMEOUT :
+            HTTPSERVER_TIMEOUT))
+    {
+        HTTPSERVER_TRACE(HTTPSERVER_TRACE_TIMEOUT,client,c->state,0);
+        HTTPSERVER_METRICS_INC(dev,timeouts);
+        HttpServer_closeClient(dev,client);
     }
 }
 
-static HttpServer_Error HttpServer_getLine (HttpServer_DeviceHandle dev,
-                                            char* buffer,
-                                            uint16_t maxLength,
-                                            uint16_t timeout,
-                                            uint8_t client,
-                                            int16_t* received)
+void HttpServer_beginRequest (HttpServer_DeviceHandle dev,
+                              uint8_t client)
 {
-    int16_t i = 0, count = 0;
-    *received = -1; // Default
+    HttpServer_ClientHandle c = &dev->clients[client];
+
+    // Saturated: the count must not restart on a long HTTP/2 connection
+    if (c->requests < 0xFF)
+        c->requests++;
+    c->message.acceptEncoding = HTTPSERVER_ENCODING_IDENTITY;
+    c->message.contentLength = 0;
+    c->message.flags = 0;
+#if (HTTPSERVER_RANGE == 1)
+    c->message.rangeFlags = 0;
+#endif
+    HTTPSERVER_METRICS_INC(dev,requests[c->message.request]);
+#if (HTTPSERVER_METRICS == 1)
+    HttpServer_observe(&dev->metrics.firstLine,c->lastTick - c->phaseTick);
+    c->phaseTick = c->lastTick;
+#endif
+    if (dev->priorityCallback != 0)
+        c->priority = dev->priorityCallback(dev->appDevice,&c->message);
 
-    //Check if parameters make sense
-    if ((buffer == NULL) || (maxLength == 0))
+    c->state = HTTPSERVER_CLIENTSTATE_HEADERS;
+}
+
+void HttpServer_headerLine (HttpServer_DeviceHandle dev,
+                            uint8_t client,
+                            const char* line,
+                            uint16_t length)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+
+    // The headers used by the server are parsed as they arrive
+    if (HttpServer_compareNoCase(line,"Accept-Encoding:",16))
     {
+        c->message.acceptEncoding =
+                HttpServer_parseAcceptEncoding(&line[16]);
+    }
+    else if (HttpServer_compareNoCase(line,"Content-Length:",15))
+    {
+        const char* value = &line[15];
 
-#ifdef OHILAB_HTTPSERVER_DEBUG
-        Cli_sendMessage("HttpServer_getLine:",
-                        "wrong parameter",
-                        CLI_MESSAGETYPE_INFO);
+        while (*value == ' ') value++;
+        if (HttpServer_parseNumber(&value,&c->message.contentLength))
+            c->message.flags |= HTTPSERVER_MESSAGEFLAGS_CONTENT_LENGTH;
+    }
+    else if (HttpServer_compareNoCase(line,"Transfer-Encoding:",18))
+    {
+        c->message.flags |= HTTPSERVER_MESSAGEFLAGS_TRANSFER_ENCODING;
+    }
+    else if (HttpServer_compareNoCase(line,"Connection:",11))
+    {
+        c->message.flags |= HttpServer_parseConnection(&line[11]);
+    }
+    else if (HttpServer_compareNoCase(line,"Expect:",7))
+    {
+        if (strstr(&line[7],"100-continue") != NULL)
+            c->message.flags |= HTTPSERVER_MESSAGEFLAGS_EXPECT_CONTINUE;
+    }
+#if (HTTPSERVER_RANGE == 1)
+    else if (HttpServer_compareNoCase(line,"Range:",6))
+    {
+        HttpServer_parseRange(&c->message,&line[6]);
+    }
+    else if (HttpServer_compareNoCase(line,"If-Range:",9))
+    {
+        HttpServer_parseIfRange(&c->message,&line[9]);
+    }
 #endif
-        return HTTPSERVER_ERROR_WRONG_PARAM;
+
+    if ((length + 2 + c->headerIndex) < HTTPSERVER_HEADERS_MAX_LENGTH)
+    {
+        memcpy(&c->message.header[c->headerIndex],line,length);
+        c->headerIndex += length;
+        c->message.header[c->headerIndex++] = '\r';
+        c->message.header[c->headerIndex++] = '\n';
+        c->message.header[c->headerIndex] = '\0';
+    }
+    else
+    {
+        HTTPSERVER_TRACE(HTTPSERVER_TRACE_HEADER_OVERFLOW,client,c->headerIndex,length);
     }
+}
+
+void HttpServer_performRequest (HttpServer_DeviceHandle dev,
+                                uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+#ifndef OHILAB_HTTPSERVER_MODULE_TEST
+    uint32_t startTick;
+#endif
 
+#if (HTTPSERVER_HTTP2 == 1)
+    HttpServer_http2Upgrade(dev,client);
+#endif
+#if (HTTPSERVER_WEBSOCKET == 1)
+    if (HttpServer_wsUpgrade(dev,client))
+        return;
+#endif
 
-    uint32_t nextTimeout = HttpServer_currentTick() + timeout;
-    //Check if timeout occur or the received line is too long
-    while ((nextTimeout > HttpServer_currentTick()) && (i < maxLength))
+#if (HTTPSERVER_METRICS == 1) && (HTTPSERVER_METRICS_ROUTE == 1)
+    if ((c->message.request == HTTPSERVER_REQUEST_GET) &&
+        (strcmp(c->message.uri,HTTPSERVER_METRICS_URI) == 0))
     {
-        int16_t available = 0;
-        EthernetServerSocket_available(dev->socketNumber,client, &available);
-        if (available != 0)
-        {
-            EthernetServerSocket_read(dev->socketNumber,client,&buffer[i]);
-            if (buffer[i] == '\n')
-                {
-                // \n character is not counted
-                    i--;
-                    break;
-                }
-            i++;
-        }
+        HttpServer_sendMetrics(dev,client);
+        return;
     }
-
-    // Check if timeout occur, if yes send the corrisponding error
-    if (nextTimeout <= HttpServer_currentTick())
+#endif
+#if (HTTPSERVER_TRACE_ENABLE == 1) && (HTTPSERVER_TRACE_ROUTE == 1)
+    if ((c->message.request == HTTPSERVER_REQUEST_GET) &&
+        (strcmp(c->message.uri,HTTPSERVER_TRACE_URI) == 0))
     {
-        *received = -1;
-#ifdef OHILAB_HTTPSERVER_DEBUG
-            Cli_sendMessage("HttpServer_getLine: ",
-                            "timeout",
-                            CLI_MESSAGETYPE_INFO);
+        HttpServer_sendTrace(dev,client);
+        return;
+    }
 #endif
-        return HTTPSERVER_ERROR_TIMEOUT;
+
+#ifndef OHILAB_HTTPSERVER_MODULE_TEST
+    // Performing the request
+    startTick = HttpServer_currentTick();
+    dev->performingCallback(dev->appDevice, &c->message, client);
+    HttpServer_updateLatency(dev,HttpServer_currentTick() - startTick);
+    HTTPSERVER_METRICS_OBSERVE(dev,handler,HttpServer_currentTick() - startTick);
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_HANDLER,client,c->message.responseCode,HttpServer_currentTick() - startTick);
+    // The handler could have started a streamed response by itself
+    if (c->state == HTTPSERVER_CLIENTSTATE_HEADERS)
+    {
+        HttpServer_sendResponse(dev,
+                                c->message.responseCode,
+                                c->message.header,
+                                c->message.body,
+                                client);
     }
-//    Clear '\r'
-    if ((i > 0) && (buffer[i] == '\r')) i--;
 
-    // Empty line
-    if (i == 0)
+    memset(c->message.header,
+           0,
+           sizeof(c->message.header));
+    memset(c->message.body,
+           0,
+           sizeof(c->message.body));
+    memset(c->message.uri,
+           0,
+           sizeof(c->message.uri));
+#endif
+#ifdef OHILAB_HTTPSERVER_MODULE_TEST
+    // Just for test
+    HttpServer_sendResponse(dev,
+                            HTTPSERVER_RESPONSECODE_BADREQUEST,
+                            "Content-Length: 0\r\nServer: " HTTPSERVER_SERVER_NAME,
+                            "",
+                            client);
+#endif
+}
+
+static bool HttpServer_admitClient (HttpServer_DeviceHandle dev,
+                                    uint8_t client)
+{
+    uint16_t wrote = 0;
+
+    if (dev->activeClients < HTTPSERVER_OVERLOAD_CLIENTS)
     {
-        *received = -2;
-#ifdef OHILAB_HTTPSERVER_DEBUG
-            Cli_sendMessage("HttpServer_getLine: ",
-                            "empty line arrived",
-                            CLI_MESSAGETYPE_INFO);
+#if (HTTPSERVER_OVERLOAD_LATENCY > 0)
+        if (dev->handlerLatency < HTTPSERVER_OVERLOAD_LATENCY)
 #endif
-        return HTTPSERVER_ERROR_OK_EMPTYLINE;
+            return true;
     }
 
-    *received = i;
-#ifdef OHILAB_HTTPSERVER_DEBUG
-    Cli_sendMessage("HttpServer_getLine: ","OK",CLI_MESSAGETYPE_INFO);
-#endif
-    return HTTPSERVER_ERROR_OK;
+    // No request is performed while shedding, so let the latency estimation
+    // decay: the server starts to admit clients again
+    dev->handlerLatency -= dev->handlerLatency >> 3;
+    HTTPSERVER_METRICS_INC(dev,connectionsRefused);
 
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_REFUSED,client,dev->activeClients,dev->handlerLatency);
+    EthernetServerSocket_writeBytes(dev->socketNumber,
+                                    client,
+                                    (uint8_t*)HttpServer_overloadResponse,
+                                    sizeof(HttpServer_overloadResponse) - 1,
+                                    &wrote);
+    EthernetServerSocket_disconnectClient(dev->socketNumber,client);
+    return false;
 }
 
-static HttpServer_Error HttpServer_parseRequest (HttpServer_DeviceHandle dev,
-                                                   char* buffer,
-                                                   uint16_t length,
-                                                   uint8_t client)
+#ifndef OHILAB_HTTPSERVER_MODULE_TEST
+static void HttpServer_updateLatency (HttpServer_DeviceHandle dev,
+                                      uint32_t ticks)
 {
-    char tmp[256];
-    uint8_t numArgs = 0;
-    uint16_t argCounter = 0;
+    // Exponential moving average with 1/8 weight
+    if (ticks > dev->handlerLatency)
+        dev->handlerLatency += (ticks - dev->handlerLatency) >> 3;
+    else
+        dev->handlerLatency -= (dev->handlerLatency - ticks) >> 3;
+}
+#endif
 
-    // Add end string to \r character
-    buffer[length+1] = '\0';
-    // Increase the length to detect and parse the last char
-    length++;
+#if (HTTPSERVER_CORK == 1)
+static bool HttpServer_txHold (HttpServer_DeviceHandle dev,
+                               uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    int16_t available = 0;
 
-    if (client >= ETHERNET_MAX_LISTEN_CLIENT)
-        return HTTPSERVER_ERROR_WRONG_CLIENT_NUMBER;
+    if (((c->txLength - c->txSent) >= HTTPSERVER_CORK_SEGMENT) ||
+        (c->txLength == HTTPSERVER_TX_BUFFER_DIMENSION))
+        return false;
 
-    for (uint16_t i = 0; i < length; ++i)
+    if ((c->txFlags & HTTPSERVER_TXFLAGS_END) == 0)
     {
-        if ((buffer[i] == ' ') || (buffer[i] == 0))
-        {
-            tmp[argCounter] = 0;
-            if (numArgs == 0) // Choose request type
-            {
-                if (strcmp(tmp,HTTPSERVER_STRING_REQUEST_GET) == 0)
-                {
-                    dev->clients[client].message.request = HTTPSERVER_REQUEST_GET;
-                }
-                else if (strcmp(tmp,HTTPSERVER_STRING_REQUEST_POST) == 0)
-                {
+        return (c->txFlags & HTTPSERVER_TXFLAGS_CORK) &&
+               ((uint32_t)(HttpServer_currentTick() - c->lastTick) < HTTPSERVER_CORK_TICKS);
+    }
+
+    if ((c->txFlags & HTTPSERVER_TXFLAGS_KEEPALIVE) == 0)
+        return false;
+
+    EthernetServerSocket_available(dev->socketNumber,client,&available);
+    return (available > 0);
+}
+
+void HttpServer_cork (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    if (dev->clients[client].state == HTTPSERVER_CLIENTSTATE_RESPONSE)
+        dev->clients[client].txFlags |= HTTPSERVER_TXFLAGS_CORK;
+}
+
+void HttpServer_uncork (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    dev->clients[client].txFlags &= ~HTTPSERVER_TXFLAGS_CORK;
+}
+#endif
+
+static void HttpServer_resetClient (HttpServer_DeviceHandle dev,
+                                    uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+
+    // Clear indexes, the staged bytes are kept: the response of a pipelined
+    // request can be appended to the end of the previous one
+    c->rxIndex = 0;
+    c->txFlags = 0;
+    c->headerIndex = 0;
+    c->message.header[0] = '\0';
+#if (HTTPSERVER_RANGE == 1)
+    c->sourceRemaining = 0;
+#endif
+#if (HTTPSERVER_BORROWED == 1)
+    c->borrowed = NULL;
+#endif
+#if (HTTPSERVER_GENERATOR == 1)
+    c->generator = NULL;
+#endif
+    c->producer = NULL;
+#if (HTTPSERVER_ARENA == 1)
+    c->message.arena.used = 0;
+#endif
+    c->state = HTTPSERVER_CLIENTSTATE_REQUEST;
+    c->lastTick = HttpServer_currentTick();
+#if (HTTPSERVER_METRICS == 1)
+    c->phaseTick = c->lastTick;
+#endif
+}
+
+static uint8_t HttpServer_parseConnection (const char* value)
+{
+    uint8_t flags = 0;
+    uint16_t length;
+
+    // The value is a comma separated list of options
+    while ((*value != '\r') && (*value != '\0'))
+    {
+        while ((*value == ' ') || (*value == '\t') || (*value == ','))
+            value++;
+        for (length = 0;
+             (value[length] != ',') && (value[length] != ' ') && (value[length] != '\t') &&
+             (value[length] != '\r') && (value[length] != '\0');
+             ++length);
+
+        if ((length == 5) && HttpServer_compareNoCase(value,"close",5))
+            flags |= HTTPSERVER_MESSAGEFLAGS_CLOSE;
+        else if ((length == 10) && HttpServer_compareNoCase(value,"keep-alive",10))
+            flags |= HTTPSERVER_MESSAGEFLAGS_KEEPALIVE;
+        else if ((length == 7) && HttpServer_compareNoCase(value,"upgrade",7))
+            flags |= HTTPSERVER_MESSAGEFLAGS_UPGRADE;
+
+        value += length;
+    }
+    return flags;
+}
+
+void HttpServer_closeClient (HttpServer_DeviceHandle dev,
+                             uint8_t client)
+{
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_CLOSE,client,dev->clients[client].state,0);
+    EthernetServerSocket_disconnectClient(dev->socketNumber,client);
+#if (HTTPSERVER_BORROWED == 1)
+    HttpServer_borrowedRelease(dev,client,false);
+#endif
+
+    if (dev->clients[client].state != HTTPSERVER_CLIENTSTATE_IDLE)
+    {
+        dev->activeClients--;
+        HTTPSERVER_METRICS_INC(dev,connectionsClosed);
+    }
+    dev->clients[client].state = HTTPSERVER_CLIENTSTATE_IDLE;
+    dev->clients[client].priority = HTTPSERVER_PRIORITY_NORMAL;
+    dev->clients[client].txLength = 0;
+    dev->clients[client].txSent = 0;
+#if (HTTPSERVER_COMPRESSION == 1)
+    HttpServer_deflateRelease(dev,client);
+#endif
+#if (HTTPSERVER_HTTP2 == 1)
+    HttpServer_http2Release(dev,client);
+#endif
+}
+
+static uint8_t HttpServer_parseAcceptEncoding (const char* value)
+{
+    uint8_t accepted = HTTPSERVER_ENCODING_IDENTITY;
+    uint8_t coding;
+
+    while (*value != '\0')
+    {
+        while ((*value == ' ') || (*value == ','))
+            value++;
+
+        if (HttpServer_compareNoCase(value,"gzip",4))
+            coding = HTTPSERVER_ENCODING_GZIP;
+        else if (HttpServer_compareNoCase(value,"deflate",7))
+            coding = HTTPSERVER_ENCODING_DEFLATE;
+        else
+            coding = HTTPSERVER_ENCODING_IDENTITY;
+
+        // Move to the parameters of the coding
+        while ((*value != '\0') && (*value != ',') && (*value != ';'))
+            value++;
+        while (*value == ';')
+        {
+            value++;
+            while (*value == ' ')
+                value++;
+            // Quality zero means not acceptable
+            if (HttpServer_compareNoCase(value,"q=0",3) &&
+                (strspn(&value[3],".0") == strcspn(&value[3],",;")))
+            {
+                coding = HTTPSERVER_ENCODING_IDENTITY;
+            }
+            while ((*value != '\0') && (*value != ',') && (*value != ';'))
+                value++;
+        }
+
+        accepted |= coding;
+    }
+    return accepted;
+}
+
+static HttpServer_Error HttpServer_getLine (HttpServer_DeviceHandle dev,
+                                            uint8_t client,
+                                            uint16_t* budget,
+                                            int16_t* received)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    int16_t available = 0;
+    uint16_t i = c->rxIndex;
+    *received = -1; // Default
+
+    EthernetServerSocket_available(dev->socketNumber,client,&available);
+    if (available > *budget)
+        available = *budget;
+    HTTPSERVER_METRICS_ADD(dev,bytesIn,available);
+
+    while (available > 0)
+    {
+        EthernetServerSocket_read(dev->socketNumber,client,&c->rxBuffer[i]);
+        available--;
+        (*budget)--;
+
+        if (c->rxBuffer[i] == '\n')
+        {
+            // The remaining bytes are counted by the next call
+            HTTPSERVER_METRICS_ADD(dev,bytesIn,-(uint32_t)available);
+            // \r\n characters are not counted
+            if ((i > 0) && (c->rxBuffer[i-1] == '\r')) i--;
+            c->rxBuffer[i] = '\0';
+            c->rxIndex = 0;
+
+            // Empty line
+            if (i == 0)
+            {
+                *received = -2;
+                return HTTPSERVER_ERROR_OK_EMPTYLINE;
+            }
+
+            *received = i;
+            return HTTPSERVER_ERROR_OK;
+        }
+
+        i++;
+        if (i >= HTTPSERVER_RX_BUFFER_DIMENSION)
+        {
+            HTTPSERVER_TRACE(HTTPSERVER_TRACE_LINE_TOO_LONG,client,c->state,i);
+            c->rxIndex = 0;
+            HTTPSERVER_METRICS_ADD(dev,bytesIn,-(uint32_t)available);
+            return HTTPSERVER_ERROR_LINE_TOO_LONG;
+        }
+    }
+
+    // Wait for the rest of the line
+    c->rxIndex = i;
+    return HTTPSERVER_ERROR_IN_PROGRESS;
+}
+
+
+static HttpServer_Error HttpServer_parseRequest (HttpServer_DeviceHandle dev,
+                                                   char* buffer,
+                                                   uint16_t length,
+                                                   uint8_t client)
+{
+    char* arg = buffer;
+    uint8_t numArgs = 0;
+
+    // The line is terminated with '\0': increase the length to detect and
+    // parse the last argument
+    length++;
+
+    if (client >= ETHERNET_MAX_LISTEN_CLIENT)
+        return HTTPSERVER_ERROR_WRONG_CLIENT_NUMBER;
+
+    for (uint16_t i = 0; i < length; ++i)
+    {
+        if ((buffer[i] == ' ') || (buffer[i] == 0))
+        {
+            // The argument is terminated in place
+            buffer[i] = 0;
+            if (numArgs == 0) // Choose request type
+            {
+                if (strcmp(arg,HTTPSERVER_STRING_REQUEST_GET) == 0)
+                {
+                    dev->clients[client].message.request = HTTPSERVER_REQUEST_GET;
+                }
+                else if (strcmp(arg,HTTPSERVER_STRING_REQUEST_POST) == 0)
+                {
                     dev->clients[client].message.request = HTTPSERVER_REQUEST_POST;
                 }
                 else
@@ -455,22 +1095,16 @@ static HttpServer_Error HttpServer_parseRequest (HttpServer_DeviceHandle dev,
             }
             else if (numArgs == 1) // Uri
             {
-                if( strlen(tmp) < HTTPSERVER_MAX_URI_LENGTH)
+                if( strlen(arg) < HTTPSERVER_MAX_URI_LENGTH)
                 {
-                    strcpy(dev->clients[client].message.uri,tmp);
+                    strcpy(dev->clients[client].message.uri,arg);
                 }
 
                 else
                 {
-#ifdef OHILAB_HTTPSERVER_DEBUG
-                    Cli_sendMessage("HttpServer_parseFirstLine: ",
-                                    "URI too long",
-                                    CLI_MESSAGETYPE_INFO);
-
-#endif
                     HttpServer_sendResponse(dev,
                                           HTTPSERVER_RESPONSECODE_REQUESTURITOOLARGE,
-                                          "Content-Length: 0\r\nServer: OHILab\r\n\n\r",
+                                          "Content-Length: 0\r\nServer: " HTTPSERVER_SERVER_NAME,
                                           "",
                                           client);
                     return HTTPSERVER_ERROR_URI_TOO_LONG;
@@ -479,11 +1113,11 @@ static HttpServer_Error HttpServer_parseRequest (HttpServer_DeviceHandle dev,
             }
             else if (numArgs == 2) // HTTP Version
             {
-                if (strcmp(tmp,HTTPSERVER_STRING_VERSION_1_0) == 0)
+                if (strcmp(arg,HTTPSERVER_STRING_VERSION_1_0) == 0)
                 {
                 	dev->clients[client].message.version = HTTPSERVER_VERSION_1_0;
                 }
-                else if (strcmp(tmp,HTTPSERVER_STRING_VERSION_1_1) == 0)
+                else if (strcmp(arg,HTTPSERVER_STRING_VERSION_1_1) == 0)
                 {
                 	dev->clients[client].message.version = HTTPSERVER_VERSION_1_1;
                 }
@@ -496,53 +1130,588 @@ static HttpServer_Error HttpServer_parseRequest (HttpServer_DeviceHandle dev,
             {
                 return HTTPSERVER_ERROR_WRONG_REQUEST_FORMAT;
             }
-            // Reset counter for the next argument
-            argCounter = 0;
+            // Move to the next argument
+            arg = &buffer[i + 1];
             // Increment argument numbers
             numArgs++;
-            continue;
         }
-        tmp[argCounter] = buffer[i];
-        argCounter++;
     }
     return HTTPSERVER_ERROR_OK;
 }
 
+void HttpServer_txStatus (HttpServer_DeviceHandle dev,
+                          HttpServer_ResponseCode code,
+                          uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+
+    //Add to the buffer the HTTP version
+    HttpServer_txAppend(dev,client,"HTTP/1.1 ",9);
+    //Add to the Buffer the response Code
+    HttpServer_txAppend(dev,
+                        client,
+                        &HttpServer_responseCode[code][0],
+                        strlen(HttpServer_responseCode[code]));
+    //Add to the buffer the end line
+    HttpServer_txAppend(dev,client,"\r\n",2);
+
+    // The staged bytes are sent by HttpServer_poll, one quantum for each pass,
+    // then the connection is closed
+    c->state = HTTPSERVER_CLIENTSTATE_RESPONSE;
+    c->txFlags = 0;
+    c->lastTick = HttpServer_currentTick();
+    HTTPSERVER_METRICS_INC(dev,responses[HttpServer_responseCode[code][0] - '1']);
+    HTTPSERVER_TRACE(HTTPSERVER_TRACE_RESPONSE,client,code,c->txLength);
+#if (HTTPSERVER_METRICS == 1)
+    c->phaseTick = c->lastTick;
+#endif
+}
+
 void HttpServer_sendResponse(HttpServer_DeviceHandle dev,
                              HttpServer_ResponseCode code,
                              char* headers,
                              char* body,
                              uint8_t client)
 {
-    uint8_t bufferLength = 0;
-    uint8_t bufferResponseCodeLenght = 0;
-    uint16_t wrote = 0;
-    //Add to the buffer the HTTP versionf
-    sprintf(dev->clients[client].txBuffer,"HTTP/1.1 ");
-    bufferLength = strlen(dev->clients[client].txBuffer);
-    //Add to the Buffer the response Code
-    bufferResponseCodeLenght = strlen(HttpServer_responseCode[code]);
-    strncpy(&dev->clients[client].txBuffer[bufferLength],
-            &HttpServer_responseCode[code][0],
-            bufferResponseCodeLenght);
-    //Add to the buffer the end line
-    strncpy(&dev->clients[client].txBuffer[strlen(dev->clients[client].txBuffer)],
-            "\r\n",
-            2);
+    HttpServer_txStatus(dev,code,client);
     //Add to the buffer the headers
-    strncpy(&dev->clients[client].txBuffer[strlen(dev->clients[client].txBuffer)],
-            headers,
-            strlen(headers));
-    strncpy(&dev->clients[client].txBuffer[strlen(dev->clients[client].txBuffer)],
-            "\r\n\r\n",
-            4);
+    HttpServer_txAppend(dev,client,headers,strlen(headers));
+    HttpServer_txAppend(dev,client,"\r\n\r\n",4);
     //Add to the buffer the body
-    strncpy(&dev->clients[client].txBuffer[strlen(dev->clients[client].txBuffer)],
-            body,
-            strlen(body));
-    EthernetServerSocket_writeBytes(dev->socketNumber,
-                                    client,
-                                    dev->clients[client].txBuffer,
-                                    strlen(dev->clients[client].txBuffer),
-                                    &wrote);
+    HttpServer_txAppend(dev,client,body,strlen(body));
+
+    dev->clients[client].txFlags = HTTPSERVER_TXFLAGS_END;
+}
+
+#if (HTTPSERVER_COMPRESSION == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function checks if the response can be compressed: the content must
+ * not be encoded yet and its type must not be an already compressed one.
+ *@param[in] headers The response headers
+ *@return true if the response can be compressed
+ */
+static bool HttpServer_isCompressible (const char* headers)
+{
+    static const char* const compressedTypes[] =
+    {
+        "image/png", "image/jpeg", "image/gif", "image/webp",
+        "audio/", "video/", "font/woff",
+        "application/zip", "application/gzip", "application/x-gzip",
+        "application/octet-stream",
+    };
+    const char* type;
+
+    if (HttpServer_findHeader(headers,"Content-Encoding") != NULL)
+        return false;
+
+    type = HttpServer_findHeader(headers,"Content-Type");
+    if (type == NULL)
+        return true;
+
+    for (uint8_t i = 0; i < (sizeof(compressedTypes) / sizeof(compressedTypes[0])); ++i)
+    {
+        if (HttpServer_compareNoCase(type,compressedTypes[i],strlen(compressedTypes[i])))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @ingroup httpServer_functions
+ * This function terminates the headers of a compressed response and sends
+ * the collected window through the encoder.
+ *@param server The server pointer which you have previously definited
+ *@param client The client number
+ */
+static void HttpServer_startCompression (HttpServer_DeviceHandle dev,
+                                         uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+
+    if (dev->deflate.format == HTTPSERVER_ENCODING_GZIP)
+        HttpServer_txAppend(dev,client,"Content-Encoding: gzip\r\n",24);
+    else
+        HttpServer_txAppend(dev,client,"Content-Encoding: deflate\r\n",27);
+    HttpServer_txAppend(dev,client,"Vary: Accept-Encoding\r\n",23);
+    if (c->message.version == HTTPSERVER_VERSION_1_1)
+    {
+        HttpServer_txAppend(dev,client,"Transfer-Encoding: chunked\r\n",28);
+        c->txFlags |= HTTPSERVER_TXFLAGS_CHUNKED;
+    }
+    HttpServer_txAppend(dev,client,"\r\n",2);
+
+    c->txFlags &= ~HTTPSERVER_TXFLAGS_PENDING;
+    c->txFlags |= HTTPSERVER_TXFLAGS_DEFLATE;
+    HttpServer_deflateStart(dev);
+}
+#endif
+
+void HttpServer_startResponse (HttpServer_DeviceHandle dev,
+                               HttpServer_ResponseCode code,
+                               const char* headers,
+                               uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    uint16_t length = (headers != NULL) ? strlen(headers) : 0;
+
+    HttpServer_txStatus(dev,code,client);
+    if (length > 0)
+    {
+        HttpServer_txAppend(dev,client,headers,length);
+        HttpServer_txAppend(dev,client,"\r\n",2);
+    }
+
+#if (HTTPSERVER_COMPRESSION == 1)
+    // The body is collected until it is clear that it is worth compressing
+    if ((c->message.acceptEncoding != HTTPSERVER_ENCODING_IDENTITY) &&
+        ((length == 0) || HttpServer_isCompressible(headers)) &&
+        HttpServer_deflateAcquire(dev,
+                                  client,
+                                  (c->message.acceptEncoding & HTTPSERVER_ENCODING_GZIP) ?
+                                      HTTPSERVER_ENCODING_GZIP :
+                                      HTTPSERVER_ENCODING_DEFLATE))
+    {
+        c->txFlags = HTTPSERVER_TXFLAGS_PENDING;
+        return;
+    }
+#endif
+
+    // The end of the body is marked by the last chunk or, for HTTP/1.0, by
+    // the connection close
+    if (c->message.version == HTTPSERVER_VERSION_1_1)
+    {
+        HttpServer_txAppend(dev,client,"Transfer-Encoding: chunked\r\n",28);
+        c->txFlags = HTTPSERVER_TXFLAGS_CHUNKED;
+    }
+    HttpServer_txAppend(dev,client,"\r\n",2);
+}
+
+void HttpServer_writeResponse (HttpServer_DeviceHandle dev,
+                               const uint8_t* data,
+                               uint16_t length,
+                               uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+
+    if ((c->state != HTTPSERVER_CLIENTSTATE_RESPONSE) || c->txAborted)
+        return;
+
+#if (HTTPSERVER_COMPRESSION == 1)
+    if (c->txFlags & HTTPSERVER_TXFLAGS_PENDING)
+    {
+        uint16_t size = HTTPSERVER_COMPRESSION_MIN_LENGTH - dev->deflate.length;
+
+        if (size > length)
+            size = length;
+        HttpServer_deflateWrite(dev,data,size);
+        data += size;
+        length -= size;
+
+        if (dev->deflate.length < HTTPSERVER_COMPRESSION_MIN_LENGTH)
+            return;
+        HttpServer_startCompression(dev,client);
+    }
+
+    if (c->txFlags & HTTPSERVER_TXFLAGS_DEFLATE)
+    {
+        HttpServer_deflateWrite(dev,data,length);
+        return;
+    }
+#endif
+
+    HttpServer_txBody(dev,client,data,length);
+}
+
+void HttpServer_endResponse (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    char buffer[HTTPSERVER_INTEGER_MAX_LENGTH];
+
+    if ((c->state != HTTPSERVER_CLIENTSTATE_RESPONSE) || c->txAborted)
+        return;
+
+#if (HTTPSERVER_COMPRESSION == 1)
+    if (c->txFlags & HTTPSERVER_TXFLAGS_PENDING)
+    {
+        // Too short to be compressed: send it with its length
+        HttpServer_txAppend(dev,client,"Content-Length: ",16);
+        HttpServer_txAppend(dev,
+                            client,
+                            buffer,
+                            HttpServer_formatInteger(buffer,dev->deflate.length));
+        HttpServer_txAppend(dev,client,"\r\n\r\n",4);
+        HttpServer_txAppend(dev,client,(char*)dev->deflate.window,dev->deflate.length);
+        c->txFlags = 0;
+        HttpServer_deflateRelease(dev,client);
+    }
+    else if (c->txFlags & HTTPSERVER_TXFLAGS_DEFLATE)
+    {
+        HttpServer_deflateFinish(dev);
+        HttpServer_deflateRelease(dev,client);
+    }
+#else
+    (void)buffer;
+#endif
+
+    if (c->txFlags & HTTPSERVER_TXFLAGS_CHUNKED)
+    {
+        HttpServer_txCloseChunk(dev,client);
+        // The last chunk
+        HttpServer_txAppend(dev,client,"0\r\n\r\n",5);
+    }
+
+    c->txFlags = HTTPSERVER_TXFLAGS_END;
+    c->lastTick = HttpServer_currentTick();
+}
+
+void HttpServer_continueResponse (HttpServer_DeviceHandle dev,
+                                  void (*producer)(void* context, uint8_t client),
+                                  void* context,
+                                  uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+
+    if ((c->state != HTTPSERVER_CLIENTSTATE_RESPONSE) || (c->txFlags & HTTPSERVER_TXFLAGS_END))
+        return;
+
+    c->producer = producer;
+    c->producerContext = context;
+}
+
+static void HttpServer_producerFill (HttpServer_DeviceHandle dev,
+                                     uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    bool progress = true;
+
+    while (progress && (c->txLength <= (HTTPSERVER_TX_BUFFER_DIMENSION / 2)))
+    {
+        uint16_t length = c->txLength;
+#if (HTTPSERVER_COMPRESSION == 1)
+        uint16_t collected = dev->deflate.length;
+#endif
+
+        c->producer(c->producerContext,client);
+        if (c->txFlags & HTTPSERVER_TXFLAGS_END)
+        {
+            c->producer = NULL;
+            return;
+        }
+
+        progress = (c->txLength != length);
+#if (HTTPSERVER_COMPRESSION == 1)
+        // The body which is compressed is collected by the encoder first
+        progress = progress || (dev->deflate.length != collected);
+#endif
+    }
+}
+
+void HttpServer_txAppend (HttpServer_DeviceHandle dev,
+                          uint8_t client,
+                          const char* data,
+                          uint16_t length)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    uint16_t size;
+
+    while ((length > 0) && !c->txAborted)
+    {
+        // The buffer is full: send the staged data before continue
+        if ((c->txLength == HTTPSERVER_TX_BUFFER_DIMENSION) &&
+            !HttpServer_txFlush(dev,client))
+        {
+            return;
+        }
+
+        size = HTTPSERVER_TX_BUFFER_DIMENSION - c->txLength;
+        if (size > length)
+            size = length;
+
+        memcpy(&c->txBuffer[c->txLength],data,size);
+        c->txLength += size;
+        data += size;
+        length -= size;
+    }
 }
+
+bool HttpServer_txFlush (HttpServer_DeviceHandle dev, uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    uint32_t startTick = HttpServer_currentTick();
+
+    while (c->txLength != 0)
+    {
+        if (!EthernetServerSocket_isConnected(dev->socketNumber,client) ||
+            ((uint32_t)(HttpServer_currentTick() - startTick) >= HTTPSERVER_POLL_QUANTUM_TICKS))
+        {
+            c->txAborted = true;
+            return false;
+        }
+        HttpServer_txDrain(dev,client,HTTPSERVER_TX_BUFFER_DIMENSION);
+    }
+    return true;
+}
+
+#if (HTTPSERVER_GENERATOR == 1)
+void HttpServer_txGenerate (HttpServer_DeviceHandle dev,
+                            uint8_t client,
+                            HttpServer_Generator generator,
+                            uint32_t step,
+                            uint32_t end)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+
+    c->generator = generator;
+    c->generatorStep = step;
+    c->generatorEnd = end;
+    c->txFlags = 0;
+    c->lastTick = HttpServer_currentTick();
+}
+
+static void HttpServer_generatorFill (HttpServer_DeviceHandle dev,
+                                      uint8_t client)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    char line[HTTPSERVER_GENERATOR_LINE_LENGTH];
+    uint8_t length = 0;
+
+    while (c->generatorStep != c->generatorEnd)
+    {
+        length = c->generator(dev,client,line);
+        // A line which doesn't fit is written again with the next poll
+        if ((length == 0) || (length > (HTTPSERVER_TX_BUFFER_DIMENSION - c->txLength)))
+            break;
+
+        memcpy(&c->txBuffer[c->txLength],line,length);
+        c->txLength += length;
+        c->generatorStep++;
+    }
+
+    if ((c->generatorStep == c->generatorEnd) || (length == 0))
+    {
+        c->generator = NULL;
+        c->txFlags = HTTPSERVER_TXFLAGS_END;
+    }
+}
+#endif
+
+/**
+ * @ingroup httpServer_functions
+ * Room reserved for the chunk size: 4 hex digits and \r\n.
+ */
+#define HTTPSERVER_CHUNK_HEADER_LENGTH     6
+
+static void HttpServer_txCloseChunk (HttpServer_DeviceHandle dev,
+                                     uint8_t client)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    HttpServer_ClientHandle c = &dev->clients[client];
+    uint16_t size;
+    char* header;
+
+    if (!(c->txFlags & HTTPSERVER_TXFLAGS_CHUNK_OPEN))
+        return;
+    c->txFlags &= ~HTTPSERVER_TXFLAGS_CHUNK_OPEN;
+
+    size = c->txLength - c->txChunk - HTTPSERVER_CHUNK_HEADER_LENGTH;
+    // An empty chunk would be the last one: remove it
+    if (size == 0)
+    {
+        c->txLength = c->txChunk;
+        return;
+    }
+
+    header = (char*)&c->txBuffer[c->txChunk];
+    for (uint8_t i = 0; i < 4; ++i)
+        header[i] = hex[(size >> (12 - 4 * i)) & 0x0F];
+    header[4] = '\r';
+    header[5] = '\n';
+    c->txBuffer[c->txLength++] = '\r';
+    c->txBuffer[c->txLength++] = '\n';
+}
+
+void HttpServer_txBody (HttpServer_DeviceHandle dev,
+                        uint8_t client,
+                        const uint8_t* data,
+                        uint16_t length)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    uint16_t size;
+
+    if (!(c->txFlags & HTTPSERVER_TXFLAGS_CHUNKED))
+    {
+        HttpServer_txAppend(dev,client,(const char*)data,length);
+        return;
+    }
+
+    while ((length > 0) && !c->txAborted)
+    {
+        if (!(c->txFlags & HTTPSERVER_TXFLAGS_CHUNK_OPEN))
+        {
+            // Room for the chunk header, one byte and the chunk end line
+            if (((c->txLength + HTTPSERVER_CHUNK_HEADER_LENGTH + 3) > HTTPSERVER_TX_BUFFER_DIMENSION) &&
+                !HttpServer_txFlush(dev,client))
+            {
+                return;
+            }
+            c->txChunk = c->txLength;
+            c->txLength += HTTPSERVER_CHUNK_HEADER_LENGTH;
+            c->txFlags |= HTTPSERVER_TXFLAGS_CHUNK_OPEN;
+        }
+
+        // Keep the room for the chunk end line
+        size = HTTPSERVER_TX_BUFFER_DIMENSION - 2 - c->txLength;
+        if (size > length)
+            size = length;
+
+        memcpy(&c->txBuffer[c->txLength],data,size);
+        c->txLength += size;
+        data += size;
+        length -= size;
+
+        if (c->txLength == (HTTPSERVER_TX_BUFFER_DIMENSION - 2))
+        {
+            HttpServer_txCloseChunk(dev,client);
+            if (!HttpServer_txFlush(dev,client))
+                return;
+        }
+    }
+}
+
+uint16_t HttpServer_txDrain (HttpServer_DeviceHandle dev,
+                             uint8_t client,
+                             uint16_t limit)
+{
+    HttpServer_ClientHandle c = &dev->clients[client];
+    uint16_t wrote = 0;
+    uint16_t size = c->txLength - c->txSent;
+
+#if (HTTPSERVER_HTTP2 == 1)
+    // The response is sent as frames of the current stream
+    if (dev->http2.client == client)
+        return HttpServer_http2Drain(dev,client,limit);
+#endif
+
+    // The open chunk can't be sent until its size is known
+    if (c->txFlags & HTTPSERVER_TXFLAGS_CHUNK_OPEN)
+        size = c->txChunk - c->txSent;
+
+    if (size > limit)
+        size = limit;
+
+    if (size > 0)
+    {
+        EthernetServerSocket_writeBytes(dev->socketNumber,
+                                        client,
+                                        &c->txBuffer[c->txSent],
+                                        size,
+                                        &wrote);
+        c->txSent += wrote;
+        HTTPSERVER_METRICS_ADD(dev,bytesOut,wrote);
+    }
+
+    // All staged bytes are sent, the buffer can be reused
+    if (c->txSent == c->txLength)
+    {
+        c->txLength = 0;
+        c->txSent = 0;
+    }
+    return wrote;
+}
+
+bool HttpServer_parseNumber (const char** text, uint32_t* value)
+{
+    const char* p = *text;
+
+    *value = 0;
+    while ((*p >= '0') && (*p <= '9'))
+    {
+        if (*value > ((0xFFFFFFFFu - 9) / 10))
+            return false;
+        *value = (*value * 10) + (*p - '0');
+        p++;
+    }
+
+    if (p == *text)
+        return false;
+    *text = p;
+    return true;
+}
+
+uint8_t HttpServer_formatInteger (char* buffer, uint32_t value)
+{
+    char digits[HTTPSERVER_INTEGER_MAX_LENGTH];
+    uint8_t length = 0;
+    uint8_t i = 0;
+
+    do
+    {
+        digits[length++] = '0' + (value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    // Digits are computed from the less significant one
+    while (length > 0)
+        buffer[i++] = digits[--length];
+
+    return i;
+}
+
+bool HttpServer_compareNoCase (const char* a, const char* b, uint16_t length)
+{
+    for (uint16_t i = 0; i < length; ++i)
+    {
+        char ca = a[i], cb = b[i];
+
+        if ((ca >= 'A') && (ca <= 'Z')) ca += 'a' - 'A';
+        if ((cb >= 'A') && (cb <= 'Z')) cb += 'a' - 'A';
+        if (ca != cb)
+            return false;
+        // Both strings are terminated
+        if (ca == '\0')
+            return true;
+    }
+    return true;
+}
+
+const char* HttpServer_findHeader (const char* headers, const char* name)
+{
+    uint16_t length = strlen(name);
+    const char* line = headers;
+
+    while ((line != NULL) && (*line != '\0'))
+    {
+        if (HttpServer_compareNoCase(line,name,length) && (line[length] == ':'))
+        {
+            line += length + 1;
+            while ((*line == ' ') || (*line == '\t'))
+                line++;
+            return line;
+        }
+
+        line = strstr(line,"\r\n");
+        if (line != NULL)
+            line += 2;
+    }
+    return NULL;
+}
+
+#if (HTTPSERVER_ARENA == 1)
+void* HttpServer_arenaAlloc (HttpServer_MessageHandle message, uint16_t size)
+{
+    HttpServer_Arena* arena = &message->arena;
+    uint8_t* block;
+
+    // Keep the next block word aligned
+    size = (size + 3) & ~3u;
+    if ((size == 0) || (size > (HTTPSERVER_ARENA_DIMENSION - arena->used)))
+        return NULL;
+
+    block = (uint8_t*)arena->buffer + arena->used;
+    arena->used += size;
+    if (arena->used > arena->peak)
+        arena->peak = arena->used;
+    return block;
+}
+#endif
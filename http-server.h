@@ -238,6 +238,9 @@
 #include "board.h"
 #endif
 
+// Defaults of the selected configuration profile
+#include "http-server-profile.h"
+
 /**
  * @defgroup httpServer_functions HTTP server functions
  * The HTTP server function group
@@ -296,6 +299,477 @@
 #define HTTPSERVER_TIMEOUT                  3000
 #endif
 
+/**
+ * @ingroup httpServer_macros
+ * The product name sent into the Server header of the responses.
+ */
+#ifndef HTTPSERVER_SERVER_NAME
+#define HTTPSERVER_SERVER_NAME              "OHILab"
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to keep the connection open after the responses sent with
+ * @ref HttpServer_sendBuiltResponse , when the client allows it.
+ */
+#ifndef HTTPSERVER_KEEPALIVE
+#define HTTPSERVER_KEEPALIVE                1
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Ticks a kept-alive connection waits for the next request: it is shorter
+ * than @ref HTTPSERVER_TIMEOUT because an idle connection holds a slot.
+ */
+#ifndef HTTPSERVER_KEEPALIVE_TIMEOUT
+#define HTTPSERVER_KEEPALIVE_TIMEOUT        1000
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Max number of requests served on a connection, between 1 and 255.
+ */
+#ifndef HTTPSERVER_KEEPALIVE_MAX_REQUESTS
+#define HTTPSERVER_KEEPALIVE_MAX_REQUESTS   100
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to send response bodies from buffers owned by the application,
+ * see @ref HttpServer_sendBorrowed .
+ */
+#ifndef HTTPSERVER_BORROWED
+#define HTTPSERVER_BORROWED                 1
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to coalesce the small writes of a response into full segments,
+ * see @ref HttpServer_cork . The end of a kept-alive response waits for the
+ * response of the next pipelined request too.
+ */
+#ifndef HTTPSERVER_CORK
+#define HTTPSERVER_CORK                     1
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Number of staged bytes sent at once by a corked response, one TCP
+ * segment on Ethernet. It can't be greater than the transmission buffer:
+ * with a smaller buffer a corked response is sent when the buffer is full,
+ * so the segments are as big as the buffer.
+ */
+#ifndef HTTPSERVER_CORK_SEGMENT
+#if (HTTPSERVER_TX_BUFFER_DIMENSION < 1460)
+#define HTTPSERVER_CORK_SEGMENT             HTTPSERVER_TX_BUFFER_DIMENSION
+#else
+#define HTTPSERVER_CORK_SEGMENT             1460
+#endif
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Ticks a corked response keeps less than a segment before sending it.
+ */
+#ifndef HTTPSERVER_CORK_TICKS
+#define HTTPSERVER_CORK_TICKS               200
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to give each request a scratch memory, see
+ * @ref HttpServer_arenaAlloc .
+ */
+#ifndef HTTPSERVER_ARENA
+#define HTTPSERVER_ARENA                    1
+#endif
+/**
+ * @ingroup httpServer_macros
+ * The dimension of the scratch memory of each @ref HttpServer_Client, a
+ * multiple of 4.
+ */
+#ifndef HTTPSERVER_ARENA_DIMENSION
+#define HTTPSERVER_ARENA_DIMENSION          512
+#endif
+
+/**
+ * @ingroup httpServer_macros
+ * The max number of bytes received or transmitted for each
+ * @ref HttpServer_Client during a single @ref HttpServer_poll pass.
+ */
+#ifndef HTTPSERVER_POLL_QUANTUM_BYTES
+#define HTTPSERVER_POLL_QUANTUM_BYTES       128
+#endif
+/**
+ * @ingroup httpServer_macros
+ * The max number of ticks spent on each @ref HttpServer_Client during a
+ * single @ref HttpServer_poll pass (request handler execution excluded).
+ */
+#ifndef HTTPSERVER_POLL_QUANTUM_TICKS
+#define HTTPSERVER_POLL_QUANTUM_TICKS       2
+#endif
+
+/**
+ * @ingroup httpServer_macros
+ * Number of served clients above which the new connections are refused with
+ * a 503 Service Unavailable response. By default one slot is kept free to
+ * refuse the connections quickly.
+ */
+#ifndef HTTPSERVER_OVERLOAD_CLIENTS
+#if ETHERNET_MAX_LISTEN_CLIENT > 1
+#define HTTPSERVER_OVERLOAD_CLIENTS         (ETHERNET_MAX_LISTEN_CLIENT - 1)
+#else
+#define HTTPSERVER_OVERLOAD_CLIENTS         ETHERNET_MAX_LISTEN_CLIENT
+#endif
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Smoothed request handler execution time, in ticks, above which the new
+ * connections are refused with a 503 Service Unavailable response.
+ * 0 disables the check.
+ */
+#ifndef HTTPSERVER_OVERLOAD_LATENCY
+#define HTTPSERVER_OVERLOAD_LATENCY         0
+#endif
+/**
+ * @ingroup httpServer_macros
+ * The value, in seconds, of the Retry-After header sent to refused clients.
+ */
+#ifndef HTTPSERVER_OVERLOAD_RETRY_AFTER
+#define HTTPSERVER_OVERLOAD_RETRY_AFTER     "1"
+#endif
+
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to limit the connections and the requests of each peer address
+ * with token buckets. The limits are enforced when the
+ * @ref addressCallback is set.
+ */
+#ifndef HTTPSERVER_RATELIMIT
+#define HTTPSERVER_RATELIMIT                1
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Number of peer addresses which are tracked, a power of two. When the
+ * table is full the address used least recently is forgotten.
+ */
+#ifndef HTTPSERVER_RATELIMIT_ENTRIES
+#define HTTPSERVER_RATELIMIT_ENTRIES        16
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Number of entries where an address can be stored, starting from its hash.
+ */
+#ifndef HTTPSERVER_RATELIMIT_PROBES
+#define HTTPSERVER_RATELIMIT_PROBES         4
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Max number of clients served at the same time for each peer address.
+ */
+#ifndef HTTPSERVER_RATELIMIT_CLIENTS
+#define HTTPSERVER_RATELIMIT_CLIENTS        ((ETHERNET_MAX_LISTEN_CLIENT + 1) / 2)
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Ticks to earn a new connection, and connections which can be opened in a
+ * burst, for each peer address.
+ */
+#ifndef HTTPSERVER_RATELIMIT_CONNECTION_TICKS
+#define HTTPSERVER_RATELIMIT_CONNECTION_TICKS 200
+#endif
+#ifndef HTTPSERVER_RATELIMIT_CONNECTION_BURST
+#define HTTPSERVER_RATELIMIT_CONNECTION_BURST 10
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Ticks to earn a new request, and requests which can be sent in a burst,
+ * for each peer address.
+ */
+#ifndef HTTPSERVER_RATELIMIT_REQUEST_TICKS
+#define HTTPSERVER_RATELIMIT_REQUEST_TICKS  50
+#endif
+#ifndef HTTPSERVER_RATELIMIT_REQUEST_BURST
+#define HTTPSERVER_RATELIMIT_REQUEST_BURST  20
+#endif
+/**
+ * @ingroup httpServer_macros
+ * The value, in seconds, of the Retry-After header sent to limited clients.
+ */
+#ifndef HTTPSERVER_RATELIMIT_RETRY_AFTER
+#define HTTPSERVER_RATELIMIT_RETRY_AFTER    "1"
+#endif
+
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to compress the streamed responses (see
+ * @ref HttpServer_startResponse ) when the client accepts gzip or deflate
+ * encoding.
+ */
+#ifndef HTTPSERVER_COMPRESSION
+#define HTTPSERVER_COMPRESSION              1
+#endif
+/**
+ * @ingroup httpServer_macros
+ * The compression window in bytes: the body is compressed in blocks of this
+ * dimension and matches are searched only inside each block.
+ * The max value is 32768.
+ */
+#ifndef HTTPSERVER_COMPRESSION_WINDOW
+#define HTTPSERVER_COMPRESSION_WINDOW       1024
+#endif
+/**
+ * @ingroup httpServer_macros
+ * The compression hash table has 2^HTTPSERVER_COMPRESSION_HASH_BITS entries
+ * of 16 bits.
+ */
+#ifndef HTTPSERVER_COMPRESSION_HASH_BITS
+#define HTTPSERVER_COMPRESSION_HASH_BITS    8
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Bodies shorter than this number of bytes are sent uncompressed, with
+ * Content-Length. It MUST NOT be greater than
+ * @ref HTTPSERVER_COMPRESSION_WINDOW .
+ */
+#ifndef HTTPSERVER_COMPRESSION_MIN_LENGTH
+#define HTTPSERVER_COMPRESSION_MIN_LENGTH   256
+#endif
+
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to accept the WebSocket upgrade of the connections (RFC 6455),
+ * see @ref websocketCallback .
+ */
+#ifndef HTTPSERVER_WEBSOCKET
+#define HTTPSERVER_WEBSOCKET                1
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Ticks between two ping frames sent by the server on an idle WebSocket
+ * connection.
+ */
+#ifndef HTTPSERVER_WEBSOCKET_PING_PERIOD
+#define HTTPSERVER_WEBSOCKET_PING_PERIOD    10000
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Ticks without any frame from the client after which a WebSocket
+ * connection is closed.
+ */
+#ifndef HTTPSERVER_WEBSOCKET_TIMEOUT
+#define HTTPSERVER_WEBSOCKET_TIMEOUT        (3 * HTTPSERVER_WEBSOCKET_PING_PERIOD)
+#endif
+
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to enable the Server-Sent Events streams, see
+ * @ref HttpServer_sseStart .
+ */
+#ifndef HTTPSERVER_SSE
+#define HTTPSERVER_SSE                      1
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Dimension of the events ring buffer shared by all subscribers, it must be
+ * a power of two. A subscriber which falls behind more than this is closed.
+ */
+#ifndef HTTPSERVER_SSE_BUFFER_DIMENSION
+#define HTTPSERVER_SSE_BUFFER_DIMENSION     512
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Ticks without events after which a heartbeat comment is sent to the
+ * subscribers, to keep alive the connections through the proxies.
+ */
+#ifndef HTTPSERVER_SSE_HEARTBEAT
+#define HTTPSERVER_SSE_HEARTBEAT            15000
+#endif
+
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to serve byte ranges (Range and If-Range headers) of the
+ * responses sent with @ref HttpServer_sendResource .
+ */
+#ifndef HTTPSERVER_RANGE
+#define HTTPSERVER_RANGE                    1
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Max length of the stored If-Range value: a longer validator never
+ * matches, so the whole resource is sent.
+ */
+#ifndef HTTPSERVER_RANGE_VALIDATOR_LENGTH
+#define HTTPSERVER_RANGE_VALIDATOR_LENGTH   32
+#endif
+
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to receive request bodies into an application sink, see
+ * @ref HttpServer_startUpload .
+ */
+#ifndef HTTPSERVER_UPLOAD
+#define HTTPSERVER_UPLOAD                   1
+#endif
+
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to parse multipart/form-data uploads, see
+ * @ref HttpServer_startMultipart . It needs @ref HTTPSERVER_UPLOAD , and it
+ * follows it by default.
+ */
+#ifndef HTTPSERVER_MULTIPART
+#define HTTPSERVER_MULTIPART                HTTPSERVER_UPLOAD
+#endif
+#if (HTTPSERVER_MULTIPART == 1) && (HTTPSERVER_UPLOAD != 1)
+#error "HTTPSERVER_MULTIPART needs HTTPSERVER_UPLOAD"
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Max length of the multipart boundary, 70 characters for RFC 2046.
+ */
+#ifndef HTTPSERVER_MULTIPART_BOUNDARY_LENGTH
+#define HTTPSERVER_MULTIPART_BOUNDARY_LENGTH 70
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Dimension of the buffer for the headers of a part: the longer headers
+ * are truncated.
+ */
+#ifndef HTTPSERVER_MULTIPART_HEADERS_LENGTH
+#define HTTPSERVER_MULTIPART_HEADERS_LENGTH 160
+#endif
+
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to enable the streaming JSON writer, see
+ * @ref HttpServer_jsonStart .
+ */
+#ifndef HTTPSERVER_JSON
+#define HTTPSERVER_JSON                     1
+#endif
+
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to serve HTTP/2 over cleartext (RFC 9113), with prior knowledge
+ * or with the upgrade of an HTTP/1.1 request. The streams of a connection
+ * are performed by the same handlers of HTTP/1.1, one at a time. Only one
+ * connection of the server can use HTTP/2.
+ */
+#ifndef HTTPSERVER_HTTP2
+#define HTTPSERVER_HTTP2                    0
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Max number of concurrent streams of the HTTP/2 connection, the one
+ * which is answered included.
+ */
+#ifndef HTTPSERVER_HTTP2_STREAMS
+#define HTTPSERVER_HTTP2_STREAMS            4
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Dimension of the buffer where the decoded headers of the streams wait
+ * for their turn. Each one of the @ref HTTPSERVER_HTTP2_STREAMS streams
+ * takes an equal share, which is advertised to the client as its max
+ * header list size: a stream whose headers exceed it is refused.
+ */
+#ifndef HTTPSERVER_HTTP2_PENDING_DIMENSION
+#define HTTPSERVER_HTTP2_PENDING_DIMENSION  768
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Dimension of each HPACK dynamic table, the one of the request headers and
+ * the one of the response headers. The max value is 4096.
+ */
+#ifndef HTTPSERVER_HTTP2_TABLE_DIMENSION
+#define HTTPSERVER_HTTP2_TABLE_DIMENSION    256
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Dimension of the buffer of the frames to send: the response headers are
+ * encoded here, the response body is sent from the trasmission buffer of
+ * the client.
+ */
+#ifndef HTTPSERVER_HTTP2_OUT_DIMENSION
+#define HTTPSERVER_HTTP2_OUT_DIMENSION      256
+#endif
+/**
+ * @ingroup httpServer_macros
+ * The flow control window of the request bodies, which are not used by the
+ * handlers and are dropped as they arrive.
+ */
+#ifndef HTTPSERVER_HTTP2_WINDOW
+#define HTTPSERVER_HTTP2_WINDOW             4096
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Ticks an HTTP/2 connection without streams waits for a new one.
+ */
+#ifndef HTTPSERVER_HTTP2_TIMEOUT
+#define HTTPSERVER_HTTP2_TIMEOUT            10000
+#endif
+
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to collect the server metrics into @ref HttpServer_Metrics .
+ */
+#ifndef HTTPSERVER_METRICS
+#define HTTPSERVER_METRICS                  1
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Number of buckets of each latency histogram: the bucket n counts the
+ * samples lower than 2^n ticks, the last one counts all remaining samples.
+ */
+#ifndef HTTPSERVER_METRICS_BUCKETS
+#define HTTPSERVER_METRICS_BUCKETS          12
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to serve the metrics, in Prometheus text format, at
+ * @ref HTTPSERVER_METRICS_URI without calling the application.
+ */
+#ifndef HTTPSERVER_METRICS_ROUTE
+#define HTTPSERVER_METRICS_ROUTE            1
+#endif
+/**
+ * @ingroup httpServer_macros
+ * The URI of the built-in metrics route.
+ */
+#ifndef HTTPSERVER_METRICS_URI
+#define HTTPSERVER_METRICS_URI              "/metrics"
+#endif
+
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to record the server events into the trace ring buffer.
+ * Each event costs a few cycles, so it can be left enabled in production.
+ */
+#ifndef HTTPSERVER_TRACE_ENABLE
+#define HTTPSERVER_TRACE_ENABLE             1
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Number of records of the trace ring buffer, it MUST be a power of two.
+ */
+#ifndef HTTPSERVER_TRACE_DIMENSION
+#define HTTPSERVER_TRACE_DIMENSION          64
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Set to 1 to serve the decoded trace at @ref HTTPSERVER_TRACE_URI without
+ * calling the application.
+ */
+#ifndef HTTPSERVER_TRACE_ROUTE
+#define HTTPSERVER_TRACE_ROUTE              0
+#endif
+/**
+ * @ingroup httpServer_macros
+ * The URI of the built-in trace route.
+ */
+#ifndef HTTPSERVER_TRACE_URI
+#define HTTPSERVER_TRACE_URI                "/trace"
+#endif
+/**
+ * @ingroup httpServer_macros
+ * Set when a module sends a body which is generated line by line while the
+ * response is sent: the metrics and the trace.
+ */
+#define HTTPSERVER_GENERATOR                ((HTTPSERVER_METRICS == 1) || (HTTPSERVER_TRACE_ENABLE == 1))
+
 /**
  * @ingroup httpServer_macros
  */
@@ -428,25 +902,373 @@ typedef enum
     HTTPSERVER_RESPONSECODE_HTTPVERSIONNOTSUPPORTED,            // 505
 } HttpServer_ResponseCode;
 
-typedef struct _HttpServer_Message
+/**
+ * @ingroup httpServer_functions
+ * The content codings which can be used for a response body.
+ */
+typedef enum
 {
-    ///Request type enum
-    HttpServer_Request request;
-    ///Request version enum
-    HttpServer_Version version;
+    ///Body sent as it is
+    HTTPSERVER_ENCODING_IDENTITY = 0x00,
+    ///Body compressed in gzip format
+    HTTPSERVER_ENCODING_GZIP     = 0x01,
+    ///Body compressed in zlib format
+    HTTPSERVER_ENCODING_DEFLATE  = 0x02,
 
-    ///Array of char where URI request is stored
-    char uri[HTTPSERVER_MAX_URI_LENGTH+1];
-    ///Array of char where headers of the request are stored
-    char header[HTTPSERVER_HEADERS_MAX_LENGTH+1];
+} HttpServer_Encoding;
 
-    ///Enum which contains the response code
-    HttpServer_ResponseCode responseCode;
-    ///Array of char where body of the response are stored
-    char body[HTTPSERVER_BODY_MAX_LENGTH+1];
+#if (HTTPSERVER_RANGE == 1)
+/**
+ * @ingroup httpServer_functions
+ * Description of the Range and If-Range headers of a request.
+ */
+typedef enum
+{
+    ///A single byte range is requested
+    HTTPSERVER_RANGEFLAGS_PRESENT = 0x01,
+    ///The last rangeFirst bytes are requested (bytes=-N)
+    HTTPSERVER_RANGEFLAGS_SUFFIX  = 0x02,
+    ///The range goes up to the end (bytes=N-)
+    HTTPSERVER_RANGEFLAGS_OPEN    = 0x04,
+    ///The If-Range header is present
+    HTTPSERVER_RANGEFLAGS_IF      = 0x08,
+
+} HttpServer_RangeFlags;
+#endif
+
+/**
+ * @ingroup httpServer_functions
+ * Request headers which are recognized by the server.
+ */
+typedef enum
+{
+    ///The Content-Length header is present
+    HTTPSERVER_MESSAGEFLAGS_CONTENT_LENGTH = 0x01,
+    ///The client waits for 100 Continue before sending the body
+    HTTPSERVER_MESSAGEFLAGS_EXPECT_CONTINUE = 0x02,
+    ///The client asks to close the connection after the response
+    HTTPSERVER_MESSAGEFLAGS_CLOSE = 0x04,
+    ///The client asks to keep the connection open (HTTP/1.0)
+    HTTPSERVER_MESSAGEFLAGS_KEEPALIVE = 0x08,
+    ///The client asks to switch protocol, with the Upgrade header
+    HTTPSERVER_MESSAGEFLAGS_UPGRADE = 0x10,
+    ///The body is framed by a Transfer-Encoding, which is not decoded
+    HTTPSERVER_MESSAGEFLAGS_TRANSFER_ENCODING = 0x20,
+
+} HttpServer_MessageFlags;
+
+#if (HTTPSERVER_ARENA == 1)
+/**
+ * @ingroup httpServer_functions
+ * The scratch memory of a request: the blocks are taken in sequence and
+ * they are all given back at once when the response is sent.
+ */
+typedef struct _HttpServer_Arena
+{
+    ///The memory, word aligned
+    uint32_t buffer[HTTPSERVER_ARENA_DIMENSION / 4];
+    ///Number of bytes in use
+    uint16_t used;
+    ///Highest number of bytes used by a request
+    uint16_t peak;
+
+} HttpServer_Arena;
+#endif
+
+typedef struct _HttpServer_Message
+{
+    ///Request type enum
+    HttpServer_Request request;
+    ///Request version enum
+    HttpServer_Version version;
+
+    ///Array of char where URI request is stored
+    char uri[HTTPSERVER_MAX_URI_LENGTH+1];
+    ///Array of char where headers of the request are stored
+    char header[HTTPSERVER_HEADERS_MAX_LENGTH+1];
+    ///Content codings accepted by the client, see @ref HttpServer_Encoding
+    uint8_t acceptEncoding;
+#if (HTTPSERVER_RANGE == 1)
+    ///First byte of the requested range, or the suffix length
+    uint32_t rangeFirst;
+    ///Last byte of the requested range
+    uint32_t rangeLast;
+    ///Range header description, see @ref HttpServer_RangeFlags
+    uint8_t rangeFlags;
+    ///Value of the If-Range header
+    char ifRange[HTTPSERVER_RANGE_VALIDATOR_LENGTH+1];
+#endif
+    ///Value of the Content-Length header, 0 when not present
+    uint32_t contentLength;
+    ///Flags of the request headers, see @ref HttpServer_MessageFlags
+    uint8_t flags;
+
+    ///Enum which contains the response code
+    HttpServer_ResponseCode responseCode;
+    ///Array of char where body of the response are stored
+    char body[HTTPSERVER_BODY_MAX_LENGTH+1];
+#if (HTTPSERVER_ARENA == 1)
+    ///The scratch memory of the request
+    HttpServer_Arena arena;
+#endif
 
 } HttpServer_Message, *HttpServer_MessageHandle;
 
+/**
+ * @ingroup httpServer_functions
+ * The processing state of a @ref HttpServer_Client.
+ */
+typedef enum
+{
+    ///No connection on this slot
+    HTTPSERVER_CLIENTSTATE_IDLE,
+    ///Waiting for the request line
+    HTTPSERVER_CLIENTSTATE_REQUEST,
+    ///Receiving the request headers
+    HTTPSERVER_CLIENTSTATE_HEADERS,
+    ///The response is staged and it is going to be sent
+    HTTPSERVER_CLIENTSTATE_RESPONSE,
+    ///The connection is upgraded to WebSocket
+    HTTPSERVER_CLIENTSTATE_WEBSOCKET,
+    ///The connection is subscribed to the Server-Sent Events
+    HTTPSERVER_CLIENTSTATE_SSE,
+    ///The request body is received into a sink
+    HTTPSERVER_CLIENTSTATE_UPLOAD,
+    ///HTTP/2 connection waiting for its next stream
+    HTTPSERVER_CLIENTSTATE_HTTP2,
+
+} HttpServer_ClientState;
+
+/**
+ * @ingroup httpServer_functions
+ * The scheduling class of a request: during each @ref HttpServer_poll pass
+ * the high priority clients are served before the normal ones.
+ */
+typedef enum
+{
+    ///Bulk transfer, served after the control-plane requests
+    HTTPSERVER_PRIORITY_NORMAL,
+    ///Control-plane request, jumps ahead of bulk transfers
+    HTTPSERVER_PRIORITY_HIGH,
+
+} HttpServer_Priority;
+
+/**
+ * @ingroup httpServer_functions
+ * The flags which describe how the response body is framed.
+ */
+typedef enum
+{
+    ///The response is complete, the connection is closed when sent
+    HTTPSERVER_TXFLAGS_END        = 0x01,
+    ///The body is sent with chunked transfer coding
+    HTTPSERVER_TXFLAGS_CHUNKED    = 0x02,
+    ///A chunk is open into the trasmission buffer
+    HTTPSERVER_TXFLAGS_CHUNK_OPEN = 0x04,
+    ///The body is compressed
+    HTTPSERVER_TXFLAGS_DEFLATE    = 0x08,
+    ///The headers are not terminated yet: the body is collected into the
+    ///compression window until its length justifies the compression
+    HTTPSERVER_TXFLAGS_PENDING    = 0x10,
+    ///When the response is sent the connection waits for the next request
+    HTTPSERVER_TXFLAGS_KEEPALIVE  = 0x20,
+    ///Less than a segment is not sent until the response is uncorked
+    HTTPSERVER_TXFLAGS_CORK       = 0x40,
+
+} HttpServer_TxFlags;
+
+/**
+ * @ingroup httpServer_functions
+ * The common response headers, see @ref HttpServer_addHeader . The
+ * Content-Length, Date, Server and Connection headers are added by the
+ * server.
+ */
+typedef enum
+{
+    HTTPSERVER_HEADER_CONTENT_TYPE,
+    HTTPSERVER_HEADER_CONTENT_ENCODING,
+    HTTPSERVER_HEADER_CONTENT_DISPOSITION,
+    HTTPSERVER_HEADER_CACHE_CONTROL,
+    HTTPSERVER_HEADER_ETAG,
+    HTTPSERVER_HEADER_LAST_MODIFIED,
+    HTTPSERVER_HEADER_LOCATION,
+    HTTPSERVER_HEADER_RETRY_AFTER,
+    HTTPSERVER_HEADER_SET_COOKIE,
+    HTTPSERVER_HEADER_WWW_AUTHENTICATE,
+    HTTPSERVER_HEADER_ACCESS_CONTROL_ALLOW_ORIGIN,
+
+    HTTPSERVER_HEADER_NUMBER,
+
+} HttpServer_Header;
+
+#if (HTTPSERVER_RANGE == 1)
+/**
+ * @ingroup httpServer_functions
+ * A resource with known length, read piecewise while the response is sent
+ * (for example a firmware image into the flash).
+ */
+typedef struct _HttpServer_Resource
+{
+    ///Total length of the resource
+    uint32_t length;
+    ///Strong entity tag or last modification date of the resource, compared
+    ///with the If-Range header. NULL when the resource can't be validated:
+    ///in this case a conditional range request gets the whole resource.
+    const char* validator;
+    ///Reads up to length bytes starting from offset, it returns the number
+    ///of read bytes: 0 aborts the response.
+    uint16_t (*read)(void* context, uint32_t offset, uint8_t* buffer, uint16_t length);
+    ///The context passed to read
+    void* context;
+
+} HttpServer_Resource;
+#endif
+
+#if (HTTPSERVER_UPLOAD == 1)
+/**
+ * @ingroup httpServer_functions
+ * Result of a block write into a @ref HttpServer_Sink .
+ */
+typedef enum
+{
+    ///The block is stored, the buffer can be reused
+    HTTPSERVER_SINK_OK,
+    ///The sink can't accept the block now: the same block is written again
+    ///at the next pass, and meanwhile the socket isn't read.
+    HTTPSERVER_SINK_BUSY,
+    ///The block can't be stored: the upload is aborted
+    HTTPSERVER_SINK_ERROR,
+
+} HttpServer_SinkStatus;
+
+/**
+ * @ingroup httpServer_functions
+ * The destination of an uploaded body, like a flash writer. The body is
+ * delivered in blocks of blockSize bytes, only the last one can be
+ * shorter, so the offsets keep the block alignment.
+ */
+typedef struct _HttpServer_Sink
+{
+    ///The block buffer, of at least blockSize bytes
+    uint8_t* buffer;
+    ///The block size, for example the flash page size
+    uint16_t blockSize;
+    ///Stores a block of the body, starting from offset
+    HttpServer_SinkStatus (*write)(void* context,
+                                   uint32_t offset,
+                                   const uint8_t* data,
+                                   uint16_t length);
+    ///Called at the end of the upload with the received length and its
+    ///CRC32. When complete is false the upload was aborted, otherwise it
+    ///returns the code of the final response.
+    HttpServer_ResponseCode (*finish)(void* context,
+                                      uint32_t length,
+                                      uint32_t crc,
+                                      bool complete);
+    ///The context passed to the callbacks
+    void* context;
+
+} HttpServer_Sink;
+#endif
+
+#if (HTTPSERVER_MULTIPART == 1)
+/**
+ * @ingroup httpServer_functions
+ * An incremental multipart/form-data parser. The application sets the
+ * callbacks and the context, the other fields are managed by the server.
+ * The body is parsed block by block into the receive buffer of the client.
+ */
+typedef struct _HttpServer_Multipart
+{
+    ///Called at the begin of every part with its headers, every header
+    ///terminated by \r\n, see @ref HttpServer_multipartParameter
+    void (*partCallback)(void* context, const char* headers);
+    ///Called with the data of the current part, last is true at the end of
+    ///the part. It returns false to abort the upload.
+    bool (*dataCallback)(void* context, const uint8_t* data, uint16_t length, bool last);
+    ///Called at the end of the upload, complete is true when the closing
+    ///boundary was received. It returns the code of the final response.
+    HttpServer_ResponseCode (*finishCallback)(void* context, bool complete);
+    ///The context passed to the callbacks
+    void* context;
+
+    ///The upload sink which feeds the parser
+    HttpServer_Sink sink;
+    ///The delimiter: \r\n-- and the boundary
+    uint8_t delimiter[HTTPSERVER_MULTIPART_BOUNDARY_LENGTH+4];
+    ///The delimiter length
+    uint8_t delimiterLength;
+    ///Horspool skip table of the delimiter
+    uint8_t skip[256];
+    ///Tail of the previous block which can be the begin of a delimiter
+    uint8_t carry[HTTPSERVER_MULTIPART_BOUNDARY_LENGTH+4];
+    ///Number of bytes into carry
+    uint8_t carryLength;
+    ///The headers of the current part
+    char headers[HTTPSERVER_MULTIPART_HEADERS_LENGTH+1];
+    ///Number of characters into headers
+    uint16_t headersLength;
+    ///Matched characters of the headers terminator
+    uint8_t match;
+    ///Parser state
+    uint8_t state;
+
+} HttpServer_Multipart;
+#endif
+
+#if (HTTPSERVER_WEBSOCKET == 1)
+/**
+ * @ingroup httpServer_functions
+ * The events passed to @ref websocketCallback and the message types of
+ * @ref HttpServer_wsSend .
+ */
+typedef enum
+{
+    ///Upgrade request: the data are the URI, return HTTPSERVER_ERROR_OK to
+    ///accept it
+    HTTPSERVER_WEBSOCKET_OPEN,
+    ///Part of a text message
+    HTTPSERVER_WEBSOCKET_TEXT,
+    ///Part of a binary message
+    HTTPSERVER_WEBSOCKET_BINARY,
+    ///The connection is closed: the data are the close frame payload
+    HTTPSERVER_WEBSOCKET_CLOSE,
+
+} HttpServer_WebSocketEvent;
+
+/**
+ * @ingroup httpServer_functions
+ * The receiving state of a WebSocket connection.
+ */
+typedef struct _HttpServer_WebSocket
+{
+    ///Frame header under reception
+    uint8_t header[14];
+    ///Received bytes of the frame header
+    uint8_t headerLength;
+    ///Opcode of the current frame
+    uint8_t opcode;
+    ///Opcode of the current data message, for the continuation frames
+    uint8_t messageOpcode;
+    ///Last frame of the message
+    bool fin;
+    ///Masking key of the current frame
+    uint8_t mask[4];
+    ///Index of the next masking key byte
+    uint8_t maskIndex;
+    ///Payload bytes of the current frame still to receive
+    uint32_t remaining;
+    ///Tick of the last ping or received frame
+    uint32_t pingTick;
+
+} HttpServer_WebSocket;
+#endif
+
+#if (HTTPSERVER_GENERATOR == 1)
+///The server, which is defined after its clients
+struct _HttpServer_Device;
+#endif
+
 typedef struct _HttpServer_Client
 {
     ///Receive buffer where receiving data is stored
@@ -455,9 +1277,98 @@ typedef struct _HttpServer_Client
     uint8_t txBuffer[HTTPSERVER_TX_BUFFER_DIMENSION+1];
     ///Receive buffer index
     uint16_t rxIndex;
+    ///Number of bytes staged into the trasmission buffer
+    uint16_t txLength;
+    ///Number of staged bytes already sent to the socket
+    uint16_t txSent;
+    ///Header buffer index
+    uint16_t headerIndex;
+    ///Framing of the response body, see @ref HttpServer_TxFlags
+    uint8_t txFlags;
+    ///Offset of the open chunk header into the trasmission buffer
+    uint16_t txChunk;
+    ///The response couldn't be staged: the connection is closed
+    bool txAborted;
+    ///Writes the next part of the streamed body, NULL when none
+    void (*producer)(void* context, uint8_t client);
+    ///The context passed to producer
+    void* producerContext;
+
+    ///Current processing state
+    HttpServer_ClientState state;
+    ///Scheduling class of the current request
+    HttpServer_Priority priority;
+    ///Tick of the last received or sent byte, used for timeout
+    uint32_t lastTick;
+    ///Number of requests served on the connection
+    uint8_t requests;
+#if (HTTPSERVER_METRICS == 1)
+    ///Tick of the connection or of the begin of the current phase
+    uint32_t phaseTick;
+#endif
 
     ///Incoming message are save as @ref HttpServer_Message
     HttpServer_Message message;
+#if (HTTPSERVER_WEBSOCKET == 1)
+    ///State of the upgraded connection
+    HttpServer_WebSocket websocket;
+#endif
+#if (HTTPSERVER_SSE == 1)
+    ///Ring buffer position of the next event record to send
+    uint32_t sseOffset;
+    ///Bytes of the current event record already sent
+    uint16_t sseSent;
+    ///Mask of the subscribed channels
+    uint8_t sseChannels;
+#endif
+#if (HTTPSERVER_RANGE == 1)
+    ///Read function of the resource which is sent
+    uint16_t (*sourceRead)(void* context, uint32_t offset, uint8_t* buffer, uint16_t length);
+    ///Context of the resource which is sent
+    void* sourceContext;
+    ///Next resource byte to read
+    uint32_t sourceOffset;
+    ///Number of resource bytes still to read
+    uint32_t sourceRemaining;
+#endif
+#if (HTTPSERVER_UPLOAD == 1)
+    ///The destination of the uploaded body
+    const HttpServer_Sink* sink;
+    ///Offset of the block into the sink buffer
+    uint32_t uploadOffset;
+    ///Number of body bytes still to receive
+    uint32_t uploadRemaining;
+    ///CRC32 of the received body
+    uint32_t uploadCrc;
+    ///Number of bytes into the sink buffer
+    uint16_t uploadBlock;
+    ///The sink refuses the block since uploadBusyTick
+    bool uploadBusy;
+    ///Tick of the first refused write of the block
+    uint32_t uploadBusyTick;
+#endif
+#if (HTTPSERVER_BORROWED == 1)
+    ///Next byte of the borrowed body, NULL when no body is borrowed
+    const uint8_t* borrowed;
+    ///Number of borrowed bytes still to send
+    uint32_t borrowedRemaining;
+    ///Called when the borrowed body is released
+    void (*borrowedDone)(void* context, bool sent);
+    ///The context passed to borrowedDone
+    void* borrowedContext;
+#endif
+#if (HTTPSERVER_RATELIMIT == 1)
+    ///The peer address, 0 when it is unknown
+    uint32_t address;
+#endif
+#if (HTTPSERVER_GENERATOR == 1)
+    ///Writes the line generatorStep of the generated body, NULL when none
+    uint8_t (*generator)(struct _HttpServer_Device* dev, uint8_t client, char* line);
+    ///Next line of the generated body
+    uint32_t generatorStep;
+    ///Line which ends the generated body
+    uint32_t generatorEnd;
+#endif
 
 } HttpServer_Client, *HttpServer_ClientHandle;
 
@@ -482,9 +1393,353 @@ typedef enum
     ///URI too long
     HTTPSERVER_ERROR_URI_TOO_LONG,
     HTTPSERVER_ERROR_WRONG_PARAM,
+    ///The line is not completely received yet
+    HTTPSERVER_ERROR_IN_PROGRESS,
+    ///The line doesn't fit into the receive buffer
+    HTTPSERVER_ERROR_LINE_TOO_LONG,
 
 } HttpServer_Error;
 
+#if (HTTPSERVER_METRICS == 1)
+/**
+ * @ingroup httpServer_functions
+ * Log-bucketed latency histogram, in ticks.
+ */
+typedef struct _HttpServer_Histogram
+{
+    ///The bucket n counts the samples lower than 2^n ticks
+    uint32_t bucket[HTTPSERVER_METRICS_BUCKETS];
+    ///Number of samples
+    uint32_t count;
+    ///Sum of all samples
+    uint32_t sum;
+
+} HttpServer_Histogram;
+
+/**
+ * @ingroup httpServer_functions
+ * The metrics collected by a @ref HttpServer_Device .
+ */
+typedef struct _HttpServer_Metrics
+{
+    ///Number of accepted connections
+    uint32_t connectionsAccepted;
+    ///Number of closed connections
+    uint32_t connectionsClosed;
+    ///Number of connections refused because of overload
+    uint32_t connectionsRefused;
+#if (HTTPSERVER_RATELIMIT == 1)
+    ///Number of connections and requests refused by the rate limit
+    uint32_t rateLimited;
+#endif
+#if (HTTPSERVER_HTTP2 == 1)
+    ///Number of HTTP/2 connections
+    uint32_t http2Connections;
+#endif
+    ///Number of requests for each @ref HttpServer_Request
+    uint32_t requests[HTTPSERVER_REQUEST_CONNECT+1];
+    ///Number of responses for each status class, from 1xx to 5xx
+    uint32_t responses[5];
+    ///Number of malformed requests
+    uint32_t parseErrors;
+    ///Number of connections closed because of timeout
+    uint32_t timeouts;
+    ///Number of received bytes
+    uint32_t bytesIn;
+    ///Number of sent bytes
+    uint32_t bytesOut;
+
+    ///From the connection to the parsed request line
+    HttpServer_Histogram firstLine;
+    ///From the request line to the end of the headers
+    HttpServer_Histogram headers;
+    ///Execution time of the request handler
+    HttpServer_Histogram handler;
+    ///From the staged response to the last byte sent
+    HttpServer_Histogram send;
+
+} HttpServer_Metrics;
+#endif
+
+#if (HTTPSERVER_TRACE_ENABLE == 1)
+/**
+ * @ingroup httpServer_functions
+ * The events recorded into the trace ring buffer. The meaning of the two
+ * arguments is reported for each event.
+ */
+typedef enum
+{
+    ///Server started: port, socket number
+    HTTPSERVER_TRACE_OPEN,
+    ///Server not started: port, socket number
+    HTTPSERVER_TRACE_OPEN_FAIL,
+    ///New client: served clients, -
+    HTTPSERVER_TRACE_CONNECT,
+    ///Client refused for overload: served clients, handler latency
+    HTTPSERVER_TRACE_REFUSED,
+    ///Connection closed by the client: client state, -
+    HTTPSERVER_TRACE_DISCONNECT,
+    ///Connection closed by the server: client state, -
+    HTTPSERVER_TRACE_CLOSE,
+    ///Request line parsed: request type, line length
+    HTTPSERVER_TRACE_REQUEST,
+    ///Wrong request line: error, line length
+    HTTPSERVER_TRACE_PARSE_ERROR,
+    ///Line longer than the receive buffer: client state, line length
+    HTTPSERVER_TRACE_LINE_TOO_LONG,
+    ///Header dropped: header buffer index, header length
+    HTTPSERVER_TRACE_HEADER_OVERFLOW,
+    ///Request performed: response code, handler ticks
+    HTTPSERVER_TRACE_HANDLER,
+    ///Response staged: response code, staged bytes
+    HTTPSERVER_TRACE_RESPONSE,
+    ///Response completely sent: priority, -
+    HTTPSERVER_TRACE_SENT,
+    ///Connection closed for timeout: client state, -
+    HTTPSERVER_TRACE_TIMEOUT,
+    ///Connection upgraded to WebSocket: -, -
+    HTTPSERVER_TRACE_WEBSOCKET_OPEN,
+    ///WebSocket frame received: opcode, payload length
+    HTTPSERVER_TRACE_WEBSOCKET_FRAME,
+    ///WebSocket connection closed: status code, -
+    HTTPSERVER_TRACE_WEBSOCKET_CLOSE,
+    ///Server-Sent Events subscription: channels, -
+    HTTPSERVER_TRACE_SSE_START,
+    ///Event published: channels, record length
+    HTTPSERVER_TRACE_SSE_EVENT,
+    ///Subscriber closed since it falls behind: pending bytes, -
+    HTTPSERVER_TRACE_SSE_OVERRUN,
+    ///Body upload started: block size, -
+    HTTPSERVER_TRACE_UPLOAD_START,
+    ///Sink busy, the socket isn't read: block offset/block size, -
+    HTTPSERVER_TRACE_UPLOAD_BUSY,
+    ///Body upload completed or aborted: response code, 0 when aborted
+    HTTPSERVER_TRACE_UPLOAD_END,
+    ///Connection kept open for the next request: served requests, -
+    HTTPSERVER_TRACE_KEEPALIVE,
+    ///Client refused by the rate limit: @ref HttpServer_RateLimitReason,
+    ///peer address low half
+    HTTPSERVER_TRACE_RATELIMITED,
+    ///HTTP/2 connection: 0 prior knowledge or 1 upgrade, -
+    HTTPSERVER_TRACE_HTTP2_OPEN,
+    ///HTTP/2 stream received: stream low half, waiting streams
+    HTTPSERVER_TRACE_HTTP2_STREAM,
+    ///HTTP/2 stream reset by the server: stream low half, error code
+    HTTPSERVER_TRACE_HTTP2_RESET,
+    ///HTTP/2 connection closed by the server: error code, last stream
+    HTTPSERVER_TRACE_HTTP2_GOAWAY,
+
+    HTTPSERVER_TRACE_EVENT_NUMBER,
+
+} HttpServer_TraceEvent;
+
+/**
+ * @ingroup httpServer_functions
+ * A fixed-size binary trace record.
+ */
+typedef struct _HttpServer_TraceRecord
+{
+    ///Tick of the event
+    uint32_t tick;
+    ///The @ref HttpServer_TraceEvent
+    uint8_t event;
+    ///The client number
+    uint8_t client;
+    ///First event argument
+    uint16_t arg0;
+    ///Second event argument
+    uint16_t arg1;
+
+} HttpServer_TraceRecord;
+#endif
+
+#if (HTTPSERVER_COMPRESSION == 1)
+/**
+ * @ingroup httpServer_functions
+ * The streaming deflate encoder. Only one is available for each server:
+ * it is owned by one client at a time, the other responses are not
+ * compressed.
+ */
+typedef struct _HttpServer_Deflate
+{
+    ///Block of body to compress
+    uint8_t window[HTTPSERVER_COMPRESSION_WINDOW];
+    ///Last position+1 of each hashed 3 bytes sequence, 0 when empty
+    uint16_t head[1 << HTTPSERVER_COMPRESSION_HASH_BITS];
+    ///Number of bytes into the window
+    uint16_t length;
+    ///Compressed bytes not yet passed to the trasmission path
+    uint8_t out[32];
+    ///Number of bytes into out
+    uint8_t outLength;
+    ///Bits not yet completing a byte
+    uint32_t bits;
+    ///Number of valid bits
+    uint8_t bitCount;
+    ///Selected format, @ref HttpServer_Encoding
+    uint8_t format;
+    ///CRC32 (gzip) or Adler32 (zlib) of the uncompressed body
+    uint32_t check;
+    ///Length of the uncompressed body
+    uint32_t total;
+    ///The owner client, 0xFF when the encoder is free
+    uint8_t client;
+
+} HttpServer_Deflate;
+#endif
+
+#if (HTTPSERVER_SSE == 1)
+/**
+ * @ingroup httpServer_functions
+ * The Server-Sent Events ring buffer. Every event is formatted once into a
+ * record (channels mask, 16 bit length and the event text) and every
+ * subscriber sends it from here, keeping its own position.
+ */
+typedef struct _HttpServer_Sse
+{
+    ///The event records
+    uint8_t buffer[HTTPSERVER_SSE_BUFFER_DIMENSION];
+    ///Position of the next record, it is never reset to detect the overrun
+    uint32_t head;
+    ///Tick of the last event or heartbeat
+    uint32_t lastTick;
+
+} HttpServer_Sse;
+#endif
+
+#if (HTTPSERVER_RATELIMIT == 1)
+/**
+ * @ingroup httpServer_functions
+ * Why a client is refused by the rate limit.
+ */
+typedef enum
+{
+    ///Too many clients served for the peer address
+    HTTPSERVER_RATELIMIT_REASON_CLIENTS,
+    ///Connections opened too fast
+    HTTPSERVER_RATELIMIT_REASON_CONNECTIONS,
+    ///Requests sent too fast
+    HTTPSERVER_RATELIMIT_REASON_REQUESTS,
+
+} HttpServer_RateLimitReason;
+
+/**
+ * @ingroup httpServer_functions
+ * The token buckets of a peer address. Each bucket is stored as the tick
+ * when it is full again: a token moves it forward by the ticks to earn it.
+ */
+typedef struct _HttpServer_RateLimit
+{
+    ///The peer address, 0 when the entry is free
+    uint32_t address;
+    ///Connection bucket
+    uint32_t connectionTick;
+    ///Request bucket
+    uint32_t requestTick;
+
+} HttpServer_RateLimit;
+#endif
+
+#if (HTTPSERVER_HTTP2 == 1)
+/**
+ * @ingroup httpServer_functions
+ * An HPACK dynamic table (RFC 7541). The entries are stored newest first,
+ * each one with 16 bit name and value lengths followed by the name and
+ * the value.
+ */
+typedef struct _HttpServer_Hpack
+{
+    ///The entries
+    uint8_t buffer[HTTPSERVER_HTTP2_TABLE_DIMENSION];
+    ///Number of bytes into buffer
+    uint16_t length;
+    ///Number of entries
+    uint8_t count;
+    ///Table size as defined by HPACK, 32 bytes more for each entry
+    uint16_t size;
+    ///Max table size
+    uint16_t max;
+
+} HttpServer_Hpack;
+
+/**
+ * @ingroup httpServer_functions
+ * The HTTP/2 connection. Only one is available for each server: it is
+ * owned by one client at a time, the other clients use HTTP/1.1.
+ * The responses staged by the handlers are translated into frames while
+ * they are sent.
+ */
+typedef struct _HttpServer_Http2
+{
+    ///The owner client, 0xFF when the connection is free
+    uint8_t client;
+    ///Connection state flags
+    uint16_t flags;
+    ///Bytes of the client connection preface still to receive
+    uint8_t preface;
+
+    ///Header of the received frame
+    uint8_t frame[9];
+    ///Received bytes of the frame header
+    uint8_t frameLength;
+    ///Payload bytes of the frame still to receive
+    uint16_t remaining;
+    ///Begin of the payload of the short frames
+    uint8_t payload[8];
+    ///Received payload bytes
+    uint16_t payloadLength;
+    ///Stream of the header block which is received into the receive
+    ///buffer of the client
+    uint32_t blockStream;
+    ///Number of bytes of the header block
+    uint16_t blockLength;
+    ///Highest stream opened by the client
+    uint32_t lastStream;
+
+    ///Max frame payload accepted by the client
+    uint32_t maxFrame;
+    ///Initial window of the streams set by the client
+    int32_t initialWindow;
+    ///Bytes which can be sent on the connection
+    int32_t window;
+
+    ///The stream whose response is sent, 0 when none
+    uint32_t stream;
+    ///Bytes which can be sent on the stream
+    int32_t streamWindow;
+    ///Translation phase of the staged response
+    uint8_t phase;
+    ///Bytes of the current chunk, or of the trailer line, still to translate
+    uint32_t chunk;
+    ///Header of the DATA frame which is sent
+    uint8_t dataHeader[9];
+    ///Bytes of dataHeader still to send
+    uint8_t dataHeaderLength;
+    ///Payload bytes of the DATA frame still to send
+    uint16_t data;
+
+    ///The streams waiting for the current one
+    uint8_t pending[HTTPSERVER_HTTP2_PENDING_DIMENSION];
+    ///Number of bytes into pending
+    uint16_t pendingLength;
+    ///Number of waiting streams
+    uint8_t pendingCount;
+
+    ///The frames to send, but DATA
+    uint8_t out[HTTPSERVER_HTTP2_OUT_DIMENSION];
+    ///Number of bytes into out
+    uint16_t outLength;
+    ///Bytes of out already sent
+    uint16_t outSent;
+
+    ///Table of the request headers
+    HttpServer_Hpack decoder;
+    ///Table of the response headers
+    HttpServer_Hpack encoder;
+
+} HttpServer_Http2;
+#endif
+
 typedef struct _HttpServer_Device
 {
     ///Port number.
@@ -497,14 +1752,103 @@ typedef struct _HttpServer_Device
     HttpServer_Client clients [ETHERNET_MAX_LISTEN_CLIENT];
     ///A void pointer which is going to pass to @ref performingCallback .
     void* appDevice;
+    ///The client served first during the next @ref HttpServer_poll pass.
+    uint8_t pollStart;
+    ///Number of clients which are currently served.
+    uint8_t activeClients;
+    ///Smoothed execution time of @ref performingCallback , in ticks.
+    uint32_t handlerLatency;
+#if (HTTPSERVER_METRICS == 1)
+    ///The server metrics, they can be read at any time by the application.
+    HttpServer_Metrics metrics;
+#endif
+#if (HTTPSERVER_COMPRESSION == 1)
+    ///The response compression encoder.
+    HttpServer_Deflate deflate;
+#endif
+#if (HTTPSERVER_SSE == 1)
+    ///The Server-Sent Events shared by the subscribers.
+    HttpServer_Sse sse;
+#endif
+#if (HTTPSERVER_RATELIMIT == 1)
+    ///The token buckets of the peer addresses, open addressing table.
+    HttpServer_RateLimit rateLimit[HTTPSERVER_RATELIMIT_ENTRIES];
+#endif
+#if (HTTPSERVER_HTTP2 == 1)
+    ///The HTTP/2 connection.
+    HttpServer_Http2 http2;
+#endif
 
     ///The callback function it will be call if a request arrived.
     HttpServer_Error (*performingCallback)(void* appDevice,
                                            HttpServer_MessageHandle message,
                                            uint8_t clientNumber);
+    ///The optional callback function it will be call as soon as the request
+    ///line is parsed, to classify the request. When it is not set every
+    ///request has @ref HTTPSERVER_PRIORITY_NORMAL .
+    HttpServer_Priority (*priorityCallback)(void* appDevice,
+                                            HttpServer_MessageHandle message);
+    ///The optional callback function which returns the current time, in
+    ///seconds since 1970-01-01 UTC. When it is set the Date header is
+    ///added by @ref HttpServer_sendBuiltResponse .
+    uint32_t (*clockCallback)(void* appDevice);
+    ///The Date header value of dateTime, it is formatted once per second.
+    char date[30];
+    ///The time of date.
+    uint32_t dateTime;
+#if (HTTPSERVER_RATELIMIT == 1)
+    ///The optional callback function which returns the IPv4 address of the
+    ///peer of a new client, 0 when it is unknown. When it is set the
+    ///connections and the requests of each address are limited.
+    uint32_t (*addressCallback)(void* appDevice, uint8_t clientNumber);
+#endif
+#if (HTTPSERVER_WEBSOCKET == 1)
+    ///The optional callback function it will be call for the WebSocket
+    ///events: upgrade request, received data and close. When it is not set
+    ///the upgrade requests are performed as normal requests.
+    HttpServer_Error (*websocketCallback)(void* appDevice,
+                                          HttpServer_WebSocketEvent event,
+                                          const uint8_t* data,
+                                          uint16_t length,
+                                          bool last,
+                                          uint8_t clientNumber);
+#endif
 
 } HttpServer_Device, *HttpServer_DeviceHandle;
 
+#if (HTTPSERVER_JSON == 1)
+#ifndef HTTPSERVER_JSON_MAX_DEPTH
+///Max nesting of objects and arrays into a JSON response, at most 32
+#define HTTPSERVER_JSON_MAX_DEPTH           32
+#endif
+
+/**
+ * @ingroup httpServer_functions
+ * The state of a JSON response which is written directly into the
+ * transmission path of a client.
+ */
+typedef struct _HttpServer_Json
+{
+    ///The server
+    HttpServer_DeviceHandle dev;
+    ///The client which receives the response
+    uint8_t client;
+    ///Current nesting level
+    uint8_t depth;
+    ///A key is written: the next value completes the member
+    bool key;
+    ///Bit n is set when the level n + 1 has already an element
+    uint32_t elements;
+    ///Levels opened beyond HTTPSERVER_JSON_MAX_DEPTH, their content is dropped
+    uint16_t overflow;
+    ///The function which writes the next values, see HttpServer_jsonContinue
+    void (*producer)(struct _HttpServer_Json* json, void* context);
+    ///The application data passed to the producer
+    void* context;
+
+} HttpServer_Json;
+#endif
+
 
 extern const char HttpServer_responseCode[40][36];
 
@@ -519,6 +1863,10 @@ HttpServer_Error HttpServer_open (HttpServer_DeviceHandle dev);
 /**
  * @ingroup httpServer_functions
  * This is a polling function which MUST be called in loop.
+ * It never waits for incoming data: every connected client receives at most
+ * @ref HTTPSERVER_POLL_QUANTUM_BYTES bytes and
+ * @ref HTTPSERVER_POLL_QUANTUM_TICKS ticks for each call, and the first
+ * served client rotates between calls.
  * @param server The server pointer where you want to perform polling.
  */
 void HttpServer_poll (HttpServer_DeviceHandle dev);
@@ -540,4 +1888,470 @@ void HttpServer_sendResponse(HttpServer_DeviceHandle dev,
                              char* headers,
                              char* body,
                              uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function starts a streamed response to the selected client: the body
+ * is sent with @ref HttpServer_writeResponse and completed with
+ * @ref HttpServer_endResponse , it can be called from the
+ * @ref performingCallback or later.
+ * The server chooses the body framing: chunked transfer coding for HTTP/1.1
+ * clients, connection close otherwise. When the client accepts it and the
+ * body is long enough, the body is compressed on the fly.
+ * @param dev The server pointer.
+ * @param code The HTTP response code which it is going to send to the client.
+ * @param[in] The char pointer to the headers string, without the last end
+ * line. It MUST NOT contain Content-Length or Transfer-Encoding headers.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_startResponse (HttpServer_DeviceHandle dev,
+                               HttpServer_ResponseCode code,
+                               const char* headers,
+                               uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function sends a part of the body of a streamed response. When the
+ * transmission buffer is full the staged data are sent first, waiting for
+ * the socket at most @ref HTTPSERVER_POLL_QUANTUM_TICKS : when it doesn't
+ * take them the response is aborted and the connection is closed. A body
+ * bigger than the buffer is better written by a producer, see
+ * @ref HttpServer_continueResponse .
+ * @param dev The server pointer.
+ * @param[in] data The body data.
+ * @param length The number of bytes to send.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_writeResponse (HttpServer_DeviceHandle dev,
+                               const uint8_t* data,
+                               uint16_t length,
+                               uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function completes a streamed response: the connection is closed
+ * when all data are sent.
+ * @param dev The server pointer.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_endResponse (HttpServer_DeviceHandle dev, uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function lets a producer write the rest of the body of a streamed
+ * response: @ref HttpServer_poll calls it each time the staged part of the
+ * body is being sent, until it calls @ref HttpServer_endResponse . So a
+ * body of any length is written while it is sent, and the other clients
+ * are served meanwhile. Each call should write at most half of
+ * @ref HTTPSERVER_TX_BUFFER_DIMENSION bytes, and at least one byte every
+ * @ref HTTPSERVER_TIMEOUT ticks.
+ * @param dev The server pointer.
+ * @param producer The function which writes the next part of the body
+ * with @ref HttpServer_writeResponse .
+ * @param context The context passed to producer.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_continueResponse (HttpServer_DeviceHandle dev,
+                                  void (*producer)(void* context, uint8_t client),
+                                  void* context,
+                                  uint8_t client);
+
+#if (HTTPSERVER_CORK == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function corks the response being sent to the selected client: the
+ * staged bytes are sent only by full segments of
+ * @ref HTTPSERVER_CORK_SEGMENT bytes, or when the response ends, the
+ * buffer is full, @ref HTTPSERVER_CORK_TICKS elapse without sending or
+ * the response is uncorked. With the default buffers the segment is the
+ * whole transmission buffer. It has to be called after the status line.
+ * @param dev The server pointer.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_cork (HttpServer_DeviceHandle dev, uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function uncorks the response being sent to the selected client:
+ * the staged bytes are sent with the next poll.
+ * @param dev The server pointer.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_uncork (HttpServer_DeviceHandle dev, uint8_t client);
+#endif
+
+#if (HTTPSERVER_ARENA == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function takes a word aligned block of the request scratch memory.
+ * The block is valid until the response to the request is sent, there is
+ * no need to free it.
+ * @param message The request, as passed to @ref performingCallback .
+ * @param size The number of bytes.
+ * @return The block, NULL when the scratch memory is exhausted.
+ */
+void* HttpServer_arenaAlloc (HttpServer_MessageHandle message, uint16_t size);
+#endif
+
+/**
+ * @ingroup httpServer_functions
+ * This function begins a response built header by header: it stages the
+ * status line. The headers are added with @ref HttpServer_addHeader and
+ * the response is completed by @ref HttpServer_sendBuiltResponse .
+ * @param dev The server pointer.
+ * @param code The response code.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_beginResponse (HttpServer_DeviceHandle dev,
+                               HttpServer_ResponseCode code,
+                               uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function adds a common header to the response.
+ * @param dev The server pointer.
+ * @param header The header.
+ * @param[in] value The header value.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_addHeader (HttpServer_DeviceHandle dev,
+                           HttpServer_Header header,
+                           const char* value,
+                           uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function adds a header, with any name, to the response.
+ * @param dev The server pointer.
+ * @param[in] name The header name, without ':'.
+ * @param[in] value The header value.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_addHeaderName (HttpServer_DeviceHandle dev,
+                               const char* name,
+                               const char* value,
+                               uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function completes the response with its body: the Content-Length,
+ * Date, Server and Connection headers are added. When the client allows
+ * it, the connection waits for the next request after the response.
+ * @param dev The server pointer.
+ * @param[in] body The body, it can be NULL when length is 0.
+ * @param length The body length.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_sendBuiltResponse (HttpServer_DeviceHandle dev,
+                                   const uint8_t* body,
+                                   uint16_t length,
+                                   uint8_t client);
+
+#if (HTTPSERVER_BORROWED == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function completes a built response, like
+ * @ref HttpServer_sendBuiltResponse , with a body owned by the caller: it
+ * is passed to the socket directly from its buffer while
+ * @ref HttpServer_poll sends the response, without being copied into the
+ * transmission buffer. The buffer must not change until the done callback
+ * is called.
+ * @param dev The server pointer.
+ * @param[in] body The body.
+ * @param length The body length.
+ * @param done The optional callback called when the buffer is released:
+ * sent is true when the whole body was accepted by the socket, false when
+ * the connection was closed before.
+ * @param context The context passed to done.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_sendBorrowed (HttpServer_DeviceHandle dev,
+                              const uint8_t* body,
+                              uint32_t length,
+                              void (*done)(void* context, bool sent),
+                              void* context,
+                              uint8_t client);
+#endif
+
+#if (HTTPSERVER_WEBSOCKET == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function sends a message to a WebSocket client, in a single frame.
+ * @param dev The server pointer.
+ * @param type The message type: @ref HTTPSERVER_WEBSOCKET_TEXT or
+ * @ref HTTPSERVER_WEBSOCKET_BINARY .
+ * @param[in] data The message payload.
+ * @param length The payload length.
+ * @param[in] The number of the client where the message it is going to send.
+ * @return HTTPSERVER_ERROR_OK if the message is staged, other errors otherwise.
+ */
+HttpServer_Error HttpServer_wsSend (HttpServer_DeviceHandle dev,
+                                    HttpServer_WebSocketEvent type,
+                                    const uint8_t* data,
+                                    uint16_t length,
+                                    uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function starts the closing handshake of a WebSocket connection.
+ * @param dev The server pointer.
+ * @param status The close status code, 1000 for a normal closure.
+ * @param[in] The number of the client to close.
+ */
+void HttpServer_wsClose (HttpServer_DeviceHandle dev,
+                         uint16_t status,
+                         uint8_t client);
+#endif
+
+#if (HTTPSERVER_SSE == 1)
+///Mask of every channel, for @ref HttpServer_sseStart and @ref HttpServer_sseSend
+#define HTTPSERVER_SSE_CHANNEL_ALL          0xFF
+
+/**
+ * @ingroup httpServer_functions
+ * This function answers the request with an event stream: it must be called
+ * from @ref performingCallback . The connection stays open and receives the
+ * events published with @ref HttpServer_sseSend after this call.
+ * @param dev The server pointer.
+ * @param channels The mask of the channels the client subscribes to.
+ * @param[in] The number of the subscribing client.
+ */
+void HttpServer_sseStart (HttpServer_DeviceHandle dev,
+                          uint8_t channels,
+                          uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function publishes an event to every subscriber of the selected
+ * channels. The event is formatted once and sent by @ref HttpServer_poll .
+ * @param dev The server pointer.
+ * @param channels The mask of the destination channels.
+ * @param[in] event The event name, NULL for the default message event.
+ * @param[in] data The event data, every line is sent as a data field.
+ * @return HTTPSERVER_ERROR_OK if the event is published,
+ * HTTPSERVER_ERROR_WRONG_PARAM if it is bigger than the ring buffer.
+ */
+HttpServer_Error HttpServer_sseSend (HttpServer_DeviceHandle dev,
+                                     uint8_t channels,
+                                     const char* event,
+                                     const char* data);
+
+/**
+ * @ingroup httpServer_functions
+ * This function closes an event stream.
+ * @param dev The server pointer.
+ * @param[in] The number of the client to close.
+ */
+void HttpServer_sseClose (HttpServer_DeviceHandle dev, uint8_t client);
+#endif
+
+#if (HTTPSERVER_RANGE == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function answers the request with a resource, or with the requested
+ * byte range of it: the response code is 200, 206 or 416 as needed and the
+ * Content-Length, Content-Range and Accept-Ranges headers are added. The
+ * resource is read while the response is sent by @ref HttpServer_poll , so
+ * its read function and context must stay valid up to the end.
+ * It must be called from @ref performingCallback .
+ * @param dev The server pointer.
+ * @param[in] headers Other headers, like Content-Type and ETag, without the
+ * last \r\n. It can be empty.
+ * @param[in] resource The resource description.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_sendResource (HttpServer_DeviceHandle dev,
+                              const char* headers,
+                              const HttpServer_Resource* resource,
+                              uint8_t client);
+#endif
+
+#if (HTTPSERVER_UPLOAD == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function receives the request body into a sink: it must be called
+ * from @ref performingCallback . The body is read by @ref HttpServer_poll
+ * and the final response, with the length and CRC32 of the received body,
+ * is sent when the sink is finished. The sink must stay valid up to the
+ * end of the upload.
+ * A request without Content-Length is answered with 411.
+ * @param dev The server pointer.
+ * @param[in] sink The body destination.
+ * @param[in] The number of the client which sends the body.
+ * @return HTTPSERVER_ERROR_OK if the upload is started,
+ * HTTPSERVER_ERROR_WRONG_PARAM if the sink is not valid.
+ */
+HttpServer_Error HttpServer_startUpload (HttpServer_DeviceHandle dev,
+                                         const HttpServer_Sink* sink,
+                                         uint8_t client);
+#endif
+
+#if (HTTPSERVER_MULTIPART == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function receives a multipart/form-data body: it must be called from
+ * @ref performingCallback . The parts are passed to the parser callbacks
+ * while the body arrives, the parser must stay valid up to the end.
+ * A request which isn't multipart is answered with 400.
+ * @param dev The server pointer.
+ * @param[in] parser The parser, with the callbacks set.
+ * @param[in] The number of the client which sends the body.
+ * @return HTTPSERVER_ERROR_OK if the upload is started, other errors
+ * otherwise.
+ */
+HttpServer_Error HttpServer_startMultipart (HttpServer_DeviceHandle dev,
+                                            HttpServer_Multipart* parser,
+                                            uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function reads a parameter of the Content-Disposition header of a
+ * part, like name or filename.
+ * @param[in] headers The part headers.
+ * @param[in] name The parameter name.
+ * @param[out] value The parameter value, truncated to size-1 characters.
+ * @param size The dimension of value.
+ * @return true if the parameter is present.
+ */
+bool HttpServer_multipartParameter (const char* headers,
+                                    const char* name,
+                                    char* value,
+                                    uint16_t size);
+#endif
+
+#if (HTTPSERVER_JSON == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function starts a streamed JSON response, see
+ * @ref HttpServer_startResponse . The values are serialized directly into
+ * the transmission buffer. A document bigger than the buffer is written
+ * with @ref HttpServer_jsonContinue , while it is sent.
+ * @param[out] json The writer state.
+ * @param dev The server pointer.
+ * @param code The response code.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_jsonStart (HttpServer_Json* json,
+                           HttpServer_DeviceHandle dev,
+                           HttpServer_ResponseCode code,
+                           uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function completes the JSON response, see
+ * @ref HttpServer_endResponse .
+ */
+void HttpServer_jsonEnd (HttpServer_Json* json);
+
+/**
+ * @ingroup httpServer_functions
+ * This function lets a producer write the rest of the document, see
+ * @ref HttpServer_continueResponse : @ref HttpServer_poll calls it each
+ * time the staged values are being sent. The producer writes values until
+ * @ref HttpServer_jsonFull , and calls @ref HttpServer_jsonEnd after the
+ * last one. The writer state must stay valid until the end.
+ * @param[in] json The writer state, started with @ref HttpServer_jsonStart .
+ * @param producer The function which writes the next values.
+ * @param[in] context The application data passed to the producer.
+ */
+void HttpServer_jsonContinue (HttpServer_Json* json,
+                              void (*producer)(HttpServer_Json* json, void* context),
+                              void* context);
+
+/**
+ * @ingroup httpServer_functions
+ * This function tells a producer to return: half of the transmission
+ * buffer is staged, and the next values are written when it is sent.
+ * @return true when the producer has to return.
+ */
+bool HttpServer_jsonFull (HttpServer_Json* json);
+
+/**
+ * @ingroup httpServer_functions
+ * These functions open and close objects and arrays. The separators are
+ * added automatically.
+ * An object or array which would exceed HTTPSERVER_JSON_MAX_DEPTH is
+ * written as null and everything up to its end is dropped, so the response
+ * stays valid JSON.
+ * @return false when the nesting exceeds HTTPSERVER_JSON_MAX_DEPTH.
+ */
+bool HttpServer_jsonBeginObject (HttpServer_Json* json);
+void HttpServer_jsonEndObject (HttpServer_Json* json);
+bool HttpServer_jsonBeginArray (HttpServer_Json* json);
+void HttpServer_jsonEndArray (HttpServer_Json* json);
+
+/**
+ * @ingroup httpServer_functions
+ * This function writes the key of an object member, the next value
+ * completes the member.
+ */
+void HttpServer_jsonKey (HttpServer_Json* json, const char* key);
+
+/**
+ * @ingroup httpServer_functions
+ * This function writes a string value, escaping the quotes, the backslash
+ * and the control characters.
+ */
+void HttpServer_jsonString (HttpServer_Json* json, const char* value);
+
+/**
+ * @ingroup httpServer_functions
+ * This function writes an integer value.
+ */
+void HttpServer_jsonInteger (HttpServer_Json* json, int32_t value);
+
+/**
+ * @ingroup httpServer_functions
+ * This function writes a fixed-point number: value is the number
+ * multiplied by 10^decimals, for example 1234 with 2 decimals is 12.34 .
+ * At most 10 decimals are supported, the digits of an int32: a value with
+ * more decimals is written as null.
+ */
+void HttpServer_jsonFixed (HttpServer_Json* json, int32_t value, uint8_t decimals);
+
+/**
+ * @ingroup httpServer_functions
+ * These functions write the true, false and null literals.
+ */
+void HttpServer_jsonBool (HttpServer_Json* json, bool value);
+void HttpServer_jsonNull (HttpServer_Json* json);
+#endif
+
+#if (HTTPSERVER_METRICS == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function sends the server metrics to the selected client, as a
+ * 200 OK response in Prometheus text format.
+ * @param dev The server pointer.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_sendMetrics (HttpServer_DeviceHandle dev, uint8_t client);
+#endif
+
+#if (HTTPSERVER_TRACE_ENABLE == 1)
+/**
+ * @ingroup httpServer_functions
+ * This function decodes the trace ring buffer, from the oldest record, and
+ * passes every line of text to the print function. It can be used, for
+ * example, to dump the trace over the CLI after the fact.
+ * @param print The function called for each decoded line.
+ */
+void HttpServer_traceDump (void (*print)(const char* line));
+
+/**
+ * @ingroup httpServer_functions
+ * This function sends the decoded trace ring buffer to the selected client,
+ * as a 200 OK text response.
+ * @param dev The server pointer.
+ * @param[in] The number of the client where the message it is going to send.
+ */
+void HttpServer_sendTrace (HttpServer_DeviceHandle dev, uint8_t client);
+
+/**
+ * @ingroup httpServer_functions
+ * This function clears the trace ring buffer.
+ */
+void HttpServer_traceClear (void);
+#endif
+
 #endif // __OHILAB_HTTPSERVER_H
@@ -0,0 +1,107 @@
+#!/bin/sh
+#
+# A simple HTTP/SERVER library
+# Copyright (C) 2018 A. C. Open Hardware Ideas Lab
+#
+# Static RAM and flash budget of the library for a configuration: the
+# modules are compiled with the compiler and the flags of the target, the
+# configuration comes from board.h or from -D options, so each profile can
+# be measured, for example:
+#
+#   CC=arm-none-eabi-gcc \
+#   CFLAGS="-mcpu=cortex-m4 -mthumb -Os -I../libohiboard/inc -I../board \
+#           -DHTTPSERVER_PROFILE=HTTPSERVER_PROFILE_TINY" \
+#   tools/http-server-budget.sh
+#
+# The RAM of a connection is the size of HttpServer_Client, the RAM of the
+# server is the size of HttpServer_Device, clients included, plus the static
+# data of the modules. The flash of each module is its code and constant
+# data; the module of a disabled feature is empty.
+#
+# Some features, as keep-alive, cork, arena and the compression
+# negotiation, are compiled into the core modules, so the flash of each
+# enabled feature is measured as the difference of the whole library built
+# without it: its module and its hooks in the core are both counted. The
+# scheduler and the parser are not optional, they are the rest of the
+# http-server module.
+
+set -e
+
+CC=${CC:-arm-none-eabi-gcc}
+SIZE=${SIZE:-${CC%gcc}size}
+NM=${NM:-${CC%gcc}nm}
+SOURCE=$(cd "$(dirname "$0")/.." && pwd)
+OUTPUT=$(mktemp -d)
+trap 'rm -rf "$OUTPUT"' EXIT
+
+# The sizes of the structures are read back from the symbol table, so the
+# report works with a cross compiler too
+cat > "$OUTPUT/budget.c" <<SOURCE_END
+#include "http-server.h"
+char HttpServer_budgetClient[sizeof(HttpServer_Client)];
+char HttpServer_budgetMessage[sizeof(HttpServer_Message)];
+char HttpServer_budgetDevice[sizeof(HttpServer_Device)];
+SOURCE_END
+FEATURES="KEEPALIVE CORK ARENA BORROWED COMPRESSION RANGE UPLOAD MULTIPART JSON SSE \
+          WEBSOCKET HTTP2 METRICS TRACE_ENABLE RATELIMIT"
+for feature in $FEATURES
+do
+    echo "char HttpServer_budget$feature[HTTPSERVER_$feature + 1];" >> "$OUTPUT/budget.c"
+done
+$CC $CFLAGS -I"$SOURCE" -fno-common -c "$OUTPUT/budget.c" -o "$OUTPUT/budget.o"
+
+symbolSize ()
+{
+    printf "%d" "0x$($NM -S "$OUTPUT/budget.o" | awk -v name="$1" '$4 == name { print $2 }')"
+}
+
+# Flash of the whole library, built with the given additional flags
+libraryFlash ()
+{
+    flash=0
+    for file in "$SOURCE"/http-server*.c
+    do
+        $CC $CFLAGS $1 -I"$SOURCE" -fno-common -c "$file" -o "$OUTPUT/feature.o" 2>/dev/null || return 1
+        flash=$((flash + $($SIZE "$OUTPUT/feature.o" | awk 'NR == 2 { print $1 + $2 }')))
+    done
+    echo "$flash"
+}
+
+for file in "$SOURCE"/http-server*.c
+do
+    $CC $CFLAGS -I"$SOURCE" -fno-common -c "$file" -o "$OUTPUT/$(basename "$file" .c).o"
+done
+
+printf "RAM for each connection   %8d bytes (request %d bytes)\n" \
+    "$(symbolSize HttpServer_budgetClient)" "$(symbolSize HttpServer_budgetMessage)"
+printf "RAM of the server         %8d bytes (connections included)\n" \
+    "$(symbolSize HttpServer_budgetDevice)"
+
+printf "\n%-28s %8s %8s %8s\n" "module" "flash" "data" "bss"
+for object in "$OUTPUT"/http-server*.o
+do
+    $SIZE "$object" | awk -v name="$(basename "$object" .o)" \
+        'NR == 2 { printf "%-28s %8d %8d %8d\n", name, $1 + $2, $2, $3 }'
+done | tee "$OUTPUT/modules"
+awk '{ flash += $2; data += $3; bss += $4 }
+     END { printf "%-28s %8d %8d %8d\n", "total", flash, data, bss }' "$OUTPUT/modules"
+
+printf "\n%-28s %8s\n" "feature" "flash"
+total=$(awk '{ flash += $2 } END { print flash }' "$OUTPUT/modules")
+for feature in $FEATURES
+do
+    if [ "$(symbolSize HttpServer_budget$feature)" -lt 2 ]
+    then
+        printf "%-28s %8s\n" "$feature" "off"
+        continue
+    fi
+    # The multipart parser can't be built without the upload
+    flags="-DHTTPSERVER_$feature=0"
+    [ "$feature" = "UPLOAD" ] && flags="$flags -DHTTPSERVER_MULTIPART=0"
+    if without=$(libraryFlash "$flags")
+    then
+        printf "%-28s %8d\n" "$feature" "$((total - without))"
+    else
+        printf "%-28s %8s\n" "$feature" "n/a"
+    fi
+done